@@ -0,0 +1,49 @@
+#ifndef _CHUNK_QUEUE_H // include guard
+#define _CHUNK_QUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+// Single producer, single consumer hand-off of a fixed set of byte buffers.
+// The producer fills free buffers while the consumer works on filled ones, so
+// at most amt_buffers * buffer_size bytes are in flight at any time.
+class Chunk_Queue {
+
+public:
+  Chunk_Queue(size_t amt_buffers, size_t buffer_size);
+  ~Chunk_Queue(void);
+
+  // Producer side
+  char *acquire(size_t &capacity);
+  void commit(size_t length);
+  void finish(void);
+  void fail(void);
+
+  // Consumer side
+  int next(std::string_view &chunk);
+  void cancel(void);
+  int has_failed(void) const;
+
+  void reset(void);
+
+private:
+  std::vector<std::vector<char>> buffers;
+  std::vector<size_t> lengths;
+  std::deque<int> free_buffers;
+  std::deque<int> filled_buffers;
+  int producing; // buffer held by the producer, -1 if none
+  int consuming; // buffer held by the consumer, -1 if none
+  int finished;  // producer has committed its last chunk
+  int failed;    // producer stopped early because its input was unusable
+  int cancelled; // consumer is no longer interested in chunks
+
+  mutable std::mutex mutex;
+  std::condition_variable buffer_freed;
+  std::condition_variable buffer_filled;
+};
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef _GAME_DATABASE_H // include guard
+#define _GAME_DATABASE_H
+
+#include "hpce.hpp"
+#include "mapped_file.hpp"
+#include "pgn_chess_game.hpp"
+#include "string_pool.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define DATABASE_VERSION 3
+
+// Binary corpus layout (native byte order, all sections 8 byte aligned):
+//   Database_Header
+//   per game: Tag_Pair[amt_tags],
+//             uint16_t, or uint32_t with GAME_FLAG_WIDE_TOKENS,
+//             move_tokens[amt_moves],
+//             Packed_Move[amt_packed_moves] (GAME_FLAG_PACKED_MOVES) for
+//             games that replay legally from the initial position, and for
+//             games whose moves do not alternate regularly, 4 byte aligned
+//             uint32_t (move_nr << 1 | turn)[amt_moves]
+//   Database_Game_Entry[amt_games]
+//   tag string table:  uint64_t offsets[amt_strings + 1], string bytes
+//   move string table: uint64_t offsets[amt_move_tokens + 1], string bytes
+struct Database_Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order; // 0x01020304 as written by the producing machine
+  uint64_t amt_games;
+  uint64_t amt_strings;
+  uint64_t amt_move_tokens;
+  uint64_t games_offset;
+  uint64_t strings_offset;
+  uint64_t move_tokens_offset;
+};
+
+#define GAME_FLAG_BLACK_FIRST 1  // first move is black's move
+#define GAME_FLAG_MOVE_NUMBERS 2 // move numbers are stored explicitly
+#define GAME_FLAG_PACKED_MOVES 4 // packed moves follow the move tokens
+#define GAME_FLAG_WIDE_TOKENS 8  // move tokens are stored with 32 bits
+#define GAME_FLAGS_MASK 15
+
+struct Database_Game_Entry {
+  uint64_t data_offset;
+  uint32_t amt_tags;
+  uint32_t amt_moves; // including a trailing termination marker
+  uint32_t first_move_nr;
+  uint32_t flags;
+  uint32_t amt_packed_moves; // plies of a packed game, 0 otherwise
+  uint32_t reserved;
+};
+
+class Game_Database;
+
+// Zero-copy view of a single game inside a mapped Game_Database. Tag and move
+// strings point into the mapping and stay valid while the database is open.
+class Game_View {
+
+public:
+  Game_View(const Game_Database *database, const Database_Game_Entry *entry);
+
+  size_t get_amt_tags(void) const;
+  std::string_view get_tag_key(size_t i) const;
+  std::string_view get_tag_value(size_t i) const;
+  int get_tag(std::string_view key, std::string_view &value) const;
+
+  size_t get_amt_moves(void) const;
+  int has_packed_moves(void) const;
+  size_t get_amt_packed_moves(void) const;
+  Packed_Move get_packed_move(size_t i) const;
+  uint32_t get_move_token(size_t i) const;
+  std::string_view get_move_notation(size_t i) const;
+  Move get_move(size_t i) const;
+
+  void to_game(PGN_Chess_Game &game) const;
+
+private:
+  const Game_Database *database;
+  const Database_Game_Entry *entry;
+  const char *data; // tag pairs, move tokens and packed moves
+};
+
+// Read-only, memory-mapped binary game database.
+class Game_Database {
+
+public:
+  Game_Database(void);
+  ~Game_Database(void);
+
+  int open(std::string file_path);
+  void close(void);
+
+  size_t size(void) const;
+  Game_View get_view(size_t i) const;
+  int get_game(size_t i, PGN_Chess_Game &game);
+  std::vector<PGN_Chess_Game> return_games(void);
+
+  std::string_view get_string(uint32_t id) const;
+  std::string_view get_move_string(uint32_t id) const;
+
+private:
+  friend class Game_View;
+
+  Mapped_File mapped_file;
+  Database_Header header;
+  const Database_Game_Entry *entries;
+  std::shared_ptr<String_Pool> tag_pool; // used by materialized games
+
+  int validate(void);
+  std::string_view table_string(uint64_t table_offset, uint64_t amt,
+                                uint64_t id) const;
+};
+
+// Writes games into the binary database format.
+class Game_Database_Writer {
+
+public:
+  Game_Database_Writer(void);
+  ~Game_Database_Writer(void);
+
+  int open(std::string file_path);
+  int add_game(PGN_Chess_Game &game);
+  int add_pgn(std::string pgn_path);
+  int close(void);
+
+private:
+  std::ofstream out;
+  uint64_t offset;
+  String_Pool strings;
+  String_Pool move_tokens;
+  std::vector<Database_Game_Entry> entries;
+  std::vector<char> game_buffer;
+  std::vector<uint32_t> tokens; // move tokens of the current game
+
+  int pack_moves(PGN_Chess_Game &game, Database_Game_Entry &entry);
+  void write(const void *bytes, size_t length);
+  void align(void);
+  void write_table(const String_Pool &pool);
+};
+
+int convert_pgn_to_database(std::string pgn_path, std::string database_path);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef _GAME_DEDUP_SET_H // include guard
+#define _GAME_DEDUP_SET_H
+
+#include "pgn_chess_game.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Amount of independently locked parts of the set, a power of two
+#define DEDUP_SET_SHARDS 64
+
+// Thread-safe set of 64-bit game fingerprints used to drop repeated games.
+// A fingerprint covers the move sequence without check, mate and annotation
+// glyphs, and optionally the White, Black, Date and Result tags. The set is
+// split into shards with their own lock and open-addressing table, so
+// parallel readers rarely contend and every game costs about 16 bytes.
+class Game_Dedup_Set {
+
+public:
+  Game_Dedup_Set(int use_key_tags = 0);
+  ~Game_Dedup_Set(void);
+
+  Game_Dedup_Set(const Game_Dedup_Set &) = delete;
+  Game_Dedup_Set &operator=(const Game_Dedup_Set &) = delete;
+
+  int insert(PGN_Chess_Game &game);
+  int insert_hash(uint64_t hash);
+  uint64_t hash_game(PGN_Chess_Game &game) const;
+
+  size_t size(void) const;
+  uint64_t get_amt_duplicates(void) const;
+  void clear(void);
+
+private:
+  struct Shard {
+    mutable std::mutex mutex;
+    std::vector<uint64_t> slots; // 0 marks an empty slot
+    size_t amt_hashes = 0;
+  };
+
+  Shard shards[DEDUP_SET_SHARDS];
+  int use_key_tags;
+  std::atomic<uint64_t> amt_duplicates;
+};
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef _GAME_TABLE_H // include guard
+#define _GAME_TABLE_H
+
+#include "pgn_chess_game.hpp"
+#include "pgn_filter.hpp"
+#include "string_pool.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class PGN_Reader;
+class Game_Table;
+
+// Lightweight view of one game of a Game_Table. Returned strings stay valid
+// as long as the table.
+class Game_Table_View {
+
+public:
+  Game_Table_View(const Game_Table *table, size_t game_nr);
+
+  size_t get_game_nr(void) const;
+  size_t get_amt_tags(void) const;
+  std::string_view get_tag_key(size_t i) const;
+  std::string_view get_tag_value(size_t i) const;
+  int get_tag(std::string_view key, std::string_view &value) const;
+
+  int get_white_elo(void) const;
+  int get_black_elo(void) const;
+  int get_date(void) const;
+  int get_result(void) const;
+  int get_eco(void) const;
+
+  size_t get_amt_plies(void) const;
+  std::string_view get_move_notation(size_t i) const;
+  Move get_move(size_t i) const;
+
+private:
+  const Game_Table *table;
+  size_t game_nr;
+};
+
+// Column store for large numbers of games. Typed tags are kept in one
+// contiguous column each, all tag pairs and all moves of all games in one
+// flat array each with per-game offsets, and strings are interned. Scans
+// over a column touch only that column, unlike scans over a vector of
+// PGN_Chess_Games. Moves keep only the played half-moves: empty moves and
+// termination markers are dropped, the result is kept in its column.
+class Game_Table {
+
+public:
+  Game_Table(void);
+  ~Game_Table(void);
+
+  void add_game(PGN_Chess_Game &game);
+  size_t add_games(PGN_Reader &pgn_reader);
+  size_t add_pgn(std::string pgn_path);
+  void clear(void);
+
+  size_t size(void) const;
+  Game_Table_View get_view(size_t game_nr) const;
+
+  std::vector<size_t> select(const PGN_Filter &filter) const;
+  uint64_t sum_plies(void) const;
+  uint64_t sum_plies(const std::vector<size_t> &game_nrs) const;
+
+  const std::vector<int16_t> &get_white_elos(void) const;
+  const std::vector<int16_t> &get_black_elos(void) const;
+  const std::vector<int32_t> &get_dates(void) const;
+  const std::vector<uint8_t> &get_results(void) const;
+  const std::vector<int16_t> &get_ecos(void) const;
+  const std::vector<uint64_t> &get_move_offsets(void) const;
+  const std::vector<uint32_t> &get_move_ids(void) const;
+  const String_Pool &get_move_strings(void) const;
+
+private:
+  friend class Game_Table_View;
+
+  // Typed tag columns, see Typed_Tags
+  std::vector<int16_t> white_elos;
+  std::vector<int16_t> black_elos;
+  std::vector<int32_t> dates;
+  std::vector<uint8_t> results;
+  std::vector<int16_t> ecos;
+
+  // Tag pairs of game i are tag_pairs[tag_offsets[i], tag_offsets[i + 1])
+  std::vector<uint64_t> tag_offsets;
+  std::vector<Tag_Pair> tag_pairs; // ids into strings
+  String_Pool strings;
+
+  // Moves of game i are move_ids[move_offsets[i], move_offsets[i + 1])
+  std::vector<uint64_t> move_offsets;
+  std::vector<uint32_t> move_ids; // ids into move_strings
+  std::vector<uint32_t> first_moves; // move_nr << 1 | turn of the first move
+  String_Pool move_strings;
+
+  // Ids of the last added game's tag pool in strings, UINT32_MAX if unknown
+  std::shared_ptr<String_Pool> remap_pool;
+  std::vector<uint32_t> remap_ids;
+
+  uint32_t remap(uint32_t id);
+};
+
+#endif
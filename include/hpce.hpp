@@ -3,6 +3,7 @@
 
 #include "pgn_reader.hpp"
 #include <array>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -22,6 +23,22 @@
 #define QUEEN_TYPE 4
 #define KING_TYPE 5
 
+#define AMT_SQUARES 64
+
+// Directions of sliding figures; the first four run towards higher squares
+#define DIRECTION_NORTH 0
+#define DIRECTION_NORTH_EAST 1
+#define DIRECTION_EAST 2
+#define DIRECTION_NORTH_WEST 3
+#define DIRECTION_SOUTH_EAST 4
+#define DIRECTION_SOUTH 5
+#define DIRECTION_SOUTH_WEST 6
+#define DIRECTION_WEST 7
+#define AMT_DIRECTIONS 8
+
+// More than the 218 legal moves of the richest known position
+#define MAX_MOVES 256
+
 #define POS_LENGTH 8
 #define NUM_FIGURES 6
 #define INPUT_TOKEN_LENGTH 112
@@ -39,6 +56,18 @@ struct Figure {
   }
 };
 
+// Set of squares, bit i is square i (a1 = 0, h8 = 63)
+typedef uint64_t Bitboard;
+
+// Bitboards of all figures, indexed by figure type + color * NUM_FIGURES
+typedef std::array<Bitboard, NUM_FIGURES * AMT_PLAYERS> Piece_Bitboards;
+
+// Fixed-capacity list of packed moves, filled without heap allocation
+struct Move_List {
+  std::array<Packed_Move, MAX_MOVES> moves;
+  int size = 0;
+};
+
 struct Input_Sequence {
   std::vector<std::array<
       std::array<std::array<int, INPUT_TOKEN_LENGTH>, BOARD_SIZE>, BOARD_SIZE>>
@@ -65,7 +94,8 @@ public:
   static constexpr Figure empty = {0, -1, 0, 1, ' '};
 
   int turn;
-  std::array<std::array<Figure, BOARD_SIZE>, BOARD_SIZE> board;
+  std::array<int8_t, AMT_SQUARES>
+      figures; // figure type + color * NUM_FIGURES per square, or EMPTY_TYPE
   std::array<std::array<int, DIMENSION>, AMT_PLAYERS> king_pos;
   std::array<int, AMT_PLAYERS> king_moved;
   std::array<std::array<int, AMT_ROOK>, AMT_PLAYERS>
@@ -74,93 +104,102 @@ public:
   int play_move(std::string move);
   int print_board();
   int get_score();
-  int is_legal_game(PGN_Chess_Game chess_game);
+  int is_legal_game(PGN_Chess_Game &chess_game);
+  int pack_moves(PGN_Chess_Game &chess_game);
+  int play_packed_move(Packed_Move move);
+  int generate_legal_moves(Move_List &move_list);
+  std::string get_notation(Packed_Move move);
+  int load_fen(const std::string &fen);
+
+  static Packed_Move pack_move(int square_from, int square_to, int promotion,
+                               int flag);
+  static void unpack_move(Packed_Move move, int &square_from, int &square_to,
+                          int &promotion, int &flag);
+
+  Figure get_figure(int rank, int file);
+  Bitboard get_bitboard(int figure_type, int color);
+  Bitboard get_occupancy(int color);
 
   Input_Sequence get_input_sequence(PGN_Chess_Game &game);
 
 private:
-  std::vector<std::array<std::array<Figure, BOARD_SIZE>, BOARD_SIZE>>
-      board_history;
+  std::vector<Piece_Bitboards> board_history;
   std::array<int, DIMENSION> en_passant_target; // Stores the rank and file of
                                                 // the en passant target square
+  std::vector<Packed_Move> packed_sequence; // scratch buffer of replay_game()
+
+  // Bitboards of the position, kept in sync with figures
+  Piece_Bitboards pieces;
+  std::array<Bitboard, AMT_PLAYERS> occupancy;
 
   void init_board();
-  int is_legal_move(std::string move, int &rank_from, int &file_from,
+  void set_figure(int square, int figure);
+  int is_legal_move(const std::string &move, int &rank_from, int &file_from,
                     int &rank_to, int &file_to);
 
   int play_move(std::string move, int &rank_from, int &file_from, int &rank_to,
                 int &file_to);
-
-  void update_move_flags(char piece, int file_from);
-  void update_board(int rank_from, int file_from, int rank_to, int file_to);
-  void promote_piece(char figure_char, int rank_from, int file_from,
-                     int rank_to, int file_to);
-  void handle_castling_update(std::string move);
-
-  int is_legal_figure_move(int figure_type, int &rank_from, int &file_from,
-                           int &rank_to, int &file_to);
-
-  int handle_pawn(std::string move, int &rank_from, int &file_from,
+  int play_packed_move(Packed_Move move, int &rank_from, int &file_from,
+                       int &rank_to, int &file_to);
+  int resolve_move(const std::string &move, Packed_Move &packed);
+  int replay_game(PGN_Chess_Game &game, int print_illegal);
+
+  void update_move_flags(int square_from, int square_to);
+  void update_board(int square_from, int square_to);
+  void promote_piece(int figure_type, int square);
+  void handle_castling_update(int square);
+
+  int parse_move(const std::string &move, int &square_to, Bitboard &from_mask,
+                 int &is_capture);
+  int select_candidate(Bitboard candidates, int square_to, int &rank_from,
+                       int &file_from, int &rank_to, int &file_to);
+  int is_valid_target(int square_to, int is_capture);
+
+  int handle_pawn(const std::string &move, int &rank_from, int &file_from,
                   int &rank_to, int &file_to);
-  int handle_knight(std::string move, int &rank_from, int &file_from,
+  int handle_knight(const std::string &move, int &rank_from, int &file_from,
                     int &rank_to, int &file_to);
-  int handle_bishop(std::string move, int &rank_from, int &file_from,
+  int handle_bishop(const std::string &move, int &rank_from, int &file_from,
                     int &rank_to, int &file_to);
-  int handle_rook(std::string move, int &rank_from, int &file_from,
+  int handle_rook(const std::string &move, int &rank_from, int &file_from,
                   int &rank_to, int &file_to);
-  int handle_queen(std::string move, int &rank_from, int &file_from,
+  int handle_queen(const std::string &move, int &rank_from, int &file_from,
                    int &rank_to, int &file_to);
-  int handle_king(std::string move, int &rank_from, int &file_from,
+  int handle_king(const std::string &move, int &rank_from, int &file_from,
                   int &rank_to, int &file_to);
-  int handle_castling(std::string move, int &rank_from, int &file_from,
+  int handle_castling(const std::string &move, int &rank_from, int &file_from,
                       int &rank_to, int &file_to);
+  int can_castle(int side);
 
   void update_en_passant_target(int rank, int file);
   void reset_en_passant_target();
   int is_en_passant_target(int rank, int file);
 
-  int retrieve_knight_location(std::string move, int &rank_from, int &file_from,
-                               int &rank_to, int &file_to);
-
-  int king_into_check(int rank_from, int file_from, int rank_to, int file_to);
-  int is_under_straight_attack(int rank, int file, int delta_rank,
-                               int delta_file);
-  int is_under_diagonal_attack(int rank, int file, int delta_rank,
-                               int delta_file);
-  int is_under_pawn_attack(int rank, int file);
-  int is_under_knight_attack(int rank, int file);
-
-  int figure_move_is_legal(int figure_type, int &rank_from, int &file_from,
-                           int &rank_to, int &file_to);
-
-  int check_straight_line(int figure_type, int &rank_from, int &file_from,
-                          int rank_to, int file_to);
-  int check_diagonals(int figure_type, int &rank_from, int &file_from,
-                      int &rank_to, int &file_to);
-
-  int find_queen_on_file(int file_from, int &rank_from, int rank_to,
-                         int file_to);
-  int find_queen_on_rank(int rank_from, int &file_from, int rank_to,
-                         int file_to);
-  int find_queen(int &rank_from, int &file_from, int rank_to, int file_to);
-  int check_queen_path(int &rank_from, int &file_from, int rank_to,
-                       int file_to);
-
-  int handle_bishop_disambiguation(std::string move, int &rank_from,
-                                   int &file_from, int &rank_to, int &file_to,
-                                   bool is_capture);
-
-  int handle_knight_disambiguation(std::string move, int &rank_from,
-                                   int &file_from, int &rank_to, int &file_to,
-                                   bool is_capture);
+  int king_into_check(int square_from, int square_to);
+  int is_under_attack(int square, int color, Bitboard occupied,
+                      Bitboard attackers);
+  Bitboard attackers_of(int square, int color, Bitboard occupied);
+  Bitboard pinned_figures(int king_square);
+  int is_under_straight_attack(int square, int color, Bitboard occupied,
+                               Bitboard attackers);
+  int is_under_diagonal_attack(int square, int color, Bitboard occupied,
+                               Bitboard attackers);
+  int is_under_pawn_attack(int square, int color, Bitboard attackers);
+  int is_under_knight_attack(int square, int color, Bitboard attackers);
+
+  static Bitboard rook_attacks(int square, Bitboard occupied);
+  static Bitboard bishop_attacks(int square, Bitboard occupied);
+  static Bitboard ray_attacks(int direction, int square, Bitboard occupied);
 
   std::array<std::array<std::array<int, NUM_FIGURES * 2>, BOARD_SIZE>,
              BOARD_SIZE>
   get_board_snapshot();
   std::array<int, NUM_FIGURES * 2> get_input_token(int i, int j, int k);
 
+  static int to_square(int rank, int file);
+  static int get_figure_type(char piece);
   static int file_to_int(char file);
-  static int is_file(char char_notation);
+  static int is_suffix(char char_notation);
   static bool is_special(const std::string &move);
 };
 
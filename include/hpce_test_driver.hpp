@@ -9,6 +9,8 @@ public:
   HPCE_Test_Driver(void);
   ~HPCE_Test_Driver(void);
 
+  static size_t get_amt_allocations(void);
+
 private:
 };
 
@@ -0,0 +1,34 @@
+#ifndef _MAPPED_FILE_H // include guard
+#define _MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+class Mapped_File {
+
+public:
+  Mapped_File(void);
+  ~Mapped_File(void);
+
+  Mapped_File(const Mapped_File &) = delete;
+  Mapped_File &operator=(const Mapped_File &) = delete;
+
+  int open(const std::string &file_path);
+  void close(void);
+  size_t release(size_t offset);
+
+  int is_open(void) const;
+  size_t size(void) const;
+  std::string_view view(void) const;
+
+private:
+  const char *data;
+  size_t length;
+  int opened;
+  int mapped;      // 1 iff data points into an mmap region
+  size_t released; // pages before this offset have been dropped
+  std::string fallback_buffer; // used on platforms without mmap
+};
+
+#endif
@@ -1,14 +1,37 @@
 #ifndef PGN_CHESS_GAME_HPP
 #define PGN_CHESS_GAME_HPP
 
+#include "string_pool.hpp"
+#include <cstdint>
 #include <map>
+#include <memory>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <vector>
 
+// Allocator-aware, so a pmr vector of moves allocates their notations from
+// its own memory resource, e.g. the arena of a game.
 struct Move {
-  int move_nr;
-  int turn;
-  std::string move_notation;
+  typedef std::pmr::polymorphic_allocator<char> allocator_type;
+
+  int move_nr = 0;
+  int turn = 0;
+  std::pmr::string move_notation;
+
+  Move(void) = default;
+  Move(int move_nr, int turn, std::string_view move_notation,
+       const allocator_type &allocator = {})
+      : move_nr{move_nr}, turn{turn}, move_notation{move_notation, allocator} {}
+  Move(const Move &other, const allocator_type &allocator = {})
+      : move_nr{other.move_nr}, turn{other.turn},
+        move_notation{other.move_notation, allocator} {}
+  Move(Move &&other) = default;
+  Move(Move &&other, const allocator_type &allocator)
+      : move_nr{other.move_nr}, turn{other.turn},
+        move_notation{std::move(other.move_notation), allocator} {}
+  Move &operator=(const Move &other) = default;
+  Move &operator=(Move &&other) = default;
 
   bool operator==(const Move &other) const {
     return move_nr == other.move_nr && turn == other.turn &&
@@ -16,19 +39,150 @@ struct Move {
   }
 };
 
+// Move resolved to its squares by replaying the game, packed into 16 bits:
+// from square (bits 0-5), to square (bits 6-11), promotion piece (bits 12-13)
+// and move flag (bits 14-15). Squares count from a1 = 0 to h8 = 63.
+typedef uint16_t Packed_Move;
+
+#define PACKED_NORMAL 0
+#define PACKED_PROMOTION 1
+#define PACKED_EN_PASSANT 2
+#define PACKED_CASTLING 3
+
+// Promotion piece of a packed move, stored as its figure type minus one
+#define PACKED_BISHOP 0
+#define PACKED_KNIGHT 1
+#define PACKED_ROOK 2
+#define PACKED_QUEEN 3
+
+#define RESULT_UNKNOWN 0 // missing or malformed Result tag
+#define RESULT_WHITE_WINS 1
+#define RESULT_BLACK_WINS 2
+#define RESULT_DRAW 3
+#define RESULT_ONGOING 4 // "*"
+
+// Values of frequently filtered tags, parsed once when the tag pair is added.
+// Elos and the ECO code are -1 and dates are -1 if missing or malformed.
+struct Typed_Tags {
+  int white_elo = -1;
+  int black_elo = -1;
+  int date = -1; // packed as YYYYMMDD, unknown month or day as 0
+  int result = RESULT_UNKNOWN;
+  int eco = -1; // letter A-E times 100 plus the number, e.g. C20 is 220
+};
+
+#define ANNOTATION_COMMENT 0
+#define ANNOTATION_VARIATION 1
+#define ANNOTATION_NAG 2
+
+// Comment, variation or NAG of the movetext. It follows the first move_index
+// moves of the move sequence. Allocator-aware like Move.
+struct Annotation {
+  typedef std::pmr::polymorphic_allocator<char> allocator_type;
+
+  size_t move_index = 0;
+  int type = ANNOTATION_COMMENT;
+  std::pmr::string text;
+
+  Annotation(void) = default;
+  Annotation(size_t move_index, int type, std::string_view text,
+             const allocator_type &allocator = {})
+      : move_index{move_index}, type{type}, text{text, allocator} {}
+  Annotation(const Annotation &other, const allocator_type &allocator = {})
+      : move_index{other.move_index}, type{other.type},
+        text{other.text, allocator} {}
+  Annotation(Annotation &&other) = default;
+  Annotation(Annotation &&other, const allocator_type &allocator)
+      : move_index{other.move_index}, type{other.type},
+        text{std::move(other.text), allocator} {}
+  Annotation &operator=(const Annotation &other) = default;
+  Annotation &operator=(Annotation &&other) = default;
+
+  bool operator==(const Annotation &other) const {
+    return move_index == other.move_index && type == other.type &&
+           text == other.text;
+  }
+};
+
+// Tag pair stored as ids into the String_Pool of its game
+struct Tag_Pair {
+  uint32_t key;
+  uint32_t value;
+};
+
 class PGN_Chess_Game {
 public:
-  PGN_Chess_Game(std::map<std::string, std::string> tag_pairs);
+  PGN_Chess_Game(void);
+  PGN_Chess_Game(const std::map<std::string, std::string> &tag_pairs);
+  PGN_Chess_Game(std::shared_ptr<String_Pool> tag_pool);
+  PGN_Chess_Game(std::shared_ptr<std::pmr::memory_resource> arena);
   ~PGN_Chess_Game(void);
 
-  int add_move(Move move);
+  PGN_Chess_Game(const PGN_Chess_Game &other);
+  PGN_Chess_Game(PGN_Chess_Game &&other) = default;
+  PGN_Chess_Game &operator=(const PGN_Chess_Game &other);
+  PGN_Chess_Game &operator=(PGN_Chess_Game &&other);
+
+  int add_move(const Move &move);
+  int add_move(Move &&move);
+  int add_annotation(const Annotation &annotation);
+  int add_annotation(Annotation &&annotation);
+  int add_annotation(size_t move_index, int type, std::string_view text);
+  int add_tag_pair(std::string_view key, std::string_view value);
+  int get_tag(std::string_view key, std::string_view &value) const;
   std::map<std::string, std::string> get_tag_pairs(void);
+  std::vector<std::pair<std::string_view, std::string_view>>
+  get_tag_pairs_view(void) const;
+  std::shared_ptr<String_Pool> get_tag_pool(void) const;
+  const std::pmr::vector<Tag_Pair> &get_tag_pair_ids(void) const;
+  const Typed_Tags &get_typed_tags(void) const;
+  int get_white_elo(void) const;
+  int get_black_elo(void) const;
+  int get_date(void) const;
+  int get_result(void) const;
+  int get_eco(void) const;
   std::vector<Move> get_move_sequence(void);
-  void set_move_sequence(std::vector<Move> &p_move_sequence);
+  std::vector<Annotation> get_annotations(void);
+  const std::pmr::vector<Move> &get_move_sequence_view(void);
+  const std::pmr::vector<Annotation> &get_annotations_view(void);
+  const std::pmr::vector<Packed_Move> &get_packed_moves_view(void) const;
+  std::vector<Packed_Move> get_packed_moves(void) const;
+  int has_packed_moves(void) const;
+  size_t get_amt_moves(void);
+  size_t get_amt_plies(void);
+  void reserve_moves(size_t amt_moves);
+  void reserve_tag_pairs(size_t amt_tag_pairs);
+  void set_move_sequence(const std::vector<Move> &p_move_sequence);
+  void set_tag_pairs(const std::map<std::string, std::string> &p_tag_pairs);
+  void set_packed_moves(const Packed_Move *p_packed_moves, size_t amt_moves);
+  void set_tag_pool(std::shared_ptr<String_Pool> p_tag_pool);
+  void set_raw_movetext(std::string_view movetext,
+                        std::shared_ptr<const void> owner,
+                        int capture_annotations = 0);
+  std::string_view get_raw_movetext(void) const;
+  int is_tokenized(void) const;
+  void clear(void);
 
 private:
-  std::map<std::string, std::string> tag_pairs;
-  std::vector<Move> move_sequence;
+  // Keeps the arena alive that the buffers below may be allocated from, so it
+  // is declared first and destroyed last. Assignments keep the arena of the
+  // assigned-to game, copies allocate from the heap.
+  std::shared_ptr<std::pmr::memory_resource> arena;
+  std::shared_ptr<String_Pool> tag_pool; // shared by all games of a reader
+  std::pmr::vector<Tag_Pair> tag_pairs;
+  Typed_Tags typed_tags;
+  std::pmr::vector<Move> move_sequence;
+  std::pmr::vector<Annotation> annotations;
+  std::pmr::vector<Packed_Move> packed_moves; // one per ply once replayed
+
+  // Movetext that is tokenized into move_sequence on first access. owner
+  // keeps the bytes raw_movetext points into alive.
+  std::shared_ptr<const void> raw_movetext_owner;
+  std::string_view raw_movetext;
+  int raw_capture_annotations = 0;
+  int tokenized = 1;
+
+  void tokenize(void);
 };
 
 #endif // PGN_CHESS_GAME_HPP
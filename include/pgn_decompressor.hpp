@@ -0,0 +1,40 @@
+#ifndef _PGN_DECOMPRESSOR_H // include guard
+#define _PGN_DECOMPRESSOR_H
+
+#include "chunk_queue.hpp"
+#include <string_view>
+#include <thread>
+
+#define COMPRESSION_NONE 0
+#define COMPRESSION_GZIP 1
+#define COMPRESSION_ZSTD 2
+
+// Decompresses a gzip or zstd stream on a producer thread into a bounded set
+// of buffers, so that decompression overlaps with parsing.
+class PGN_Decompressor {
+
+public:
+  PGN_Decompressor(void);
+  ~PGN_Decompressor(void);
+
+  static int detect_compression(std::string_view data);
+  static int is_supported(int compression);
+
+  int start(std::string_view input, int compression);
+  int next_chunk(std::string_view &chunk);
+  void stop(void);
+
+  int has_error(void) const;
+
+private:
+  Chunk_Queue chunk_queue;
+  std::thread producer;
+  std::string_view input;
+  int compression;
+
+  void produce(void);
+  int inflate_gzip(void);
+  int decompress_zstd(void);
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef _PGN_DIAGNOSTICS_H // include guard
+#define _PGN_DIAGNOSTICS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define DIAGNOSTIC_MALFORMED_TAG_PAIR 0
+#define DIAGNOSTIC_MISSING_TAG_ROSTER 1
+#define DIAGNOSTIC_DUPLICATE_GAME 2
+#define DIAGNOSTIC_TRUNCATED_INPUT 3
+#define DIAGNOSTIC_RESTARTED_INPUT 4 // followed file shrank, read from start
+#define DIAGNOSTIC_UNSUPPORTED_INPUT 5 // compression not built in
+#define DIAGNOSTIC_AMT_CATEGORIES 6
+
+// Sampled messages kept per category
+#define DIAGNOSTIC_MAX_SAMPLES 8
+
+struct Diagnostic {
+  int category;
+  uint64_t offset;  // byte offset in the (decompressed) PGN text
+  uint64_t game_nr; // index of the game in the file
+};
+
+// Collects parser problems as per-category counters and a bounded sample of
+// located messages. Reporting only updates memory, the collected problems
+// are written out once by summary(). Not thread-safe, parallel parsers use
+// one instance per worker and merge() them afterwards.
+class PGN_Diagnostics {
+
+public:
+  PGN_Diagnostics(size_t max_samples = DIAGNOSTIC_MAX_SAMPLES);
+  ~PGN_Diagnostics(void);
+
+  void report(int category, uint64_t offset, uint64_t game_nr);
+  void merge(const PGN_Diagnostics &other, uint64_t game_nr_base);
+  void reset(void);
+
+  uint64_t get_count(int category) const;
+  uint64_t get_total_count(void) const;
+  const std::vector<Diagnostic> &get_samples(void) const;
+  std::string summary(void) const;
+
+  static const char *get_message(int category);
+
+private:
+  uint64_t counts[DIAGNOSTIC_AMT_CATEGORIES];
+  size_t amt_samples[DIAGNOSTIC_AMT_CATEGORIES];
+  size_t max_samples;
+  std::vector<Diagnostic> samples;
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef _PGN_FILTER_H // include guard
+#define _PGN_FILTER_H
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Tag based game filter. All configured conditions must hold for a game to
+// be accepted. Evaluated on the raw tag section, so rejected games are
+// skipped before their tags are copied or their movetext is tokenized.
+class PGN_Filter {
+
+public:
+  PGN_Filter(void);
+  ~PGN_Filter(void);
+
+  void add_tag_equals(std::string key, std::string value);
+  void set_elo_range(int min_elo, int max_elo);
+  void set_white_elo_range(int min_elo, int max_elo);
+  void set_black_elo_range(int min_elo, int max_elo);
+  int set_date_range(std::string from_date, std::string to_date);
+  void add_eco_prefix(std::string prefix);
+  void clear(void);
+
+  int is_empty(void) const;
+  int matches(std::string_view tag_section) const;
+
+  static int parse_elo(std::string_view value);
+  static int parse_date(std::string_view value, int unknown_part = 0);
+  static int parse_result(std::string_view value);
+  static int parse_eco(std::string_view value);
+
+private:
+  friend class Game_Table; // evaluates the conditions on its columns
+
+  std::vector<std::pair<std::string, std::string>> tag_equals;
+  int white_elo_range[2];
+  int black_elo_range[2];
+  int date_range[2]; // dates packed as YYYYMMDD
+  std::vector<std::string> eco_prefixes;
+
+  int has_white_elo_range;
+  int has_black_elo_range;
+  int has_date_range;
+};
+
+#endif
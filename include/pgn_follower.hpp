@@ -0,0 +1,45 @@
+#ifndef _PGN_FOLLOWER_H // include guard
+#define _PGN_FOLLOWER_H
+
+#include "pgn_diagnostics.hpp"
+#include "pgn_lexer.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+// Milliseconds between checks for growth where inotify is not available
+#define FOLLOW_POLL_INTERVAL 200
+
+// Supplier of game spans from a plain PGN file that is still being appended
+// to. Only complete games are returned: games terminated by a blank line, or
+// whose movetext ends with a termination marker on a finished line. A
+// partially written trailing game is kept back until it is complete. Spans
+// stay valid until the next call to refill() or close().
+class PGN_Follower {
+
+public:
+  PGN_Follower(void);
+  ~PGN_Follower(void);
+
+  int open(const std::string &file_path, uint64_t start_offset = 0);
+  int refill(PGN_Diagnostics &sink, uint64_t game_nr);
+  int next_span(PGN_Game_Span &span);
+  int wait(int timeout_ms);
+  void close(void);
+
+  int is_open(void) const;
+  uint64_t get_offset(void) const;
+
+private:
+  std::string file_path;
+  std::ifstream in;
+  std::string buffer;     // bytes read from the file but not yet consumed
+  uint64_t buffer_offset; // file offset of the first byte of buffer
+  size_t pos;             // end of the last complete game in buffer
+  int inotify_fd;         // -1 if growth is detected by polling
+
+  static int ends_with_result(std::string_view movetext);
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef _PGN_INDEX_H // include guard
+#define _PGN_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define PGN_INDEX_VERSION 1
+
+// Sidecar index header. The index of file.pgn is stored as file.pgn.idx and
+// is followed by amt_games PGN_Index_Entry records in native byte order.
+struct PGN_Index_Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order; // 0x01020304 as written by the producing machine
+  uint64_t file_size;  // size of the indexed PGN file
+  int64_t file_mtime;  // last write time of the indexed PGN file
+  uint64_t amt_games;
+};
+
+struct PGN_Index_Entry {
+  uint64_t offset; // offset of the first tag line
+  uint64_t length; // bytes up to the end of the movetext section
+};
+
+// Byte offsets of all games in a plain PGN file, used for random access.
+class PGN_Index {
+
+public:
+  PGN_Index(void);
+  ~PGN_Index(void);
+
+  static int build(std::string file_path);
+  static std::string index_path(std::string file_path);
+
+  int open(std::string file_path);
+  int scan(std::string_view buffer);
+  void close(void);
+
+  size_t size(void) const;
+  const PGN_Index_Entry &get_entry(size_t game_nr) const;
+
+private:
+  std::vector<PGN_Index_Entry> entries;
+
+  static int file_stamp(const std::string &file_path, uint64_t &file_size,
+                        int64_t &file_mtime);
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef _PGN_LEXER_H // include guard
+#define _PGN_LEXER_H
+
+#include "pgn_chess_game.hpp"
+#include "pgn_scanner.hpp"
+#include <cstddef>
+#include <string_view>
+
+// Byte ranges of a single game inside a PGN buffer. Both views point into
+// the buffer passed to PGN_Lexer::next_game_span().
+struct PGN_Game_Span {
+  size_t offset; // offset of the first tag line
+  size_t length; // bytes up to the end of the movetext section
+  std::string_view tag_section;
+  std::string_view movetext;
+};
+
+class PGN_Lexer {
+public:
+  static int next_game_span(std::string_view buffer, size_t &pos,
+                            PGN_Game_Span &span, int at_end = 1);
+  static size_t next_game_boundary(std::string_view buffer, size_t pos);
+  static std::string_view next_line(std::string_view buffer, size_t &pos);
+  static int parse_tag_pair(std::string_view line, std::string_view &key,
+                            std::string_view &value);
+  static void tokenize_movetext(std::string_view movetext,
+                                PGN_Chess_Game &game,
+                                int capture_annotations = 0);
+
+  static int is_blank(std::string_view line);
+  static std::string_view trim(std::string_view str);
+
+private:
+  static const char *skip_comment(const char *p, const char *end);
+  static const char *skip_line(const char *p, const char *end);
+  static const char *skip_variation(const char *p, Scan_State &state);
+  static const char *skip_whitespace(const char *p, Scan_State &state);
+  static const char *find_token_end(const char *p, Scan_State &state);
+  static int is_space(char c);
+  static int is_digit(char c);
+};
+
+#endif
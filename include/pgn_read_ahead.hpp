@@ -0,0 +1,66 @@
+#ifndef _PGN_READ_AHEAD_H // include guard
+#define _PGN_READ_AHEAD_H
+
+#include "chunk_queue.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+struct io_uring;
+
+// Reads a file front to back into a fixed set of buffers that are kept in
+// flight ahead of the consumer, so that reading overlaps with parsing. Reads
+// are queued with io_uring if available, otherwise a producer thread fills
+// the buffers with pread.
+class PGN_Read_Ahead {
+
+public:
+  PGN_Read_Ahead(size_t amt_buffers, size_t buffer_size);
+  ~PGN_Read_Ahead(void);
+
+  PGN_Read_Ahead(const PGN_Read_Ahead &) = delete;
+  PGN_Read_Ahead &operator=(const PGN_Read_Ahead &) = delete;
+
+  int start(const std::string &file_path);
+  int next_chunk(std::string_view &chunk);
+  void stop(void);
+
+  int has_error(void) const;
+  int uses_io_uring(void) const;
+
+private:
+  size_t amt_buffers;
+  size_t buffer_size;
+  int fd;
+  uint64_t file_size;
+  std::atomic<int> error;
+
+  // pread producer thread
+  std::unique_ptr<Chunk_Queue> chunk_queue;
+  std::thread producer;
+
+  // io_uring submission state, ring is nullptr if io_uring is not used
+  struct io_uring *ring;
+  std::vector<std::vector<char>> ring_buffers;
+  std::vector<uint64_t> ring_offsets;
+  std::vector<int64_t> ring_results; // bytes read, < 0 on error
+  std::vector<int> ring_done;
+  std::deque<int> in_flight; // buffers in file order
+  uint64_t next_offset;
+  int consuming; // buffer held by the consumer, -1 if none
+
+  void produce(void);
+  int start_ring(void);
+  void submit_read(int buffer);
+  int next_ring_chunk(std::string_view &chunk);
+  void stop_ring(void);
+  size_t read_fully(char *buffer, size_t length, uint64_t offset);
+};
+
+#endif
@@ -1,13 +1,34 @@
 #ifndef _PGN_READER_H // include guard
 #define _PGN_READER_H
 
+#include "game_dedup_set.hpp"
 #include "pgn_chess_game.hpp"
+#include "pgn_diagnostics.hpp"
+#include "mapped_file.hpp"
+#include "pgn_filter.hpp"
+#include "pgn_follower.hpp"
+#include "pgn_index.hpp"
+#include "pgn_lexer.hpp"
+#include "pgn_source.hpp"
+#include "string_pool.hpp"
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <vector>
 
+// Fingerprint of a game parsed by a parallel chunk. The fingerprints are
+// added to the dedup set in file order once all chunks are parsed.
+struct Game_Fingerprint {
+  uint64_t hash;
+  uint64_t offset;  // byte offset of the game in the file
+  uint64_t game_nr; // index of the game in its chunk
+};
+
 class PGN_Reader {
 
 public:
@@ -15,12 +36,85 @@ public:
   ~PGN_Reader(void);
 
   std::vector<PGN_Chess_Game> return_games(std::string file_path);
+  std::vector<PGN_Chess_Game> return_games(std::string file_path,
+                                           int num_threads);
+
+  int open(std::string file_path);
+  int next_game(PGN_Chess_Game &game);
+  void close(void);
+
+  int open_index(std::string file_path);
+  size_t get_amt_indexed_games(void) const;
+  int read_game(size_t game_nr, PGN_Chess_Game &game);
+  std::vector<PGN_Chess_Game> read_games(size_t first_game_nr,
+                                         size_t amt_games);
+  void close_index(void);
+
+  int follow(std::string file_path, uint64_t start_offset = 0);
+  int poll_games(std::vector<PGN_Chess_Game> &pgn_chess_games);
+  int wait_for_games(std::vector<PGN_Chess_Game> &pgn_chess_games,
+                     int timeout_ms);
+  uint64_t get_follow_offset(void) const;
+  void stop_following(void);
+
+  void set_filter(const PGN_Filter &filter);
+  void clear_filter(void);
+  void set_capture_annotations(int capture);
+  void set_arena_mode(int arena_mode);
+  void set_lazy_movetext(int lazy);
+  void set_read_ahead(int amt_buffers);
+  void set_dedup(int dedup, int use_key_tags = 0);
+  void set_dedup_set(std::shared_ptr<Game_Dedup_Set> dedup_set);
+  uint64_t get_amt_duplicates(void) const;
+  void set_print_summary(int print);
+  PGN_Diagnostics get_diagnostics(void) const;
 
 private:
+  PGN_Source cursor; // source of the streaming game cursor
+  std::shared_ptr<Mapped_File> indexed_file; // file opened for random access
+  PGN_Index index;
+  PGN_Follower follower; // file followed in tail-follow mode
+  PGN_Filter filter; // games not matching are skipped
+  std::shared_ptr<String_Pool> cursor_tag_pool; // tag strings of open()
+  std::shared_ptr<String_Pool> index_tag_pool; // tag strings of open_index()
+  int capture_annotations; // 1 iff comments, variations and NAGs are kept
+  int arena_mode; // 1 iff games of a read share a monotonic arena
+  int lazy_movetext; // 1 iff movetext is tokenized on first access
+  int amt_read_ahead_buffers; // 0 if plain files are memory-mapped
+  std::shared_ptr<Game_Dedup_Set> dedup_set; // empty if games are not deduped
+
+  // Reads collect their problems in a sink of their own and publish it when
+  // they finish, so concurrent reads on one reader do not share counters
+  PGN_Diagnostics diagnostics; // problems found by the last finished read
+  mutable std::mutex diagnostics_mutex; // guards diagnostics
+  PGN_Diagnostics cursor_diagnostics; // problems of the streaming cursor
+  PGN_Diagnostics follow_diagnostics; // problems of the followed file
+  int print_summary; // 1 iff the diagnostics are printed after each read
+  uint64_t cursor_game_nr;
+  uint64_t follow_game_nr;
+
   std::vector<std::string> seven_tag_roster = {
       "Event", "Site", "Date", "Round", "White", "Black", "Result"};
-  int validate_tag_pair_map(std::map<std::string, std::string> tag_pair_map);
-  static void trim_string(std::string &str);
+  int validate_tag_pairs(const PGN_Chess_Game &game);
+
+  int accept_game(const PGN_Game_Span &span) const;
+  int read_indexed_game(size_t game_nr, PGN_Chess_Game &game,
+                        PGN_Diagnostics &sink);
+  int is_duplicate(PGN_Chess_Game &game, PGN_Diagnostics &sink,
+                   uint64_t offset, uint64_t game_nr);
+  void build_game(const PGN_Game_Span &span, PGN_Chess_Game &game,
+                  PGN_Diagnostics &sink, uint64_t game_nr,
+                  const std::shared_ptr<const void> &span_owner,
+                  const std::shared_ptr<String_Pool> &tag_pool);
+  uint64_t parse_chunk(std::string_view chunk, uint64_t chunk_offset,
+                       std::vector<PGN_Chess_Game> &pgn_chess_games,
+                       std::vector<Game_Fingerprint> &fingerprints,
+                       PGN_Diagnostics &chunk_diagnostics,
+                       const std::shared_ptr<const void> &span_owner,
+                       const std::shared_ptr<String_Pool> &tag_pool);
+  void publish_diagnostics(const PGN_Diagnostics &sink);
+  void finish_read(const PGN_Diagnostics &sink);
+  std::shared_ptr<std::pmr::memory_resource> new_arena(void) const;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,39 @@
+#ifndef _PGN_SCANNER_H // include guard
+#define _PGN_SCANNER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Width of the blocks classified at once, one bit per byte of a mask
+#define SCAN_BLOCK_SIZE 64
+
+// Character classes of a 64 byte block. Bit i is set iff byte i of the block
+// belongs to the class.
+struct Scan_Masks {
+  uint64_t whitespace; // ' ', '\t', '\n', '\v', '\f', '\r'
+  uint64_t annotation; // '{', '(', ')', ';', '$'
+};
+
+// Position of a scan over a buffer and the masks of the block containing it
+struct Scan_State {
+  const char *begin;
+  const char *end;
+  const char *block; // start of the classified block, end if none
+  Scan_Masks masks;
+};
+
+// Classifies 64 byte blocks of PGN text into character class masks, so that
+// the lexer can walk bits instead of testing byte by byte. The classifier
+// uses AVX2 or SSE2, chosen at runtime, or a scalar fallback.
+class PGN_Scanner {
+public:
+  static void start(std::string_view buffer, Scan_State &state);
+  static void load(const char *p, Scan_State &state);
+
+  static void classify(const char *block, Scan_Masks &masks);
+  static void classify_scalar(const char *block, Scan_Masks &masks);
+  static const char *get_isa(void);
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef _PGN_SHARDER_H // include guard
+#define _PGN_SHARDER_H
+
+#include "pgn_decompressor.hpp"
+#include "pgn_writer.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Summary of one written shard, as listed in the manifest
+struct PGN_Shard {
+  std::string file_path;
+  uint64_t amt_games;
+  uint64_t amt_plies;
+  uint64_t amt_bytes; // size of the shard file
+  uint64_t checksum;  // 64-bit FNV-1a of the shard file
+};
+
+// Splits a set of PGN files into shards of about equal total plies. Games are
+// streamed through one reader at a time and each is appended to the shard
+// with the fewest plies so far, so no more than one game is held in memory.
+// A manifest lists the games, plies, size and checksum of every shard.
+class PGN_Sharder {
+
+public:
+  PGN_Sharder(void);
+  ~PGN_Sharder(void);
+
+  void add_input(std::string file_path);
+  int shard(std::string output_prefix, size_t amt_shards,
+            int compression = COMPRESSION_NONE);
+  const std::vector<PGN_Shard> &get_shards(void) const;
+
+  static int checksum_file(std::string file_path, uint64_t &checksum);
+
+private:
+  std::vector<std::string> input_paths;
+  std::vector<PGN_Shard> shards;
+
+  int write_manifest(std::string manifest_path) const;
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef _PGN_SOURCE_H // include guard
+#define _PGN_SOURCE_H
+
+#include "mapped_file.hpp"
+#include "pgn_decompressor.hpp"
+#include "pgn_diagnostics.hpp"
+#include "pgn_lexer.hpp"
+#include "pgn_read_ahead.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Sequential supplier of game spans from a single PGN file. Plain files are
+// scanned in place, or read ahead into buffers if set_read_ahead() was
+// called. gzip and zstd files are decompressed on a producer thread. Read
+// ahead and decompressed chunks are scanned from a carry buffer. Spans stay valid until the next call to
+// next_span() or close(), spans of plain files as long as get_span_owner()
+// is held.
+class PGN_Source {
+
+public:
+  PGN_Source(void);
+  ~PGN_Source(void);
+
+  void set_read_ahead(int amt_buffers);
+  int open(const std::string &file_path, PGN_Diagnostics &sink);
+  int next_span(PGN_Game_Span &span);
+  void close(void);
+
+  int is_open(void) const;
+  int is_compressed(void) const;
+  int is_read_ahead(void) const;
+  int has_error(void) const;
+  uint64_t get_stream_offset(void) const;
+  std::shared_ptr<const void> get_span_owner(void) const;
+
+private:
+  std::shared_ptr<Mapped_File> mapped_file; // shared with lazy games
+  size_t pos;
+  size_t released; // bytes before this offset have been returned to the OS
+
+  PGN_Decompressor decompressor;
+  int compression;
+  int amt_read_ahead_buffers; // 0 if plain files are memory-mapped
+  std::unique_ptr<PGN_Read_Ahead> read_ahead; // nullptr if not reading ahead
+  std::string stream_buffer; // streamed bytes not yet consumed
+  size_t stream_pos;
+  uint64_t stream_offset; // stream offset of the first byte of stream_buffer
+  int stream_end;
+
+  int next_stream_span(PGN_Game_Span &span);
+  int next_chunk(std::string_view &chunk);
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef _PGN_WRITER_H // include guard
+#define _PGN_WRITER_H
+
+#include "pgn_chess_game.hpp"
+#include "pgn_decompressor.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class PGN_Reader;
+
+// Longest movetext line written, as recommended by the PGN export format
+#define PGN_LINE_LENGTH 79
+
+// Serializes games into a PGN file in export format: the seven tag roster
+// first, then the other tag pairs, followed by movetext wrapped at
+// PGN_LINE_LENGTH columns. Output is collected in a large buffer and
+// optionally gzip or zstd compressed.
+class PGN_Writer {
+
+public:
+  PGN_Writer(void);
+  ~PGN_Writer(void);
+
+  int open(std::string file_path, int compression = COMPRESSION_NONE,
+           int level = -1);
+  int add_game(PGN_Chess_Game &game);
+  size_t add_games(PGN_Reader &pgn_reader);
+  size_t add_pgn(std::string pgn_path);
+  int close(void);
+
+  uint64_t get_amt_games(void) const;
+  uint64_t get_amt_bytes(void) const;
+
+  void format_game(PGN_Chess_Game &game, std::string &pgn);
+
+private:
+  std::ofstream out;
+  std::string buffer; // formatted games not yet written
+  std::string compressed_buffer;
+  int compression;
+  void *stream; // z_stream or ZSTD_CStream, nullptr if not compressing
+  uint64_t amt_games;
+  uint64_t amt_bytes; // uncompressed bytes written
+  int failed;
+
+  // Ids of the seven tag roster keys in roster_pool, UINT32_MAX if missing
+  std::shared_ptr<String_Pool> roster_pool;
+  size_t roster_pool_size;
+  uint32_t roster_ids[7];
+
+  std::vector<uint32_t> tag_ids; // keys and values of the formatted game
+  std::vector<std::string_view> tag_strs;
+  std::string movetext; // reused so its bytes are not cleared for every game
+
+  int flush(int finish);
+  int start_compression(int level);
+  void end_compression(void);
+
+  void format_tags(PGN_Chess_Game &game, std::string &pgn);
+  void format_movetext(PGN_Chess_Game &game, std::string &pgn);
+};
+
+#endif
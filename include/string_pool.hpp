@@ -0,0 +1,40 @@
+#ifndef _STRING_POOL_H // include guard
+#define _STRING_POOL_H
+
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Thread-safe pool of interned strings. Every distinct string is stored once
+// and identified by a dense 32-bit id. Views returned by lookup() stay valid
+// for the lifetime of the pool.
+class String_Pool {
+
+public:
+  String_Pool(void);
+  ~String_Pool(void);
+
+  String_Pool(const String_Pool &) = delete;
+  String_Pool &operator=(const String_Pool &) = delete;
+
+  uint32_t intern(std::string_view str);
+  int find(std::string_view str, uint32_t &id) const;
+  std::string_view lookup(uint32_t id) const;
+  void lookup(const uint32_t *ids, size_t amt_ids,
+              std::string_view *strs) const;
+
+  size_t size(void) const;
+  size_t memory_usage(void) const;
+  void clear(void);
+
+private:
+  std::deque<std::string> strings; // deque keeps element addresses stable
+  std::unordered_map<std::string_view, uint32_t> ids; // views into strings
+  size_t amt_bytes;
+  mutable std::shared_mutex mutex;
+};
+
+#endif
@@ -0,0 +1,129 @@
+#include "../include/chunk_queue.hpp"
+#include <condition_variable>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+/**
+ * Default constructor. Allocates amt_buffers buffers of buffer_size bytes.
+ */
+Chunk_Queue::Chunk_Queue(size_t amt_buffers, size_t buffer_size)
+    : buffers(amt_buffers, std::vector<char>(buffer_size)),
+      lengths(amt_buffers, 0) {
+  reset();
+}
+
+/**
+ * Default deconstructor.
+ */
+Chunk_Queue::~Chunk_Queue() {}
+
+/**
+ * Blocks until a free buffer is available and hands it to the producer.
+ * Returns nullptr if the consumer has cancelled the queue.
+ */
+char *Chunk_Queue::acquire(size_t &capacity) {
+  std::unique_lock<std::mutex> lock(mutex);
+  buffer_freed.wait(lock,
+                    [this] { return cancelled || !free_buffers.empty(); });
+  if (cancelled)
+    return nullptr;
+
+  producing = free_buffers.front();
+  free_buffers.pop_front();
+  capacity = buffers[producing].size();
+  return buffers[producing].data();
+}
+
+/**
+ * Publishes the first length bytes of the acquired buffer to the consumer.
+ */
+void Chunk_Queue::commit(size_t length) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (producing < 0)
+    return;
+
+  lengths[producing] = length;
+  filled_buffers.push_back(producing);
+  producing = -1;
+  buffer_filled.notify_one();
+}
+
+/**
+ * Signals that no further chunks will be committed.
+ */
+void Chunk_Queue::finish() {
+  std::lock_guard<std::mutex> lock(mutex);
+  finished = 1;
+  buffer_filled.notify_one();
+}
+
+/**
+ * Signals that the producer stopped early and no further chunks will be
+ * committed. The consumer sees the end of the stream after the chunks that
+ * were already committed, and can tell it apart with has_failed().
+ */
+void Chunk_Queue::fail() {
+  std::lock_guard<std::mutex> lock(mutex);
+  finished = 1;
+  failed = 1;
+  buffer_filled.notify_one();
+}
+
+/**
+ * Returns the buffer of the previous chunk to the producer and blocks until
+ * the next chunk is available. The chunk stays valid until the next call.
+ * Returns 0 once the producer has finished and all chunks were consumed.
+ */
+int Chunk_Queue::next(std::string_view &chunk) {
+  std::unique_lock<std::mutex> lock(mutex);
+  if (consuming >= 0) {
+    free_buffers.push_back(consuming);
+    consuming = -1;
+    buffer_freed.notify_one();
+  }
+
+  buffer_filled.wait(lock,
+                     [this] { return finished || !filled_buffers.empty(); });
+  if (filled_buffers.empty())
+    return 0;
+
+  consuming = filled_buffers.front();
+  filled_buffers.pop_front();
+  chunk = std::string_view(buffers[consuming].data(), lengths[consuming]);
+  return 1;
+}
+
+/**
+ * Wakes up and stops a producer blocked in acquire().
+ */
+void Chunk_Queue::cancel() {
+  std::lock_guard<std::mutex> lock(mutex);
+  cancelled = 1;
+  buffer_freed.notify_all();
+}
+
+/**
+ * Returns 1 if the producer stopped with fail() instead of finish().
+ */
+int Chunk_Queue::has_failed() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return failed;
+}
+
+/**
+ * Returns all buffers to the free list. Must not be called while a producer
+ * is running.
+ */
+void Chunk_Queue::reset() {
+  std::lock_guard<std::mutex> lock(mutex);
+  free_buffers.clear();
+  filled_buffers.clear();
+  for (size_t i = 0; i < buffers.size(); i++)
+    free_buffers.push_back(static_cast<int>(i));
+  producing = -1;
+  consuming = -1;
+  finished = 0;
+  failed = 0;
+  cancelled = 0;
+}
@@ -0,0 +1,676 @@
+#include "../include/game_database.hpp"
+#include "../include/hpce.hpp"
+#include "../include/mapped_file.hpp"
+#include "../include/pgn_chess_game.hpp"
+#include "../include/pgn_reader.hpp"
+#include "../include/string_pool.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+static const char DATABASE_MAGIC[8] = {'H', 'P', 'C', 'E', '_', 'D', 'B', '\0'};
+#define DATABASE_BYTE_ORDER 0x01020304
+
+/**
+ * Returns offset rounded up to the next multiple of alignment.
+ */
+static uint64_t align_up(uint64_t offset, uint64_t alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * Returns whether notation marks the end of the movetext.
+ */
+static int is_termination(std::string_view notation) {
+  return notation == "1-0" || notation == "0-1" || notation == "1/2-1/2" ||
+         notation == "*";
+}
+
+/**
+ * Returns the size of a stored move token.
+ */
+static uint64_t token_size(const Database_Game_Entry *entry) {
+  return entry->flags & GAME_FLAG_WIDE_TOKENS ? sizeof(uint32_t)
+                                              : sizeof(uint16_t);
+}
+
+/**
+ * Returns the offset of the packed moves relative to the game data.
+ */
+static uint64_t packed_moves_offset(const Database_Game_Entry *entry) {
+  return entry->amt_tags * sizeof(Tag_Pair) +
+         static_cast<uint64_t>(entry->amt_moves) * token_size(entry);
+}
+
+/**
+ * Returns the offset of the explicit move numbers relative to the game data.
+ */
+static uint64_t move_numbers_offset(const Database_Game_Entry *entry) {
+  return align_up(packed_moves_offset(entry) +
+                      entry->amt_packed_moves * sizeof(Packed_Move),
+                  sizeof(uint32_t));
+}
+
+/**
+ * Returns the amount of bytes occupied by the data of a game.
+ */
+static uint64_t game_data_size(const Database_Game_Entry *entry) {
+  if (entry->flags & GAME_FLAG_MOVE_NUMBERS)
+    return move_numbers_offset(entry) + entry->amt_moves * sizeof(uint32_t);
+  return packed_moves_offset(entry) +
+         entry->amt_packed_moves * sizeof(Packed_Move);
+}
+
+/**
+ * Returns 1 if move can be played by Chess_Board::play_packed_move() without
+ * touching squares off the board: promotions end on the first or last rank,
+ * en passant captures move diagonally onto the third or sixth rank and
+ * castling moves the king from its initial square to the c or g file.
+ */
+static int is_valid_packed_move(Packed_Move move) {
+  int square_from, square_to, promotion, flag;
+  Chess_Board::unpack_move(move, square_from, square_to, promotion, flag);
+  int rank_from = square_from / 8, rank_to = square_to / 8;
+  int file_distance = std::abs(square_from % 8 - square_to % 8);
+
+  if (square_from == square_to ||
+      (flag != PACKED_PROMOTION && promotion != 0))
+    return 0;
+  switch (flag) {
+  case PACKED_PROMOTION:
+    return rank_to == 0 || rank_to == 7;
+  case PACKED_EN_PASSANT:
+    return file_distance == 1 && ((rank_from == 4 && rank_to == 5) ||
+                                  (rank_from == 3 && rank_to == 2));
+  case PACKED_CASTLING:
+    return (square_from == 4 && (square_to == 2 || square_to == 6)) ||
+           (square_from == 60 && (square_to == 58 || square_to == 62));
+  default:
+    return 1;
+  }
+}
+
+/**
+ * Initializes a view of the game described by entry.
+ */
+Game_View::Game_View(const Game_Database *database,
+                     const Database_Game_Entry *entry)
+    : database{database}, entry{entry},
+      data{database->mapped_file.view().data() + entry->data_offset} {}
+
+/**
+ * Returns the amount of tag pairs of the game.
+ */
+size_t Game_View::get_amt_tags() const { return entry->amt_tags; }
+
+/**
+ * Returns the key of the i-th tag pair.
+ */
+std::string_view Game_View::get_tag_key(size_t i) const {
+  Tag_Pair tp;
+  memcpy(&tp, data + i * sizeof(Tag_Pair), sizeof(Tag_Pair));
+  return database->get_string(tp.key);
+}
+
+/**
+ * Returns the value of the i-th tag pair.
+ */
+std::string_view Game_View::get_tag_value(size_t i) const {
+  Tag_Pair tp;
+  memcpy(&tp, data + i * sizeof(Tag_Pair), sizeof(Tag_Pair));
+  return database->get_string(tp.value);
+}
+
+/**
+ * Sets value to the value of tag key. Returns 0 if the game does not contain
+ * key.
+ */
+int Game_View::get_tag(std::string_view key, std::string_view &value) const {
+  for (size_t i = 0; i < entry->amt_tags; i++) {
+    if (get_tag_key(i) == key) {
+      value = get_tag_value(i);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Returns the amount of moves of the game.
+ */
+size_t Game_View::get_amt_moves() const { return entry->amt_moves; }
+
+/**
+ * Returns 1 if the moves of the game are stored as packed moves.
+ */
+int Game_View::has_packed_moves() const {
+  return (entry->flags & GAME_FLAG_PACKED_MOVES) != 0;
+}
+
+/**
+ * Returns the amount of packed moves, i.e. the moves without the termination
+ * marker. Returns 0 if the game has no packed moves.
+ */
+size_t Game_View::get_amt_packed_moves() const {
+  return entry->amt_packed_moves;
+}
+
+/**
+ * Returns the i-th packed move, which can be played with
+ * Chess_Board::play_packed_move().
+ */
+Packed_Move Game_View::get_packed_move(size_t i) const {
+  Packed_Move move;
+  memcpy(&move, data + packed_moves_offset(entry) + i * sizeof(Packed_Move),
+         sizeof(Packed_Move));
+  return move;
+}
+
+/**
+ * Returns the token of the i-th move, its id in the move string table.
+ */
+uint32_t Game_View::get_move_token(size_t i) const {
+  const char *tokens = data + entry->amt_tags * sizeof(Tag_Pair);
+  if (entry->flags & GAME_FLAG_WIDE_TOKENS) {
+    uint32_t token;
+    memcpy(&token, tokens + i * sizeof(uint32_t), sizeof(uint32_t));
+    return token;
+  }
+  uint16_t token;
+  memcpy(&token, tokens + i * sizeof(uint16_t), sizeof(uint16_t));
+  return token;
+}
+
+/**
+ * Returns the notation of the i-th move.
+ */
+std::string_view Game_View::get_move_notation(size_t i) const {
+  return database->get_move_string(get_move_token(i));
+}
+
+/**
+ * Returns the i-th move as stored by PGN_Chess_Game.
+ */
+Move Game_View::get_move(size_t i) const {
+  Move move;
+  move.move_notation = get_move_notation(i);
+
+  if (entry->flags & GAME_FLAG_MOVE_NUMBERS) {
+    uint32_t packed;
+    memcpy(&packed,
+           data + move_numbers_offset(entry) + i * sizeof(uint32_t),
+           sizeof(uint32_t));
+    move.move_nr = static_cast<int>(packed >> 1);
+    move.turn = static_cast<int>(packed & 1);
+  } else {
+    size_t ply = i + (entry->flags & GAME_FLAG_BLACK_FIRST ? 1 : 0);
+    move.move_nr = static_cast<int>(entry->first_move_nr + ply / 2);
+    move.turn = static_cast<int>(ply % 2);
+  }
+  return move;
+}
+
+/**
+ * Copies the game into game.
+ */
+void Game_View::to_game(PGN_Chess_Game &game) const {
+  game.clear();
+  game.set_tag_pool(database->tag_pool);
+
+  game.reserve_tag_pairs(entry->amt_tags);
+  for (size_t i = 0; i < entry->amt_tags; i++)
+    game.add_tag_pair(get_tag_key(i), get_tag_value(i));
+
+  game.reserve_moves(entry->amt_moves);
+  for (size_t i = 0; i < entry->amt_moves; i++)
+    game.add_move(get_move(i));
+
+  // The packed moves are aligned to their size, see packed_moves_offset()
+  if (has_packed_moves())
+    game.set_packed_moves(
+        reinterpret_cast<const Packed_Move *>(data + packed_moves_offset(entry)),
+        entry->amt_packed_moves);
+}
+
+/**
+ * Default constructor. Initializes a closed database.
+ */
+Game_Database::Game_Database()
+    : header{}, entries{nullptr},
+      tag_pool{std::make_shared<String_Pool>()} {}
+
+/**
+ * Default deconstructor.
+ */
+Game_Database::~Game_Database() {}
+
+/**
+ * Maps the database at file_path. Returns 1 if the file could be opened and
+ * has a valid format.
+ */
+int Game_Database::open(std::string file_path) {
+  close();
+
+  if (!mapped_file.open(file_path))
+    return 0;
+
+  if (!validate()) {
+    close();
+    return 0;
+  }
+
+  entries = reinterpret_cast<const Database_Game_Entry *>(
+      mapped_file.view().data() + header.games_offset);
+  return 1;
+}
+
+/**
+ * Unmaps the database. All views are invalidated.
+ */
+void Game_Database::close() {
+  mapped_file.close();
+  header = Database_Header{};
+  entries = nullptr;
+}
+
+/**
+ * Returns the amount of games in the database.
+ */
+size_t Game_Database::size() const { return header.amt_games; }
+
+/**
+ * Returns a zero-copy view of the i-th game.
+ */
+Game_View Game_Database::get_view(size_t i) const {
+  return Game_View(this, &entries[i]);
+}
+
+/**
+ * Copies the i-th game into game. Returns 0 if there is no such game.
+ */
+int Game_Database::get_game(size_t i, PGN_Chess_Game &game) {
+  if (i >= size())
+    return 0;
+
+  get_view(i).to_game(game);
+  return 1;
+}
+
+/**
+ * Returns all games of the database.
+ */
+std::vector<PGN_Chess_Game> Game_Database::return_games() {
+  std::vector<PGN_Chess_Game> games(size());
+
+  for (size_t i = 0; i < games.size(); i++)
+    get_view(i).to_game(games[i]);
+  return games;
+}
+
+/**
+ * Returns the tag string with the given id.
+ */
+std::string_view Game_Database::get_string(uint32_t id) const {
+  return table_string(header.strings_offset, header.amt_strings, id);
+}
+
+/**
+ * Returns the move notation with the given token.
+ */
+std::string_view Game_Database::get_move_string(uint32_t id) const {
+  return table_string(header.move_tokens_offset, header.amt_move_tokens, id);
+}
+
+/**
+ * Checks the header, that all sections lie within the file and the flags,
+ * move tokens and packed moves of every game. Returns 1 if the database is
+ * valid.
+ */
+int Game_Database::validate() {
+  std::string_view file = mapped_file.view();
+  uint64_t file_size = file.size();
+
+  if (file_size < sizeof(Database_Header))
+    return 0;
+  memcpy(&header, file.data(), sizeof(Database_Header));
+
+  if (memcmp(header.magic, DATABASE_MAGIC, sizeof(DATABASE_MAGIC)) != 0 ||
+      header.version != DATABASE_VERSION ||
+      header.byte_order != DATABASE_BYTE_ORDER ||
+      header.amt_move_tokens > UINT32_MAX)
+    return 0;
+
+  // The string tables are checked against their last offset, which holds the
+  // size of the string bytes
+  for (auto table : {std::make_pair(header.strings_offset, header.amt_strings),
+                     std::make_pair(header.move_tokens_offset,
+                                    header.amt_move_tokens)}) {
+    if (table.second >= file_size / sizeof(uint64_t) ||
+        table.first > file_size - (table.second + 1) * sizeof(uint64_t))
+      return 0;
+
+    uint64_t amt_bytes;
+    memcpy(&amt_bytes,
+           file.data() + table.first + table.second * sizeof(uint64_t),
+           sizeof(uint64_t));
+    if (amt_bytes > file_size - table.first -
+                        (table.second + 1) * sizeof(uint64_t))
+      return 0;
+  }
+
+  if (header.games_offset % alignof(Database_Game_Entry) != 0 ||
+      header.amt_games >= file_size / sizeof(Database_Game_Entry) ||
+      header.games_offset >
+          file_size - header.amt_games * sizeof(Database_Game_Entry))
+    return 0;
+
+  const Database_Game_Entry *games = reinterpret_cast<const Database_Game_Entry *>(
+      file.data() + header.games_offset);
+  for (uint64_t i = 0; i < header.amt_games; i++) {
+    const Database_Game_Entry *entry = &games[i];
+    int is_packed = (entry->flags & GAME_FLAG_PACKED_MOVES) != 0;
+    if ((entry->flags & ~GAME_FLAGS_MASK) || entry->data_offset % 8 != 0 ||
+        (!is_packed && entry->amt_packed_moves != 0) ||
+        (is_packed && (entry->amt_packed_moves > entry->amt_moves ||
+                       entry->amt_moves - entry->amt_packed_moves > 1)) ||
+        entry->data_offset > header.games_offset ||
+        game_data_size(entry) > header.games_offset - entry->data_offset)
+      return 0;
+
+    Game_View view(this, entry);
+    for (size_t j = 0; j < entry->amt_moves; j++) {
+      if (view.get_move_token(j) >= header.amt_move_tokens)
+        return 0;
+    }
+    for (size_t j = 0; j < entry->amt_packed_moves; j++) {
+      if (!is_valid_packed_move(view.get_packed_move(j)))
+        return 0;
+    }
+  }
+
+  return 1;
+}
+
+/**
+ * Returns string id of the string table at table_offset holding amt strings.
+ * Returns an empty string if id is out of range.
+ */
+std::string_view Game_Database::table_string(uint64_t table_offset,
+                                             uint64_t amt, uint64_t id) const {
+  if (id >= amt)
+    return std::string_view();
+
+  const char *table = mapped_file.view().data() + table_offset;
+  uint64_t begin, end;
+  memcpy(&begin, table + id * sizeof(uint64_t), sizeof(uint64_t));
+  memcpy(&end, table + (id + 1) * sizeof(uint64_t), sizeof(uint64_t));
+
+  uint64_t amt_bytes;
+  memcpy(&amt_bytes, table + amt * sizeof(uint64_t), sizeof(uint64_t));
+  if (begin > end || end > amt_bytes)
+    return std::string_view();
+
+  const char *bytes = table + (amt + 1) * sizeof(uint64_t);
+  return std::string_view(bytes + begin, end - begin);
+}
+
+/**
+ * Default constructor. Initializes a closed writer.
+ */
+Game_Database_Writer::Game_Database_Writer() : offset{0} {}
+
+/**
+ * Default deconstructor. Completes the database if it is still open.
+ */
+Game_Database_Writer::~Game_Database_Writer() {
+  if (out.is_open())
+    close();
+}
+
+/**
+ * Creates the database at file_path. Returns 1 if the file could be created.
+ */
+int Game_Database_Writer::open(std::string file_path) {
+  if (out.is_open())
+    close();
+
+  out.open(file_path, std::ios::binary | std::ios::trunc);
+  if (!out.is_open())
+    return 0;
+
+  offset = 0;
+  strings.clear();
+  move_tokens.clear();
+  entries.clear();
+
+  // The header is completed by close()
+  Database_Header header{};
+  write(&header, sizeof(Database_Header));
+  return 1;
+}
+
+/**
+ * Appends game to the database. The moves of every game are stored as move
+ * tokens, legal games additionally as packed moves. Returns 0 if the database
+ * is not open.
+ */
+int Game_Database_Writer::add_game(PGN_Chess_Game &game) {
+  if (!out.is_open())
+    return 0;
+
+  const std::pmr::vector<Move> &moves = game.get_move_sequence_view();
+  std::shared_ptr<String_Pool> tag_pool = game.get_tag_pool();
+  const std::pmr::vector<Tag_Pair> &tag_pairs = game.get_tag_pair_ids();
+
+  Database_Game_Entry entry{};
+  entry.data_offset = offset;
+  entry.amt_tags = static_cast<uint32_t>(tag_pairs.size());
+  entry.amt_moves = static_cast<uint32_t>(moves.size());
+  if (!moves.empty()) {
+    entry.first_move_nr = static_cast<uint32_t>(moves[0].move_nr);
+    entry.flags = moves[0].turn ? GAME_FLAG_BLACK_FIRST : 0;
+  }
+
+  game_buffer.clear();
+  auto append = [&](const void *bytes, size_t length) {
+    const char *begin = static_cast<const char *>(bytes);
+    game_buffer.insert(game_buffer.end(), begin, begin + length);
+  };
+
+  for (const Tag_Pair &tp : tag_pairs) {
+    Tag_Pair database_tp = {strings.intern(tag_pool->lookup(tp.key)),
+                            strings.intern(tag_pool->lookup(tp.value))};
+    append(&database_tp, sizeof(Tag_Pair));
+  }
+
+  // Move numbers are only stored if they can not be derived from the ply
+  for (size_t i = 0; i < moves.size(); i++) {
+    size_t ply = i + (entry.flags & GAME_FLAG_BLACK_FIRST ? 1 : 0);
+    if (moves[i].move_nr < 0 ||
+        static_cast<uint32_t>(moves[i].move_nr) !=
+            entry.first_move_nr + ply / 2 ||
+        moves[i].turn != static_cast<int>(ply % 2))
+      entry.flags |= GAME_FLAG_MOVE_NUMBERS;
+  }
+
+  // Tokens only take 32 bits once the move string table outgrows 16 bit ids
+  tokens.resize(moves.size());
+  for (size_t i = 0; i < moves.size(); i++)
+    tokens[i] = move_tokens.intern(moves[i].move_notation);
+  if (!tokens.empty() &&
+      *std::max_element(tokens.begin(), tokens.end()) > UINT16_MAX)
+    entry.flags |= GAME_FLAG_WIDE_TOKENS;
+
+  for (uint32_t token : tokens) {
+    if (entry.flags & GAME_FLAG_WIDE_TOKENS) {
+      append(&token, sizeof(uint32_t));
+    } else {
+      uint16_t short_token = static_cast<uint16_t>(token);
+      append(&short_token, sizeof(uint16_t));
+    }
+  }
+
+  if (pack_moves(game, entry)) {
+    for (Packed_Move move : game.get_packed_moves_view())
+      append(&move, sizeof(Packed_Move));
+  }
+
+  if (entry.flags & GAME_FLAG_MOVE_NUMBERS) {
+    game_buffer.resize(move_numbers_offset(&entry));
+    for (const Move &move : moves) {
+      uint32_t packed = static_cast<uint32_t>(move.move_nr) << 1 |
+                        static_cast<uint32_t>(move.turn & 1);
+      append(&packed, sizeof(uint32_t));
+    }
+  }
+
+  write(game_buffer.data(), game_buffer.size());
+  align();
+  entries.push_back(entry);
+  return 1;
+}
+
+/**
+ * Packs the moves of game if it starts at the initial position and replays
+ * legally. At most a termination marker may follow the moves. Sets the flags
+ * and amount of packed moves of entry. Returns 1 if the moves of game are
+ * packed.
+ */
+int Game_Database_Writer::pack_moves(PGN_Chess_Game &game,
+                                     Database_Game_Entry &entry) {
+  const std::pmr::vector<Move> &moves = game.get_move_sequence_view();
+  std::string_view fen;
+  if ((entry.flags & (GAME_FLAG_MOVE_NUMBERS | GAME_FLAG_BLACK_FIRST)) ||
+      (!moves.empty() && entry.first_move_nr != 1) || game.get_tag("FEN", fen))
+    return 0;
+
+  size_t amt_plies = moves.size();
+  if (amt_plies > 0 && is_termination(moves.back().move_notation))
+    amt_plies--;
+  for (size_t i = 0; i < amt_plies; i++) {
+    if (moves[i].move_notation.empty() ||
+        is_termination(moves[i].move_notation))
+      return 0;
+  }
+
+  Chess_Board board;
+  if (!game.has_packed_moves() && !board.pack_moves(game))
+    return 0;
+  const std::pmr::vector<Packed_Move> &packed_moves =
+      game.get_packed_moves_view();
+  if (packed_moves.size() != amt_plies)
+    return 0;
+
+  entry.flags |= GAME_FLAG_PACKED_MOVES;
+  entry.amt_packed_moves = static_cast<uint32_t>(amt_plies);
+  return 1;
+}
+
+/**
+ * Appends all games of the PGN file at pgn_path, streaming them one at a time.
+ * Returns 1 if all games were added.
+ */
+int Game_Database_Writer::add_pgn(std::string pgn_path) {
+  PGN_Reader pgn_reader;
+  PGN_Chess_Game game;
+
+  if (!pgn_reader.open(pgn_path))
+    return 0;
+
+  while (pgn_reader.next_game(game)) {
+    if (!add_game(game))
+      return 0;
+  }
+  return 1;
+}
+
+/**
+ * Writes the game index and string tables and completes the header. Returns
+ * 1 if the database was written successfully.
+ */
+int Game_Database_Writer::close() {
+  if (!out.is_open())
+    return 0;
+
+  Database_Header header{};
+  memcpy(header.magic, DATABASE_MAGIC, sizeof(DATABASE_MAGIC));
+  header.version = DATABASE_VERSION;
+  header.byte_order = DATABASE_BYTE_ORDER;
+  header.amt_games = entries.size();
+  header.amt_strings = strings.size();
+  header.amt_move_tokens = move_tokens.size();
+
+  align();
+  header.games_offset = offset;
+  write(entries.data(), entries.size() * sizeof(Database_Game_Entry));
+
+  align();
+  header.strings_offset = offset;
+  write_table(strings);
+
+  align();
+  header.move_tokens_offset = offset;
+  write_table(move_tokens);
+
+  out.seekp(0);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(Database_Header));
+  int success = out.good() ? 1 : 0;
+  out.close();
+  entries.clear();
+  return success;
+}
+
+/**
+ * Writes length bytes to the database file.
+ */
+void Game_Database_Writer::write(const void *bytes, size_t length) {
+  out.write(static_cast<const char *>(bytes), length);
+  offset += length;
+}
+
+/**
+ * Pads the database file to the next 8 byte boundary.
+ */
+void Game_Database_Writer::align() {
+  static const char padding[8] = {};
+  write(padding, align_up(offset, 8) - offset);
+}
+
+/**
+ * Writes the strings of pool as string table.
+ */
+void Game_Database_Writer::write_table(const String_Pool &pool) {
+  uint64_t string_offset = 0;
+
+  for (size_t i = 0; i < pool.size(); i++) {
+    write(&string_offset, sizeof(uint64_t));
+    string_offset += pool.lookup(static_cast<uint32_t>(i)).size();
+  }
+  write(&string_offset, sizeof(uint64_t));
+
+  for (size_t i = 0; i < pool.size(); i++) {
+    std::string_view str = pool.lookup(static_cast<uint32_t>(i));
+    write(str.data(), str.size());
+  }
+}
+
+/**
+ * Converts the PGN file at pgn_path into a game database at database_path.
+ * Returns 1 if the conversion was successful.
+ */
+int convert_pgn_to_database(std::string pgn_path, std::string database_path) {
+  Game_Database_Writer writer;
+
+  if (!writer.open(database_path))
+    return 0;
+
+  int success = writer.add_pgn(pgn_path);
+  return writer.close() && success;
+}
@@ -0,0 +1,158 @@
+#include "../include/game_dedup_set.hpp"
+#include "../include/pgn_chess_game.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+// Slots of a shard table when its first hash is added
+#define DEDUP_INITIAL_SLOTS 1024
+
+static const std::string_view dedup_key_tags[] = {"White", "Black", "Date",
+                                                  "Result"};
+
+/**
+ * Adds the bytes of str and a separator to the FNV-1a hash.
+ */
+static uint64_t hash_bytes(uint64_t hash, std::string_view str) {
+  for (unsigned char c : str) {
+    hash ^= c;
+    hash *= FNV_PRIME;
+  }
+  hash ^= 0xff; // not part of any notation, separates the strings
+  return hash * FNV_PRIME;
+}
+
+/**
+ * Constructor. If use_key_tags is 1, games only count as duplicates if their
+ * White, Black, Date and Result tags are equal as well.
+ */
+Game_Dedup_Set::Game_Dedup_Set(int use_key_tags)
+    : use_key_tags{use_key_tags}, amt_duplicates{0} {}
+
+/**
+ * Default deconstructor.
+ */
+Game_Dedup_Set::~Game_Dedup_Set() {}
+
+/**
+ * Adds the fingerprint of game to the set. Returns 1 if no equal game was
+ * added before, otherwise counts game as a duplicate and returns 0.
+ */
+int Game_Dedup_Set::insert(PGN_Chess_Game &game) {
+  return insert_hash(hash_game(game));
+}
+
+/**
+ * Adds a fingerprint returned by hash_game() to the set. Returns 1 if it was
+ * not contained yet, otherwise counts a duplicate and returns 0.
+ */
+int Game_Dedup_Set::insert_hash(uint64_t hash) {
+  if (hash == 0) // reserved for empty slots
+    hash = 1;
+
+  // The high bits select the shard, the low bits the slot within it
+  Shard &shard = shards[hash >> 58 & (DEDUP_SET_SHARDS - 1)];
+  std::lock_guard<std::mutex> lock(shard.mutex);
+
+  // Keeps the load factor at most 3/4 so probe sequences stay short
+  if ((shard.amt_hashes + 1) * 4 > shard.slots.size() * 3) {
+    std::vector<uint64_t> old_slots(
+        std::max<size_t>(DEDUP_INITIAL_SLOTS, shard.slots.size() * 2), 0);
+    old_slots.swap(shard.slots);
+    size_t mask = shard.slots.size() - 1;
+    for (uint64_t old_hash : old_slots) {
+      if (old_hash == 0)
+        continue;
+      size_t i = old_hash & mask;
+      while (shard.slots[i] != 0)
+        i = (i + 1) & mask;
+      shard.slots[i] = old_hash;
+    }
+  }
+
+  size_t mask = shard.slots.size() - 1;
+  size_t i = hash & mask;
+  for (; shard.slots[i] != 0; i = (i + 1) & mask) {
+    if (shard.slots[i] == hash) {
+      amt_duplicates++;
+      return 0;
+    }
+  }
+  shard.slots[i] = hash;
+  shard.amt_hashes++;
+  return 1;
+}
+
+/**
+ * Returns the fingerprint of game. Moves are compared without their check,
+ * mate and annotation glyphs, the empty move and the termination marker at
+ * the end of the move sequence are left out. Lazily read movetext is
+ * tokenized.
+ */
+uint64_t Game_Dedup_Set::hash_game(PGN_Chess_Game &game) const {
+  uint64_t hash = FNV_OFFSET_BASIS;
+
+  for (const Move &move : game.get_move_sequence_view()) {
+    std::string_view notation = move.move_notation;
+    while (!notation.empty() &&
+           std::string_view("+#!?").find(notation.back()) !=
+               std::string_view::npos)
+      notation.remove_suffix(1);
+    if (notation.empty() || notation == "1-0" || notation == "0-1" ||
+        notation == "1/2-1/2" || notation == "*")
+      continue;
+    hash = hash_bytes(hash, notation);
+  }
+
+  if (use_key_tags) {
+    std::string_view value;
+    for (std::string_view key : dedup_key_tags) {
+      if (!game.get_tag(key, value))
+        value = {};
+      hash = hash_bytes(hash, value);
+    }
+  }
+
+  // Mixes the bits so the shard and slot indices are evenly spread
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+/**
+ * Returns the amount of distinct games in the set.
+ */
+size_t Game_Dedup_Set::size() const {
+  size_t amt_hashes = 0;
+  for (const Shard &shard : shards) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    amt_hashes += shard.amt_hashes;
+  }
+  return amt_hashes;
+}
+
+/**
+ * Returns the amount of duplicates found since the set was created or
+ * cleared.
+ */
+uint64_t Game_Dedup_Set::get_amt_duplicates() const { return amt_duplicates; }
+
+/**
+ * Removes all fingerprints and resets the duplicate count.
+ */
+void Game_Dedup_Set::clear() {
+  for (Shard &shard : shards) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    std::vector<uint64_t>().swap(shard.slots);
+    shard.amt_hashes = 0;
+  }
+  amt_duplicates = 0;
+}
@@ -0,0 +1,383 @@
+#include "../include/game_table.hpp"
+#include "../include/pgn_chess_game.hpp"
+#include "../include/pgn_filter.hpp"
+#include "../include/pgn_reader.hpp"
+#include "../include/string_pool.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Returns 1 if notation is a played move rather than an empty move or a game
+ * termination marker.
+ */
+static int is_played_move(std::string_view notation) {
+  return !notation.empty() && notation != "1-0" && notation != "0-1" &&
+         notation != "1/2-1/2" && notation != "*";
+}
+
+/**
+ * Initializes a view of the game_nr-th game of table.
+ */
+Game_Table_View::Game_Table_View(const Game_Table *table, size_t game_nr)
+    : table{table}, game_nr{game_nr} {}
+
+/**
+ * Returns the index of the game in its table.
+ */
+size_t Game_Table_View::get_game_nr() const { return game_nr; }
+
+/**
+ * Returns the amount of tag pairs of the game.
+ */
+size_t Game_Table_View::get_amt_tags() const {
+  return table->tag_offsets[game_nr + 1] - table->tag_offsets[game_nr];
+}
+
+/**
+ * Returns the key of the i-th tag pair.
+ */
+std::string_view Game_Table_View::get_tag_key(size_t i) const {
+  return table->strings.lookup(
+      table->tag_pairs[table->tag_offsets[game_nr] + i].key);
+}
+
+/**
+ * Returns the value of the i-th tag pair.
+ */
+std::string_view Game_Table_View::get_tag_value(size_t i) const {
+  return table->strings.lookup(
+      table->tag_pairs[table->tag_offsets[game_nr] + i].value);
+}
+
+/**
+ * Sets value to the value of the tag pair with the given key. Returns 0 if
+ * the game has no such tag pair.
+ */
+int Game_Table_View::get_tag(std::string_view key,
+                             std::string_view &value) const {
+  uint32_t key_id;
+  if (!table->strings.find(key, key_id))
+    return 0;
+
+  for (uint64_t i = table->tag_offsets[game_nr];
+       i < table->tag_offsets[game_nr + 1]; i++) {
+    if (table->tag_pairs[i].key == key_id) {
+      value = table->strings.lookup(table->tag_pairs[i].value);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Returns the WhiteElo of the game, -1 if missing.
+ */
+int Game_Table_View::get_white_elo() const {
+  return table->white_elos[game_nr];
+}
+
+/**
+ * Returns the BlackElo of the game, -1 if missing.
+ */
+int Game_Table_View::get_black_elo() const {
+  return table->black_elos[game_nr];
+}
+
+/**
+ * Returns the date of the game packed as YYYYMMDD, -1 if missing.
+ */
+int Game_Table_View::get_date() const { return table->dates[game_nr]; }
+
+/**
+ * Returns the result of the game as one of the RESULT_ constants.
+ */
+int Game_Table_View::get_result() const { return table->results[game_nr]; }
+
+/**
+ * Returns the ECO code of the game as letter * 100 + number, -1 if missing.
+ */
+int Game_Table_View::get_eco() const { return table->ecos[game_nr]; }
+
+/**
+ * Returns the amount of half-moves played in the game.
+ */
+size_t Game_Table_View::get_amt_plies() const {
+  return table->move_offsets[game_nr + 1] - table->move_offsets[game_nr];
+}
+
+/**
+ * Returns the notation of the i-th half-move.
+ */
+std::string_view Game_Table_View::get_move_notation(size_t i) const {
+  return table->move_strings.lookup(
+      table->move_ids[table->move_offsets[game_nr] + i]);
+}
+
+/**
+ * Returns the i-th half-move with its move number and turn.
+ */
+Move Game_Table_View::get_move(size_t i) const {
+  uint32_t first_move = table->first_moves[game_nr];
+  size_t ply = i + (first_move & 1);
+
+  Move move;
+  move.move_nr = static_cast<int>((first_move >> 1) + ply / 2);
+  move.turn = static_cast<int>(ply % 2);
+  move.move_notation = std::string(get_move_notation(i));
+  return move;
+}
+
+/**
+ * Default constructor. Initializes an empty table.
+ */
+Game_Table::Game_Table() : tag_offsets{0}, move_offsets{0} {}
+
+/**
+ * Default deconstructor.
+ */
+Game_Table::~Game_Table() {}
+
+/**
+ * Appends game to the table. Its tag pairs and moves are copied into the
+ * columns, so game can be reused afterwards.
+ */
+void Game_Table::add_game(PGN_Chess_Game &game) {
+  const Typed_Tags &typed_tags = game.get_typed_tags();
+  auto to_int16 = [](int value) {
+    return static_cast<int16_t>(value <= INT16_MAX ? value : -1);
+  };
+  white_elos.push_back(to_int16(typed_tags.white_elo));
+  black_elos.push_back(to_int16(typed_tags.black_elo));
+  dates.push_back(typed_tags.date);
+  results.push_back(static_cast<uint8_t>(typed_tags.result));
+  ecos.push_back(static_cast<int16_t>(typed_tags.eco));
+
+  // Games of a reader share their tag pool, so its ids are remapped once.
+  // Holding remap_pool keeps it alive, so a pool at the same address is the
+  // same pool; it only grows, and remap() extends remap_ids for new ids.
+  std::shared_ptr<String_Pool> tag_pool = game.get_tag_pool();
+  if (tag_pool && tag_pool != remap_pool) {
+    remap_pool = tag_pool;
+    remap_ids.clear();
+  }
+  for (const Tag_Pair &tp : game.get_tag_pair_ids())
+    tag_pairs.push_back({remap(tp.key), remap(tp.value)});
+  tag_offsets.push_back(tag_pairs.size());
+
+  uint32_t first_move = 1 << 1;
+  int amt_plies = 0;
+  for (const Move &move : game.get_move_sequence_view()) {
+    if (!is_played_move(move.move_notation))
+      continue;
+    if (amt_plies++ == 0)
+      first_move = static_cast<uint32_t>(move.move_nr) << 1 | (move.turn & 1);
+    move_ids.push_back(move_strings.intern(move.move_notation));
+  }
+  move_offsets.push_back(move_ids.size());
+  first_moves.push_back(first_move);
+}
+
+/**
+ * Appends all remaining games of the streaming pgn_reader. Only one game is
+ * parsed at a time. Returns the amount of added games.
+ */
+size_t Game_Table::add_games(PGN_Reader &pgn_reader) {
+  PGN_Chess_Game game;
+  size_t amt_added = 0;
+
+  while (pgn_reader.next_game(game)) {
+    add_game(game);
+    amt_added++;
+  }
+  return amt_added;
+}
+
+/**
+ * Appends all games of the PGN file at pgn_path. Returns the amount of added
+ * games.
+ */
+size_t Game_Table::add_pgn(std::string pgn_path) {
+  PGN_Reader pgn_reader;
+
+  if (!pgn_reader.open(pgn_path))
+    return 0;
+  return add_games(pgn_reader);
+}
+
+/**
+ * Removes all games and strings.
+ */
+void Game_Table::clear() {
+  white_elos.clear();
+  black_elos.clear();
+  dates.clear();
+  results.clear();
+  ecos.clear();
+  tag_offsets.assign(1, 0);
+  tag_pairs.clear();
+  strings.clear();
+  move_offsets.assign(1, 0);
+  move_ids.clear();
+  first_moves.clear();
+  move_strings.clear();
+  remap_pool.reset();
+  remap_ids.clear();
+}
+
+/**
+ * Returns the amount of games in the table.
+ */
+size_t Game_Table::size() const { return white_elos.size(); }
+
+/**
+ * Returns a view of the game_nr-th game.
+ */
+Game_Table_View Game_Table::get_view(size_t game_nr) const {
+  return Game_Table_View(this, game_nr);
+}
+
+/**
+ * Returns the numbers of all games matching filter, in ascending order. Every
+ * condition of the filter is evaluated by one pass over its column.
+ */
+std::vector<size_t> Game_Table::select(const PGN_Filter &filter) const {
+  std::vector<uint8_t> matches(size(), 1);
+
+  auto select_range = [&matches](const auto &column, int min, int max) {
+    for (size_t i = 0; i < matches.size(); i++)
+      matches[i] &= column[i] >= 0 && column[i] >= min && column[i] <= max;
+  };
+  if (filter.has_white_elo_range)
+    select_range(white_elos, filter.white_elo_range[0],
+                 filter.white_elo_range[1]);
+  if (filter.has_black_elo_range)
+    select_range(black_elos, filter.black_elo_range[0],
+                 filter.black_elo_range[1]);
+  if (filter.has_date_range)
+    select_range(dates, filter.date_range[0], filter.date_range[1]);
+
+  // A prefix of an ECO code is a range of the packed codes, e.g. "B2" is
+  // B20 to B29
+  if (!filter.eco_prefixes.empty()) {
+    std::vector<uint8_t> eco_matches(size(), 0);
+    for (const std::string &prefix : filter.eco_prefixes) {
+      std::string first = prefix, last = prefix;
+      first.append(3 - std::min<size_t>(prefix.size(), 3), '0');
+      last.append(3 - std::min<size_t>(prefix.size(), 3), '9');
+      int min_eco = prefix.empty() ? -1 : PGN_Filter::parse_eco(first);
+      int max_eco = prefix.empty() ? 499 : PGN_Filter::parse_eco(last);
+      if (!prefix.empty() && (min_eco < 0 || max_eco < 0))
+        continue;
+      for (size_t i = 0; i < eco_matches.size(); i++)
+        eco_matches[i] |= ecos[i] >= min_eco && ecos[i] <= max_eco;
+    }
+    for (size_t i = 0; i < matches.size(); i++)
+      matches[i] &= eco_matches[i];
+  }
+
+  // Tag equality is decided on interned ids, strings that were never added
+  // can not match
+  for (const auto &tag : filter.tag_equals) {
+    uint32_t key_id, value_id;
+    if (!strings.find(tag.first, key_id) ||
+        !strings.find(tag.second, value_id))
+      return {};
+    for (size_t i = 0; i < matches.size(); i++) {
+      if (!matches[i])
+        continue;
+      uint8_t found = 0;
+      for (uint64_t j = tag_offsets[i]; j < tag_offsets[i + 1]; j++)
+        found |= tag_pairs[j].key == key_id && tag_pairs[j].value == value_id;
+      matches[i] = found;
+    }
+  }
+
+  std::vector<size_t> game_nrs;
+  for (size_t i = 0; i < matches.size(); i++) {
+    if (matches[i])
+      game_nrs.push_back(i);
+  }
+  return game_nrs;
+}
+
+/**
+ * Returns the amount of half-moves of all games.
+ */
+uint64_t Game_Table::sum_plies() const { return move_ids.size(); }
+
+/**
+ * Returns the amount of half-moves of the games with the given numbers.
+ */
+uint64_t Game_Table::sum_plies(const std::vector<size_t> &game_nrs) const {
+  uint64_t amt_plies = 0;
+  for (size_t game_nr : game_nrs)
+    amt_plies += move_offsets[game_nr + 1] - move_offsets[game_nr];
+  return amt_plies;
+}
+
+/**
+ * Returns the WhiteElo column, -1 for missing values.
+ */
+const std::vector<int16_t> &Game_Table::get_white_elos() const {
+  return white_elos;
+}
+
+/**
+ * Returns the BlackElo column, -1 for missing values.
+ */
+const std::vector<int16_t> &Game_Table::get_black_elos() const {
+  return black_elos;
+}
+
+/**
+ * Returns the Date column packed as YYYYMMDD, -1 for missing values.
+ */
+const std::vector<int32_t> &Game_Table::get_dates() const { return dates; }
+
+/**
+ * Returns the Result column of RESULT_ constants.
+ */
+const std::vector<uint8_t> &Game_Table::get_results() const { return results; }
+
+/**
+ * Returns the ECO column as letter * 100 + number, -1 for missing values.
+ */
+const std::vector<int16_t> &Game_Table::get_ecos() const { return ecos; }
+
+/**
+ * Returns the offsets of the moves of every game into the move ids, with one
+ * more entry than games.
+ */
+const std::vector<uint64_t> &Game_Table::get_move_offsets() const {
+  return move_offsets;
+}
+
+/**
+ * Returns the moves of all games as ids into the move strings.
+ */
+const std::vector<uint32_t> &Game_Table::get_move_ids() const {
+  return move_ids;
+}
+
+/**
+ * Returns the pool of distinct move notations.
+ */
+const String_Pool &Game_Table::get_move_strings() const {
+  return move_strings;
+}
+
+/**
+ * Returns the id in strings of the string with the given id in remap_pool,
+ * interning it on first use.
+ */
+uint32_t Game_Table::remap(uint32_t id) {
+  if (id >= remap_ids.size())
+    remap_ids.resize(id + 1 + id / 2, UINT32_MAX);
+  if (remap_ids[id] == UINT32_MAX)
+    remap_ids[id] = strings.intern(remap_pool->lookup(id));
+  return remap_ids[id];
+}
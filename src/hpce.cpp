@@ -1,16 +1,161 @@
+#include "../include/game_database.hpp"
+#include "../include/game_table.hpp"
 #include "../include/hpce.hpp"
 #include "../include/pgn_reader.hpp"
+#include "../include/pgn_sharder.hpp"
+#include "../include/pgn_writer.hpp"
 #include <algorithm>
 #include <array>
 #include <cctype>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h> // For automatic conversion of std::vector
+#include <sstream>
 #include <string>
 
 namespace py = pybind11;
 
+static const Bitboard FILE_A_BITBOARD = 0x0101010101010101ULL;
+static const Bitboard RANK_1_BITBOARD = 0xffULL;
+static const Bitboard CASTLING_BITBOARD = 0x9100000000000091ULL; // a, e, h
+static const Bitboard ROOK_CORNERS_BITBOARD = 0x8100000000000081ULL;
+
+// Squares attacked by knights, kings and pawns and the rays of sliding figures
+// from every square, computed once at startup
+struct Attack_Tables {
+  Bitboard knight[AMT_SQUARES];
+  Bitboard king[AMT_SQUARES];
+  Bitboard pawn[AMT_PLAYERS][AMT_SQUARES];
+  Bitboard rays[AMT_DIRECTIONS][AMT_SQUARES];
+  Bitboard rook[AMT_SQUARES];   // rook attacks on an empty board
+  Bitboard bishop[AMT_SQUARES]; // bishop attacks on an empty board
+
+  Attack_Tables(void);
+};
+
+/**
+ * Fills the attack tables by stepping from every square.
+ */
+Attack_Tables::Attack_Tables(void) {
+  const int knight_steps[8][2] = {{2, 1},  {2, -1}, {-2, 1}, {-2, -1},
+                                  {1, 2},  {1, -2}, {-1, 2}, {-1, -2}};
+  const int king_steps[8][2] = {{1, 0},  {1, 1},   {0, 1},  {-1, 1},
+                                {-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+  // Rank and file step of every direction, see DIRECTION_NORTH
+  const int direction_steps[AMT_DIRECTIONS][2] = {
+      {1, 0}, {1, 1}, {0, 1}, {1, -1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}};
+
+  auto on_board = [](int rank, int file) {
+    return rank >= 0 && rank < BOARD_SIZE && file >= 0 && file < BOARD_SIZE;
+  };
+
+  for (int square = 0; square < AMT_SQUARES; square++) {
+    int rank = square / BOARD_SIZE, file = square % BOARD_SIZE;
+
+    knight[square] = king[square] = 0;
+    for (int i = 0; i < 8; i++) {
+      int r = rank + knight_steps[i][0], f = file + knight_steps[i][1];
+      if (on_board(r, f))
+        knight[square] |= 1ULL << (r * BOARD_SIZE + f);
+      r = rank + king_steps[i][0], f = file + king_steps[i][1];
+      if (on_board(r, f))
+        king[square] |= 1ULL << (r * BOARD_SIZE + f);
+    }
+
+    pawn[WHITE][square] = pawn[BLACK][square] = 0;
+    for (int f : {file - 1, file + 1}) {
+      if (on_board(rank + 1, f))
+        pawn[WHITE][square] |= 1ULL << ((rank + 1) * BOARD_SIZE + f);
+      if (on_board(rank - 1, f))
+        pawn[BLACK][square] |= 1ULL << ((rank - 1) * BOARD_SIZE + f);
+    }
+
+    for (int direction = 0; direction < AMT_DIRECTIONS; direction++) {
+      rays[direction][square] = 0;
+      int r = rank + direction_steps[direction][0];
+      int f = file + direction_steps[direction][1];
+      for (; on_board(r, f); r += direction_steps[direction][0],
+                             f += direction_steps[direction][1])
+        rays[direction][square] |= 1ULL << (r * BOARD_SIZE + f);
+    }
+
+    rook[square] = rays[DIRECTION_NORTH][square] |
+                   rays[DIRECTION_EAST][square] |
+                   rays[DIRECTION_SOUTH][square] | rays[DIRECTION_WEST][square];
+    bishop[square] = rays[DIRECTION_NORTH_EAST][square] |
+                     rays[DIRECTION_SOUTH_EAST][square] |
+                     rays[DIRECTION_SOUTH_WEST][square] |
+                     rays[DIRECTION_NORTH_WEST][square];
+  }
+}
+
+static const Attack_Tables attack_tables;
+
+/**
+ * Returns the index of the lowest set bit of bitboard, which must not be 0.
+ */
+static int lowest_bit(Bitboard bitboard) {
+#ifdef __GNUC__
+  return __builtin_ctzll(bitboard);
+#else
+  int i = 0;
+  while (!(bitboard & 1)) {
+    bitboard >>= 1;
+    i++;
+  }
+  return i;
+#endif
+}
+
+/**
+ * Returns the index of the highest set bit of bitboard, which must not be 0.
+ */
+static int highest_bit(Bitboard bitboard) {
+#ifdef __GNUC__
+  return 63 - __builtin_clzll(bitboard);
+#else
+  int i = 0;
+  while (bitboard >>= 1)
+    i++;
+  return i;
+#endif
+}
+
+/**
+ * Returns the amount of set bits of bitboard.
+ */
+static int count_bits(Bitboard bitboard) {
+#ifdef __GNUC__
+  return __builtin_popcountll(bitboard);
+#else
+  int amt_bits = 0;
+  for (; bitboard; bitboard &= bitboard - 1)
+    amt_bits++;
+  return amt_bits;
+#endif
+}
+
+/**
+ * Returns the figure index on square of the position bitboards, or
+ * EMPTY_TYPE.
+ */
+static int figure_at(const Piece_Bitboards &bitboards, int square) {
+  for (int figure = 0; figure < NUM_FIGURES * AMT_PLAYERS; figure++) {
+    if (bitboards[figure] >> square & 1)
+      return figure;
+  }
+  return EMPTY_TYPE;
+}
+
+// Figures by figure type + color * NUM_FIGURES, the index of the bitboards
+static const Figure figure_table[NUM_FIGURES * AMT_PLAYERS] = {
+    Chess_Board::w_pawn,   Chess_Board::w_bishop, Chess_Board::w_knight,
+    Chess_Board::w_rook,   Chess_Board::w_queen,  Chess_Board::w_king,
+    Chess_Board::b_pawn,   Chess_Board::b_bishop, Chess_Board::b_knight,
+    Chess_Board::b_rook,   Chess_Board::b_queen,  Chess_Board::b_king};
+
 /**
  * Default constructor. Initializes board and variables and prints the board.
  */
@@ -52,35 +197,13 @@ Chess_Board::~Chess_Board() {}
  * @param input move notation
  */
 int Chess_Board::play_move(std::string move) {
-  int rank_from = 0, file_from = 0, rank_to = 0, file_to = 0;
+  Packed_Move packed;
 
-  if (!is_legal_move(move, rank_from, file_from, rank_to, file_to)) {
+  if (!resolve_move(move, packed)) {
     return 0; // Move is not legal
   }
 
-  // Update the board
-  update_board(rank_from, file_from, rank_to, file_to);
-
-  // Handle en passant target update
-  if (move.length() == 2 &&
-      (rank_to == 3 || rank_to == 4)) { // Pawn moves two squares
-    int en_passant_rank = turn == WHITE ? rank_to + 1 : rank_to - 1;
-    update_en_passant_target(en_passant_rank, file_to);
-  } else {
-    reset_en_passant_target(); // Reset en passant target after the next move
-  }
-
-  // Handle castling updates
-  if (move == "O-O" || move == "O-O-O") {
-    handle_castling_update(move);
-  }
-
-  // Update king/rook move flags
-  update_move_flags(move[0], file_from);
-
-  // Switch turns
-  turn = !turn;
-
+  play_packed_move(packed);
   return 1; // Move is legal
 }
 
@@ -90,111 +213,258 @@ int Chess_Board::play_move(std::string move) {
  */
 int Chess_Board::play_move(std::string move, int &rank_from, int &file_from,
                            int &rank_to, int &file_to) {
+  Packed_Move packed;
   rank_from = 0, file_from = 0, rank_to = 0, file_to = 0;
 
-  if (!is_legal_move(move, rank_from, file_from, rank_to, file_to)) {
+  if (!resolve_move(move, packed)) {
     return 0; // Move is not legal
   }
 
+  return play_packed_move(packed, rank_from, file_from, rank_to, file_to);
+}
+
+/**
+ * Plays a move that has been resolved before, e.g. by pack_moves(), without
+ * checking its legality or resolving its notation again. Returns 1.
+ * @param input packed move
+ */
+int Chess_Board::play_packed_move(Packed_Move move) {
+  int rank_from, file_from, rank_to, file_to;
+  return play_packed_move(move, rank_from, file_from, rank_to, file_to);
+}
+
+/**
+ * Private method that functions identically to the public play_packed_move()
+ * method, but passes the file and rank params as references.
+ */
+int Chess_Board::play_packed_move(Packed_Move move, int &rank_from,
+                                  int &file_from, int &rank_to, int &file_to) {
+  int square_from, square_to, promotion, flag;
+  unpack_move(move, square_from, square_to, promotion, flag);
+  rank_from = 7 - square_from / BOARD_SIZE;
+  file_from = square_from % BOARD_SIZE;
+  rank_to = 7 - square_to / BOARD_SIZE;
+  file_to = square_to % BOARD_SIZE;
+
+  // Update king/rook move flags before the moved and captured figures are gone
+  update_move_flags(square_from, square_to);
+
+  // Remove the pawn captured en passant, which stands next to the moved pawn
+  if (flag == PACKED_EN_PASSANT) {
+    set_figure(square_from - file_from + file_to, EMPTY_TYPE);
+  }
+
   // Update the board
-  update_board(rank_from, file_from, rank_to, file_to);
+  update_board(square_from, square_to);
+
+  if (flag == PACKED_PROMOTION) {
+    promote_piece(promotion + 1, square_to);
+  } else if (flag == PACKED_CASTLING) {
+    handle_castling_update(square_to);
+  }
 
   // Handle en passant target update
-  if (move.length() == 2 &&
-      (rank_to == 3 || rank_to == 4)) { // Pawn moves two squares
-    int en_passant_rank = turn == WHITE ? rank_to + 1 : rank_to - 1;
-    update_en_passant_target(en_passant_rank, file_to);
+  if (figures[square_to] == PAWN_TYPE + turn * NUM_FIGURES &&
+      abs(rank_to - rank_from) == 2) { // Pawn moves two squares
+    update_en_passant_target((rank_from + rank_to) / 2, file_to);
   } else {
     reset_en_passant_target(); // Reset en passant target after the next move
   }
 
-  // Handle castling updates
-  if (move == "O-O" || move == "O-O-O") {
-    handle_castling_update(move);
+  // Switch turns
+  turn = !turn;
+
+  return 1;
+}
+
+/**
+ * Resolves the notation of a legal move into its packed move. Returns whether
+ * the move is legal (1 = legal).
+ * @param input move notation
+ * @param output packed move, only set if the move is legal
+ */
+int Chess_Board::resolve_move(const std::string &move, Packed_Move &packed) {
+  int rank_from = 0, file_from = 0, rank_to = 0, file_to = 0;
+
+  if (move.empty() ||
+      !is_legal_move(move, rank_from, file_from, rank_to, file_to)) {
+    return 0;
   }
 
-  // Update king/rook move flags
-  update_move_flags(move[0], file_from);
+  int flag = PACKED_NORMAL;
+  int promotion = 0;
+  if (move[0] == 'O') {
+    flag = PACKED_CASTLING;
+  } else if (move[0] >= 'a' && move[0] <= 'h') { // Pawn move
+    if (rank_to == 0 || rank_to == 7) {
+      flag = PACKED_PROMOTION;
+      promotion = PACKED_QUEEN; // Default to queen
+      size_t piece_index = move.find_first_of("NBRQ");
+      if (piece_index != std::string::npos)
+        promotion = get_figure_type(move[piece_index]) - 1;
+    } else if (file_from != file_to &&
+               figures[to_square(rank_to, file_to)] == EMPTY_TYPE) {
+      flag = PACKED_EN_PASSANT;
+    }
+  }
 
-  // Switch turns
-  turn = !turn;
+  packed = pack_move(to_square(rank_from, file_from),
+                     to_square(rank_to, file_to), promotion, flag);
+  return 1;
+}
 
-  return 1; // Move is legal
+/**
+ * Packs a move into 16 bits, see Packed_Move.
+ * @param input square of figure before move (a1 = 0, h8 = 63)
+ * @param input square of figure after move
+ * @param input promotion piece (PACKED_BISHOP to PACKED_QUEEN)
+ * @param input move flag (PACKED_NORMAL to PACKED_CASTLING)
+ */
+Packed_Move Chess_Board::pack_move(int square_from, int square_to,
+                                   int promotion, int flag) {
+  return static_cast<Packed_Move>(square_from | square_to << 6 |
+                                  promotion << 12 | flag << 14);
+}
+
+/**
+ * Unpacks a move packed by pack_move().
+ */
+void Chess_Board::unpack_move(Packed_Move move, int &square_from,
+                              int &square_to, int &promotion, int &flag) {
+  square_from = move & 0x3f;
+  square_to = move >> 6 & 0x3f;
+  promotion = move >> 12 & 0x3;
+  flag = move >> 14 & 0x3;
 }
 
 /**
- * Updates king/rook move flags.
+ * Returns the square (a1 = 0, h8 = 63) of a board position.
  */
-void Chess_Board::update_move_flags(char piece, int file_from) {
-  if (piece == 'K') {
+int Chess_Board::to_square(int rank, int file) {
+  return (7 - rank) * BOARD_SIZE + file;
+}
+
+/**
+ * Updates king/rook move flags. A rook that is captured on its starting
+ * square can no longer castle either.
+ */
+void Chess_Board::update_move_flags(int square_from, int square_to) {
+  // Only moves from or to the starting squares of kings and rooks matter
+  Bitboard squares = 1ULL << square_from | 1ULL << square_to;
+  if (!(squares & CASTLING_BITBOARD))
+    return;
+
+  int figure = figures[square_from];
+  if (figure == KING_TYPE + turn * NUM_FIGURES) {
     king_moved[turn] = 1;
-  } else if (piece == 'R') {
-    rook_moved[turn][(file_from == 0) ? 0 : 1] = 1;
+  } else if (figure == ROOK_TYPE + turn * NUM_FIGURES &&
+             (ROOK_CORNERS_BITBOARD >> square_from & 1) &&
+             square_from / BOARD_SIZE == ((turn == WHITE) ? 0 : 7)) {
+    rook_moved[turn][(square_from % BOARD_SIZE == 0) ? 0 : 1] = 1;
+  }
+
+  if (figures[square_to] == ROOK_TYPE + !turn * NUM_FIGURES &&
+      (ROOK_CORNERS_BITBOARD >> square_to & 1) &&
+      square_to / BOARD_SIZE == ((turn == WHITE) ? 7 : 0)) {
+    rook_moved[!turn][(square_to % BOARD_SIZE == 0) ? 0 : 1] = 1;
   }
 }
 
 /**
  * Updates the board after a move is played.
  */
-void Chess_Board::update_board(int rank_from, int file_from, int rank_to,
-                               int file_to) {
-  // Handle en passant capture
-  if (is_en_passant_target(rank_to, file_to)) {
-    // Remove the captured pawn (which is one rank behind the target square)
-    int captured_rank = turn == WHITE ? rank_to + 1 : rank_to - 1;
-    board[captured_rank][file_to] = empty;
-  }
+void Chess_Board::update_board(int square_from, int square_to) {
+  set_figure(square_to, figures[square_from]);
+  set_figure(square_from, EMPTY_TYPE);
 
-  // std::cout << rank_from << " " << file_from << "\n";
-  // std::cout << rank_to << " " << file_to << "\n";
+  if (figures[square_to] == KING_TYPE + turn * NUM_FIGURES) {
+    king_pos[turn][0] = 7 - square_to / BOARD_SIZE;
+    king_pos[turn][1] = square_to % BOARD_SIZE;
+  }
+}
 
-  board[rank_to][file_to] = board[rank_from][file_from];
-  board[rank_from][file_from] = empty;
+/**
+ * Promotes the pawn piece on square to specified type.
+ */
+void Chess_Board::promote_piece(int figure_type, int square) {
+  set_figure(square, figure_type + turn * NUM_FIGURES);
 }
 
 /**
- * Promotes the pawn piece to specified type.
+ * Handles castling move updates after the king has moved to square.
  */
-void Chess_Board::promote_piece(char figure_char, int rank_from, int file_from,
-                                int rank_to, int file_to) {
-  int figure_type;
+void Chess_Board::handle_castling_update(int square) {
+  int rook = ROOK_TYPE + turn * NUM_FIGURES;
+  if (square % BOARD_SIZE == 6) { // King-side castling
+    set_figure(square + 1, EMPTY_TYPE);
+    set_figure(square - 1, rook);
+  } else { // Queen-side castling
+    set_figure(square - 2, EMPTY_TYPE);
+    set_figure(square + 1, rook);
+  }
+}
 
-  switch (figure_char) {
+/**
+ * Returns the figure type of a piece letter of the move notation.
+ */
+int Chess_Board::get_figure_type(char piece) {
+  switch (piece) {
   case 'N':
-    figure_type = KNIGHT_TYPE;
+    return KNIGHT_TYPE;
   case 'B':
-    figure_type = BISHOP_TYPE;
+    return BISHOP_TYPE;
   case 'R':
-    figure_type = ROOK_TYPE;
+    return ROOK_TYPE;
   case 'Q':
-    figure_type = QUEEN_TYPE;
+    return QUEEN_TYPE;
+  case 'K':
+    return KING_TYPE;
   default:
-    figure_type = EMPTY_TYPE;
+    return PAWN_TYPE;
   }
-
-  Figure curr = board[rank_from][file_from];
-  curr.type = figure_type;
 }
 
 /**
- * Handles castling move updates.
+ * Places the figure with index figure (figure type + color * NUM_FIGURES, or
+ * EMPTY_TYPE) on square and updates the bitboards of the replaced and the
+ * placed figure.
  */
-void Chess_Board::handle_castling_update(std::string move) {
-  if (move == "O-O") { // King-side castling
-    king_moved[turn] = 1;
-    rook_moved[turn][1] = 1;
-    int rank = (turn == WHITE) ? 7 : 0;
-    board[rank][7] = empty;
-    board[rank][5] = (turn == WHITE) ? w_rook : b_rook;
-  } else if (move == "O-O-O") { // Queen-side castling
-    king_moved[turn] = 1;
-    rook_moved[turn][0] = 1;
-    int rank = (turn == WHITE) ? 7 : 0;
-    board[rank][0] = empty;
-    board[rank][3] = (turn == WHITE) ? w_rook : b_rook;
+void Chess_Board::set_figure(int square, int figure) {
+  Bitboard bit = 1ULL << square;
+
+  int curr = figures[square];
+  if (curr != EMPTY_TYPE) {
+    pieces[curr] &= ~bit;
+    occupancy[curr / NUM_FIGURES] &= ~bit;
   }
+
+  figures[square] = figure;
+  if (figure != EMPTY_TYPE) {
+    pieces[figure] |= bit;
+    occupancy[figure / NUM_FIGURES] |= bit;
+  }
+}
+
+/**
+ * Returns the figure on (rank, file).
+ */
+Figure Chess_Board::get_figure(int rank, int file) {
+  int figure = figures[to_square(rank, file)];
+  return figure == EMPTY_TYPE ? empty : figure_table[figure];
+}
+
+/**
+ * Returns the bitboard of the figures of figure_type and color.
+ */
+Bitboard Chess_Board::get_bitboard(int figure_type, int color) {
+  return pieces[figure_type + color * NUM_FIGURES];
 }
 
+/**
+ * Returns the bitboard of all figures of color.
+ */
+Bitboard Chess_Board::get_occupancy(int color) { return occupancy[color]; }
+
 /**
  * Prints the board to stdout for debugging purposes.
  */
@@ -202,7 +472,7 @@ int Chess_Board::print_board() {
   for (int i = 0; i < BOARD_SIZE; i++) {
     std::cout << "|";
     for (int j = 0; j < BOARD_SIZE; j++) {
-      std::cout << board[i][j].symbol << "|";
+      std::cout << get_figure(i, j).symbol << "|";
     }
     std::cout << "\n________________\n";
   }
@@ -220,38 +490,35 @@ void Chess_Board::init_board() {
   en_passant_target[0] = -1;
   en_passant_target[1] = -1;
 
-  for (int j = 0; j < BOARD_SIZE; j++) {
-    board[1][j] = b_pawn;
-    board[6][j] = w_pawn;
+  // Figures of the first rank from the a- to the h-file
+  const int back_rank[BOARD_SIZE] = {ROOK_TYPE,  KNIGHT_TYPE, BISHOP_TYPE,
+                                     QUEEN_TYPE, KING_TYPE,   BISHOP_TYPE,
+                                     KNIGHT_TYPE, ROOK_TYPE};
+
+  figures.fill(EMPTY_TYPE);
+  for (int file = 0; file < BOARD_SIZE; file++) {
+    figures[file] = back_rank[file];
+    figures[BOARD_SIZE + file] = PAWN_TYPE;
+    figures[6 * BOARD_SIZE + file] = PAWN_TYPE + NUM_FIGURES;
+    figures[7 * BOARD_SIZE + file] = back_rank[file] + NUM_FIGURES;
   }
 
-  for (int i = 2; i < 6; i++) {
-    for (int j = 0; j < BOARD_SIZE; j++) {
-      board[i][j] = empty;
-    }
+  // 1st rank white, 8th rank black
+  pieces[PAWN_TYPE] = 0xff00ULL;
+  pieces[BISHOP_TYPE] = 0x24ULL;
+  pieces[KNIGHT_TYPE] = 0x42ULL;
+  pieces[ROOK_TYPE] = 0x81ULL;
+  pieces[QUEEN_TYPE] = 0x08ULL;
+  pieces[KING_TYPE] = 0x10ULL;
+  for (int type = 0; type < NUM_FIGURES; type++) {
+    pieces[type + NUM_FIGURES] = (type == PAWN_TYPE) ? pieces[type] << 40
+                                                     : pieces[type] << 56;
   }
+  occupancy[WHITE] = 0xffffULL;
+  occupancy[BLACK] = 0xffffULL << 48;
 
-  // 8th rank black
-  board[0][0] = b_rook;
-  board[0][1] = b_knight;
-  board[0][2] = b_bishop;
-  board[0][3] = b_queen;
-  board[0][4] = b_king;
-  board[0][5] = b_bishop;
-  board[0][6] = b_knight;
-  board[0][7] = b_rook;
   king_pos[1][0] = 0;
   king_pos[1][1] = 4;
-
-  // 1st rank white
-  board[7][0] = w_rook;
-  board[7][1] = w_knight;
-  board[7][2] = w_bishop;
-  board[7][3] = w_queen;
-  board[7][4] = w_king;
-  board[7][5] = w_bishop;
-  board[7][6] = w_knight;
-  board[7][7] = w_rook;
   king_pos[0][0] = 7;
   king_pos[0][1] = 4;
 
@@ -264,17 +531,122 @@ void Chess_Board::init_board() {
   rook_moved[1][1] = 0;
 }
 
+/**
+ * Sets up the position of a FEN string, e.g. to analyse a position that did
+ * not arise from the initial one. The halfmove clock and move number are
+ * ignored. Returns whether the FEN string is valid (1 = valid); the board is
+ * left unchanged otherwise.
+ * @param input position in Forsyth-Edwards Notation
+ */
+int Chess_Board::load_fen(const std::string &fen) {
+  const char *figure_letters = "PBNRQK"; // indexed by figure type
+
+  std::istringstream stream(fen);
+  std::string placement, side, castling = "-", en_passant = "-";
+  if (!(stream >> placement >> side))
+    return 0;
+  stream >> castling >> en_passant;
+
+  // Placement runs from a8 to h8 down to a1 to h1
+  std::array<int8_t, AMT_SQUARES> parsed;
+  parsed.fill(EMPTY_TYPE);
+  int rank = 7, file = 0;
+  for (char c : placement) {
+    if (c == '/') {
+      if (file != BOARD_SIZE || rank == 0)
+        return 0;
+      rank--;
+      file = 0;
+    } else if (c >= '1' && c <= '8') {
+      file += c - '0';
+      if (file > BOARD_SIZE)
+        return 0;
+    } else {
+      const char *letter = std::strchr(figure_letters, std::toupper(c));
+      if (!c || !letter || file >= BOARD_SIZE)
+        return 0;
+      if (*letter == 'P' && (rank == 0 || rank == 7))
+        return 0; // pawns never stand on the first or last rank
+      int color = std::isupper(c) ? WHITE : BLACK;
+      parsed[rank * BOARD_SIZE + file++] =
+          (letter - figure_letters) + color * NUM_FIGURES;
+    }
+  }
+  if (rank != 0 || file != BOARD_SIZE || (side != "w" && side != "b"))
+    return 0;
+
+  // Castling rights, 0: queen side, 1: king side
+  int rights[AMT_PLAYERS][AMT_ROOK] = {{0, 0}, {0, 0}};
+  if (castling != "-") {
+    for (char c : castling) {
+      switch (c) {
+      case 'K':
+        rights[WHITE][1] = 1;
+        break;
+      case 'Q':
+        rights[WHITE][0] = 1;
+        break;
+      case 'k':
+        rights[BLACK][1] = 1;
+        break;
+      case 'q':
+        rights[BLACK][0] = 1;
+        break;
+      default:
+        return 0;
+      }
+    }
+  }
+
+  int en_passant_rank = -1, en_passant_file = -1;
+  if (en_passant != "-") {
+    if (en_passant.length() != 2 || en_passant[0] < 'a' ||
+        en_passant[0] > 'h' || (en_passant[1] != '3' && en_passant[1] != '6'))
+      return 0;
+    en_passant_rank = 7 - (en_passant[1] - '1');
+    en_passant_file = file_to_int(en_passant[0]);
+  }
+
+  figures.fill(EMPTY_TYPE);
+  pieces.fill(0);
+  occupancy.fill(0);
+  for (int square = 0; square < AMT_SQUARES; square++) {
+    if (parsed[square] != EMPTY_TYPE)
+      set_figure(square, parsed[square]);
+  }
+
+  turn = (side == "w") ? WHITE : BLACK;
+  for (int color = 0; color < AMT_PLAYERS; color++) {
+    king_moved[color] = !rights[color][0] && !rights[color][1];
+    rook_moved[color][0] = !rights[color][0];
+    rook_moved[color][1] = !rights[color][1];
+
+    Bitboard kings = pieces[KING_TYPE + color * NUM_FIGURES];
+    if (kings) {
+      king_pos[color][0] = 7 - lowest_bit(kings) / BOARD_SIZE;
+      king_pos[color][1] = lowest_bit(kings) % BOARD_SIZE;
+    }
+  }
+
+  if (en_passant_rank >= 0)
+    update_en_passant_target(en_passant_rank, en_passant_file);
+  else
+    reset_en_passant_target();
+
+  board_history.clear();
+  return 1;
+}
+
 /**
  * Returns the current game score (in standard notation).
  */
 int Chess_Board::get_score() {
   int score = 0;
 
-  for (int i = 0; i < 8; i++) {
-    for (int j = 0; j < 8; j++) {
-      Figure curr = board[i][j];
-      score += curr.color ? -curr.value : curr.value;
-    }
+  for (int figure = 0; figure < NUM_FIGURES * AMT_PLAYERS; figure++) {
+    Figure curr = figure_table[figure];
+    int value = count_bits(pieces[figure]) * curr.value;
+    score += curr.color ? -value : value;
   }
   return score;
 }
@@ -287,11 +659,15 @@ int Chess_Board::get_score() {
  * En passant and castling information
  * # positions since last capture, pawn move or castle / 100
  * 8 bools denoting if board position is repetition of position in 8 last moves
+ * Games that have been replayed by pack_moves() skip resolving move notations.
  */
 Input_Sequence Chess_Board::get_input_sequence(PGN_Chess_Game &game) {
   Input_Sequence sequence;
-  std::vector<Move> moves = game.get_move_sequence();
+  const std::pmr::vector<Move> &moves = game.get_move_sequence_view();
+  const std::pmr::vector<Packed_Move> &packed_moves =
+      game.get_packed_moves_view();
   int num_moves = moves.size();
+  int num_packed_moves = packed_moves.size();
   int i = 0, last_special_move = 0;
   int rank_from, file_from, rank_to, file_to;
   std::string curr_move;
@@ -303,12 +679,15 @@ Input_Sequence Chess_Board::get_input_sequence(PGN_Chess_Game &game) {
   while (i + POS_LENGTH < num_moves) {
     curr_move = moves[i].move_notation;
 
-    play_move(moves[i].move_notation);
+    if (i < num_packed_moves)
+      play_packed_move(packed_moves[i]);
+    else
+      play_move(curr_move);
     if (is_special(curr_move))
       last_special_move = i;
 
     // Save board history
-    board_history.insert(board_history.begin(), board);
+    board_history.insert(board_history.begin(), pieces);
     if (board_history.size() > 7)
       board_history.pop_back();
 
@@ -319,7 +698,11 @@ Input_Sequence Chess_Board::get_input_sequence(PGN_Chess_Game &game) {
   for (int j = 0; j < POS_LENGTH && i < num_moves; i++, j++) {
     curr_move = moves[i].move_notation;
 
-    play_move(curr_move, rank_from, file_from, rank_to, file_to);
+    if (i < num_packed_moves)
+      play_packed_move(packed_moves[i], rank_from, file_from, rank_to,
+                       file_to);
+    else
+      play_move(curr_move, rank_from, file_from, rank_to, file_to);
     if (is_special(curr_move))
       last_special_move = i;
 
@@ -331,6 +714,7 @@ Input_Sequence Chess_Board::get_input_sequence(PGN_Chess_Game &game) {
     for (int x = 0; x < BOARD_SIZE; x++) {
       for (int y = 0; y < BOARD_SIZE; y++) {
         std::array<int, INPUT_TOKEN_LENGTH> token = {};
+        int square = to_square(x, y);
 
         // 8 one-hot vectors for the last 8 board positions
         for (int k = 0;
@@ -375,7 +759,8 @@ Input_Sequence Chess_Board::get_input_sequence(PGN_Chess_Game &game) {
         // Repetition history for last 8 moves
         for (int k = 0; k < std::min(8, static_cast<int>(board_history.size()));
              k++) {
-          token[102 + k] = (board_history[k][x][y] == board[x][y]);
+          token[102 + k] = (figure_at(board_history[k], square) ==
+                            figures[square]);
         }
 
         board_tokens[x][y] = token;
@@ -385,7 +770,7 @@ Input_Sequence Chess_Board::get_input_sequence(PGN_Chess_Game &game) {
     sequence.board_tokens.push_back(board_tokens);
 
     // Save board history
-    board_history.insert(board_history.begin(), board);
+    board_history.insert(board_history.begin(), pieces);
     if (board_history.size() > 7)
       board_history.pop_back();
   }
@@ -420,13 +805,12 @@ std::array<int, NUM_FIGURES * 2> Chess_Board::get_input_token(int i, int j,
   std::array<int, NUM_FIGURES * 2> B = {0};
   int history_len = board_history.size();
 
-  std::array<std::array<Figure, BOARD_SIZE>, BOARD_SIZE> ref_board =
-      k == 0 ? board : board_history[history_len - k - 1];
+  const Piece_Bitboards &ref_pieces =
+      k == 0 ? pieces : board_history[history_len - k - 1];
 
-  if (!ref_board[i][j].empty) {
-    int type = ref_board[i][j].type;
-    int color = ref_board[i][j].color; // 0 for white, 1 for black
-    B[type + (color * NUM_FIGURES)] = 1;
+  int figure = figure_at(ref_pieces, to_square(i, j));
+  if (figure != EMPTY_TYPE) {
+    B[figure] = 1;
   }
   return B;
 }
@@ -461,20 +845,52 @@ bool Chess_Board::is_special(const std::string &move) {
  * @param input pgn-based chess game
  * @param output 1 iff legal, else 0.
  */
-int Chess_Board::is_legal_game(PGN_Chess_Game game) {
+int Chess_Board::is_legal_game(PGN_Chess_Game &game) {
+  return replay_game(game, 1);
+}
+
+/**
+ * Replays the referenced game and stores the resolved move of each ply in it
+ * as packed move, so that it can be replayed by play_packed_move() without
+ * resolving the move notation again. Returns 1 if and only if all moves are
+ * legal; the packed moves of an illegal game are left empty.
+ * @param input pgn-based chess game
+ */
+int Chess_Board::pack_moves(PGN_Chess_Game &game) {
+  return replay_game(game, 0);
+}
+
+/**
+ * Replays the referenced game from the initial position and stores its packed
+ * moves. Prints the board and the first illegal move if print_illegal is set.
+ */
+int Chess_Board::replay_game(PGN_Chess_Game &game, int print_illegal) {
   init_board();
+  packed_sequence.clear();
 
-  std::vector<Move> move_sequence = game.get_move_sequence();
+  const std::pmr::vector<Move> &move_sequence = game.get_move_sequence_view();
 
-  // TODO: Implement error logic
-  for (Move move : move_sequence) {
-    if (!play_move(move.move_notation)) {
-      print_board();
-      std::cout << move.move_notation << "\n";
+  // The board works on std::string, SAN fits its inline buffer
+  std::string notation;
+  for (const Move &move : move_sequence) {
+    notation = move.move_notation;
+    // Empty move or game termination marker ("1-0", "0-1", "1/2-1/2", "*")
+    if (notation.empty() || isdigit(notation[0]) || notation[0] == '*')
+      continue;
+
+    Packed_Move packed;
+    if (!resolve_move(notation, packed)) {
+      if (print_illegal) {
+        print_board();
+        std::cout << notation << "\n";
+      }
       return 0;
     }
+    play_packed_move(packed);
+    packed_sequence.push_back(packed);
   }
 
+  game.set_packed_moves(packed_sequence.data(), packed_sequence.size());
   return 1;
 }
 
@@ -489,8 +905,8 @@ int Chess_Board::is_legal_game(PGN_Chess_Game game) {
  * @param output rank of figure after move
  * @param output file of figure after move
  */
-int Chess_Board::is_legal_move(std::string move, int &rank_from, int &file_from,
-                               int &rank_to, int &file_to) {
+int Chess_Board::is_legal_move(const std::string &move, int &rank_from,
+                               int &file_from, int &rank_to, int &file_to) {
   // If first letter is uppercase, it is a not a pawn
   if (isupper(move[0])) {
     switch (move[0]) {
@@ -516,20 +932,89 @@ int Chess_Board::is_legal_move(std::string move, int &rank_from, int &file_from,
 }
 
 /**
- * Checks if the figure can move from (rank_from, file_from) to (rank_to,
- * file_to) without putting the king in check.
- * @param input  referenced figure to check
+ * Parses the notation of a figure move such as "Nbd7", "R1xe4" or "Qh4xe1+".
+ * Returns 0 if the notation is malformed.
+ * @param input move notation
+ * @param output square of figure after move
+ * @param output squares the figure may move from, narrowed by the file and
+ *               rank disambiguation
+ * @param output 1 if the move is marked as capture
+ */
+int Chess_Board::parse_move(const std::string &move, int &square_to,
+                            Bitboard &from_mask, int &is_capture) {
+  size_t length = move.length();
+  while (length > 0 && is_suffix(move[length - 1]))
+    length--;
+  if (length < 3)
+    return 0;
+
+  char file = move[length - 2], rank = move[length - 1];
+  if (file < 'a' || file > 'h' || rank < '1' || rank > '8')
+    return 0;
+  square_to = (rank - '1') * BOARD_SIZE + file_to_int(file);
+
+  from_mask = ~0ULL;
+  is_capture = 0;
+  for (size_t i = 1; i + 2 < length; i++) {
+    char c = move[i];
+    if (c == 'x')
+      is_capture = 1;
+    else if (c >= 'a' && c <= 'h')
+      from_mask &= FILE_A_BITBOARD << file_to_int(c);
+    else if (c >= '1' && c <= '8')
+      from_mask &= RANK_1_BITBOARD << (c - '1') * BOARD_SIZE;
+    else
+      return 0;
+  }
+  return 1;
+}
+
+/**
+ * Picks the single candidate figure that can move to square_to without
+ * putting its king in check. Returns 0 if there is no such figure or if the
+ * move notation is ambiguous.
+ * @param input squares of the figures that can reach square_to
+ * @param input square of figure after move
  * @param output rank of figure before move
  * @param output file of figure before me
  * @param output rank of figure after move
  * @param output file of figure after move
  */
-int Chess_Board::is_legal_figure_move(int figure_type, int &rank_from,
-                                      int &file_from, int &rank_to,
-                                      int &file_to) {
-  Figure curr = board[rank_from][file_from];
-  return curr.color == turn && curr.type == figure_type &&
-         !king_into_check(rank_from, file_from, rank_to, file_to);
+int Chess_Board::select_candidate(Bitboard candidates, int square_to,
+                                  int &rank_from, int &file_from, int &rank_to,
+                                  int &file_to) {
+  int square_from = -1;
+
+  while (candidates) {
+    int square = lowest_bit(candidates);
+    candidates &= candidates - 1;
+    if (king_into_check(square, square_to))
+      continue;
+    if (square_from >= 0)
+      return 0; // Ambiguous move
+    square_from = square;
+  }
+
+  if (square_from < 0)
+    return 0;
+
+  rank_from = 7 - square_from / BOARD_SIZE;
+  file_from = square_from % BOARD_SIZE;
+  rank_to = 7 - square_to / BOARD_SIZE;
+  file_to = square_to % BOARD_SIZE;
+  return 1;
+}
+
+/**
+ * Returns whether a figure of the side to move may end its move on
+ * square_to: captures need an opposing figure there, other moves an empty
+ * square.
+ */
+int Chess_Board::is_valid_target(int square_to, int is_capture) {
+  Bitboard target = 1ULL << square_to;
+  if (is_capture)
+    return (occupancy[!turn] & target) != 0;
+  return ((occupancy[WHITE] | occupancy[BLACK]) & target) == 0;
 }
 
 /**
@@ -541,60 +1026,58 @@ int Chess_Board::is_legal_figure_move(int figure_type, int &rank_from,
  * @param output rank of figure after move
  * @param output file of figure after move
  */
-int Chess_Board::handle_pawn(std::string move, int &rank_from, int &file_from,
-                             int &rank_to, int &file_to) {
-  bool is_capture = move.find('x') != std::string::npos;
-
-  if (is_capture) { // Capture case
-    file_to = file_to_int(move[2]);
-    rank_to = 8 - (move[3] - '0');
-
-    // Handle en passant
-    if (is_en_passant_target(rank_to, file_to)) {
-      rank_from = turn == WHITE ? rank_to + 1 : rank_to - 1;
-      file_from = file_to_int(move[0]);
-      return !king_into_check(rank_from, file_from, rank_to, file_to);
-    }
-
-    // Handle regular capture
-    rank_from = turn == WHITE ? rank_to + 1 : rank_to - 1;
-    file_from = file_to_int(move[0]);
-    Figure target = board[rank_to][file_to];
-    return target.color == !turn && target.type != 0 &&
-           !king_into_check(rank_from, file_from, rank_to, file_to);
-  } else { // Non-capture case
-    file_to = file_to_int(move[0]);
-    rank_to = 8 - (move[1] - '0');
-
-    // Handle double-square move (only on starting rank)
-    if ((turn == WHITE && rank_to == 4) || (turn == BLACK && rank_to == 3)) {
-      int start_rank = turn == WHITE ? 6 : 1;
-      int mid_rank = turn == WHITE ? 5 : 2;
-      if (board[rank_to][file_to].empty && board[mid_rank][file_to].empty) {
-        rank_from = start_rank;
-        file_from = file_to;
-        return !king_into_check(rank_from, file_from, rank_to, file_to);
-      }
-    }
-
-    // Handle single-square move
-    int direction = turn == WHITE ? 1 : -1;
-    rank_from = rank_to + direction;
-    file_from = file_to;
-
-    if (board[rank_to][file_to].empty) {
-      // Handle promotion
-      if (rank_to == 0 || rank_to == 7) {
-        char promotion_piece =
-            move.length() > 2 ? move[3] : 'Q'; // Default to queen
-        promote_piece(promotion_piece, rank_from, file_from, rank_to, file_to);
-        return !king_into_check(rank_from, file_from, rank_to, file_to);
-      }
-      return !king_into_check(rank_from, file_from, rank_to, file_to);
-    }
+int Chess_Board::handle_pawn(const std::string &move, int &rank_from,
+                             int &file_from, int &rank_to, int &file_to) {
+  // Strip check markers and the promotion piece, e.g. "exd8=Q+"
+  size_t length = move.length();
+  while (length > 0 && is_suffix(move[length - 1]))
+    length--;
+  if (length > 0 && get_figure_type(move[length - 1]) != PAWN_TYPE)
+    length--;
+  if (length > 0 && move[length - 1] == '=')
+    length--;
+
+  bool is_capture = length == 4 && move[1] == 'x';
+  if (length != 2 && !is_capture)
+    return 0;
+
+  char file = move[length - 2], rank = move[length - 1];
+  if (move[0] < 'a' || move[0] > 'h' || file < 'a' || file > 'h' ||
+      rank < '1' || rank > '8')
+    return 0;
+
+  int square_to = (rank - '1') * BOARD_SIZE + file_to_int(file);
+  int forward = turn == WHITE ? BOARD_SIZE : -BOARD_SIZE;
+  Bitboard pawns = pieces[PAWN_TYPE + turn * NUM_FIGURES];
+  Bitboard occupied = occupancy[WHITE] | occupancy[BLACK];
+  Bitboard candidates = 0;
+
+  if (is_capture) { // Capture case, including en passant
+    int square_from = square_to - forward + file_to_int(move[0]) -
+                      file_to_int(file);
+    if (abs(file_to_int(move[0]) - file_to_int(file)) != 1 ||
+        square_from < 0 || square_from >= AMT_SQUARES)
+      return 0;
+    if (!is_valid_target(square_to, 1) &&
+        !is_en_passant_target(7 - square_to / BOARD_SIZE, file_to_int(file)))
+      return 0;
+    candidates = pawns & 1ULL << square_from;
+  } else { // Non-capture case, single- or double-square move
+    int square_from = square_to - forward;
+    if (square_from < 0 || square_from >= AMT_SQUARES ||
+        (occupied & 1ULL << square_to))
+      return 0;
+    candidates = pawns & 1ULL << square_from;
 
-    return 0; // Illegal move
+    int double_rank = turn == WHITE ? 3 : 4;
+    if (!candidates && square_to / BOARD_SIZE == double_rank &&
+        !(occupied & 1ULL << square_from))
+      candidates = pawns & 1ULL << (square_from - forward);
   }
+
+  // Promotions are applied once the resolved move is played
+  return select_candidate(candidates, square_to, rank_from, file_from, rank_to,
+                          file_to);
 }
 
 /**
@@ -629,105 +1112,22 @@ int Chess_Board::is_en_passant_target(int rank, int file) {
  * @param output rank of figure after move
  * @param output file of figure after move
  */
-int Chess_Board::retrieve_knight_location(std::string move, int &rank_from,
-                                          int &file_from, int &rank_to,
-                                          int &file_to) {
-  // iterate over possible knight positions (copied lots of code from
-  // king_into_check) bottom cases
-  int r, f;
-  r = rank_to + 2;
-  f = file_to;
-
-  if (r < 8) {
-    if (f + 1 < 8) {
-      Figure curr = board[r][f + 1];
-      if (curr.color == turn && curr.type == KNIGHT_TYPE) {
-        rank_from = r;
-        file_from = f + 1;
-        return !king_into_check(rank_from, file_from, rank_to, file_to);
-      }
-    }
-    if (f - 1 >= 0) {
-      Figure curr = board[r][f - 1];
-      if (curr.color == turn && curr.type == KNIGHT_TYPE) {
-        rank_from = r;
-        file_from = f - 1;
-        return !king_into_check(rank_from, file_from, rank_to, file_to);
-      }
-    }
-  }
-
-  // top cases
-  r = rank_to - 2;
-  f = file_to;
-  if (r >= 0) {
-    if (f + 1 < 8) {
-      Figure curr = board[r][f + 1];
-      if (curr.color == turn && curr.type == KNIGHT_TYPE) {
-        rank_from = r;
-        file_from = f + 1;
-        return !king_into_check(rank_from, file_from, rank_to, file_to);
-      }
-    }
-    if (f - 1 >= 0) {
-      Figure curr = board[r][f - 1];
-      if (curr.color == turn && curr.type == KNIGHT_TYPE) {
-        rank_from = r;
-        file_from = f - 1;
-        return !king_into_check(rank_from, file_from, rank_to, file_to);
-      }
-    }
-  }
-
-  // left cases
-  r = rank_to;
-  f = file_to - 2;
-  if (f >= 0) {
-    if (r + 1 < 8) {
-      Figure curr = board[r + 1][f];
-      if (curr.color == turn && curr.type == KNIGHT_TYPE) {
-        rank_from = r + 1;
-        file_from = f;
-        return !king_into_check(rank_from, file_from, rank_to, file_to);
-      }
-    }
-    if (r - 1 >= 0) {
-      Figure curr = board[r - 1][f];
-      if (curr.color == turn && curr.type == KNIGHT_TYPE) {
-        rank_from = r - 1;
-        file_from = f;
-        return !king_into_check(rank_from, file_from, rank_to, file_to);
-      }
-    }
-  }
-
-  // right cases
-  r = rank_to;
-  f = file_to + 2;
-  if (f < 8) {
-    if (r + 1 < 8) {
-      Figure curr = board[r + 1][f];
-      if (curr.color == turn && curr.type == KNIGHT_TYPE) {
-        rank_from = r + 1;
-        file_from = f;
-        return !king_into_check(rank_from, file_from, rank_to, file_to);
-      }
-    }
-    if (r - 1 >= 0) {
-      Figure curr = board[r - 1][f];
-      if (curr.color == turn && curr.type == KNIGHT_TYPE) {
-        rank_from = r - 1;
-        file_from = f;
-        return !king_into_check(rank_from, file_from, rank_to, file_to);
-      }
-    }
-  }
-
-  return 0;
+int Chess_Board::handle_knight(const std::string &move, int &rank_from,
+                               int &file_from, int &rank_to, int &file_to) {
+  int square_to, is_capture;
+  Bitboard from_mask;
+  if (!parse_move(move, square_to, from_mask, is_capture) ||
+      !is_valid_target(square_to, is_capture))
+    return 0;
+
+  Bitboard candidates = attack_tables.knight[square_to] & from_mask &
+                        pieces[KNIGHT_TYPE + turn * NUM_FIGURES];
+  return select_candidate(candidates, square_to, rank_from, file_from, rank_to,
+                          file_to);
 }
 
 /**
- * Returns whether a knight move is legal (1 = legal). Same notations apply as
+ * Returns whether a bishop move is legal (1 = legal). Same notations apply as
  * in is_legal_move().
  * @param input move notation
  * @param output rank of figure before move
@@ -735,786 +1135,582 @@ int Chess_Board::retrieve_knight_location(std::string move, int &rank_from,
  * @param output rank of figure after move
  * @param output file of figure after move
  */
-int Chess_Board::handle_knight(std::string move, int &rank_from, int &file_from,
-                               int &rank_to, int &file_to) {
-  bool is_capture = move.find('x') != std::string::npos;
-
-  if (is_capture) {
-    if (move.length() == 4) { // unambiguous capture
-      file_to = file_to_int(move[2]);
-      rank_to = 8 - (move[3] - '0');
-      // Check all possible knight moves to the target square
-      for (int rank_offset : {-2, -1, 1, 2}) {
-        for (int file_offset : {-2, -1, 1, 2}) {
-          if (abs(rank_offset) != abs(file_offset)) {
-            rank_from = rank_to + rank_offset;
-            file_from = file_to + file_offset;
-            if (is_legal_figure_move(KNIGHT_TYPE, rank_from, file_from, rank_to,
-                                     file_to))
-              return 1;
-          }
-        }
-      }
-    } else { // disambiguous capture
-      return handle_knight_disambiguation(move, rank_from, file_from, rank_to,
-                                          file_to, true);
-    }
-  } else {                    // no capture
-    if (move.length() == 3) { // unambiguous move
-      file_to = file_to_int(move[1]);
-      rank_to = 8 - (move[2] - '0');
-      // Check all possible knight moves to the target square
-      for (int rank_offset : {-2, -1, 1, 2}) {
-        for (int file_offset : {-2, -1, 1, 2}) {
-          if (abs(rank_offset) != abs(file_offset)) {
-            rank_from = rank_to + rank_offset;
-            file_from = file_to + file_offset;
-            if (is_legal_figure_move(KNIGHT_TYPE, rank_from, file_from, rank_to,
-                                     file_to))
-              return 1;
-          }
-        }
-      }
-    } else { // disambiguous move
-      return handle_knight_disambiguation(move, rank_from, file_from, rank_to,
-                                          file_to, false);
-    }
-  }
-
-  return 0; // Illegal move
+int Chess_Board::handle_bishop(const std::string &move, int &rank_from,
+                               int &file_from, int &rank_to, int &file_to) {
+  int square_to, is_capture;
+  Bitboard from_mask;
+  if (!parse_move(move, square_to, from_mask, is_capture) ||
+      !is_valid_target(square_to, is_capture))
+    return 0;
+
+  Bitboard occupied = occupancy[WHITE] | occupancy[BLACK];
+  Bitboard candidates = bishop_attacks(square_to, occupied) & from_mask &
+                        pieces[BISHOP_TYPE + turn * NUM_FIGURES];
+  return select_candidate(candidates, square_to, rank_from, file_from, rank_to,
+                          file_to);
 }
 
 /**
- * Handles the disambiguation logic for knight moves.
+ * Returns whether a rook move is legal (1 = legal). Same notations apply as in
+ * is_legal_move().
  * @param input move notation
  * @param output rank of figure before move
  * @param output file of figure before me
  * @param output rank of figure after move
  * @param output file of figure after move
- * @param input bool denoting if move captures piece
- */
-int Chess_Board::handle_knight_disambiguation(std::string move, int &rank_from,
-                                              int &file_from, int &rank_to,
-                                              int &file_to, bool is_capture) {
-  int move_length = move.length();
-  int file_index = is_capture ? 3 : 2;
-  int rank_index = is_capture ? 4 : 3;
-
-  file_to = file_to_int(move[file_index]);
-  rank_to = 8 - (move[rank_index] - '0');
-
-  if (move_length == (is_capture ? 5 : 4)) { // file or rank disambiguation
-    if (is_file(move[1])) {                  // file disambiguation
-      file_from = file_to_int(move[1]);
-      // Check all possible knight moves from the specified file
-      for (int rank_offset : {-2, -1, 1, 2}) {
-        for (int file_offset : {-2, -1, 1, 2}) {
-          if (abs(rank_offset) != abs(file_offset)) {
-            rank_from = rank_to + rank_offset;
-            file_from = file_to + file_offset;
-            if (is_legal_figure_move(KNIGHT_TYPE, rank_from, file_from, rank_to,
-                                     file_to))
-              return true;
-          }
-        }
-      }
-    } else { // rank disambiguation
-      rank_from = 8 - (move[2] - '0');
-      // Check all possible knight moves from the specified rank
-      for (int rank_offset : {-2, -1, 1, 2}) {
-        for (int file_offset : {-2, -1, 1, 2}) {
-          if (abs(rank_offset) != abs(file_offset)) {
-            rank_from = rank_to + rank_offset;
-            file_from = file_to + file_offset;
-            if (is_legal_figure_move(KNIGHT_TYPE, rank_from, file_from, rank_to,
-                                     file_to))
-              return true;
-          }
-        }
-      }
-    }
-  } else if (move_length ==
-             (is_capture ? 6 : 5)) { // both file and rank disambiguation
-    file_from = file_to_int(move[1]);
-    rank_from = 8 - (move[2] - '0');
-    return is_legal_figure_move(KNIGHT_TYPE, rank_from, file_from, rank_to,
-                                file_to);
-  }
-
-  return false;
+ */
+int Chess_Board::handle_rook(const std::string &move, int &rank_from,
+                             int &file_from, int &rank_to, int &file_to) {
+  int square_to, is_capture;
+  Bitboard from_mask;
+  if (!parse_move(move, square_to, from_mask, is_capture) ||
+      !is_valid_target(square_to, is_capture))
+    return 0;
+
+  Bitboard occupied = occupancy[WHITE] | occupancy[BLACK];
+  Bitboard candidates = rook_attacks(square_to, occupied) & from_mask &
+                        pieces[ROOK_TYPE + turn * NUM_FIGURES];
+  return select_candidate(candidates, square_to, rank_from, file_from, rank_to,
+                          file_to);
 }
 
 /**
- * Returns whether a bishop move is legal (1 = legal). Same notations apply as
- * in is_legal_move().
+ * Returns whether a queen move is legal (1 = legal). Same notations apply as in
+ * is_legal_move().
  * @param input move notation
  * @param output rank of figure before move
  * @param output file of figure before me
  * @param output rank of figure after move
  * @param output file of figure after move
  */
-int Chess_Board::handle_bishop(std::string move, int &rank_from, int &file_from,
-                               int &rank_to, int &file_to) {
-  bool is_capture = move.find('x') != std::string::npos;
-
-  if (is_capture) {
-    if (move.length() == 4) { // unambiguous capture
-      file_to = file_to_int(move[2]);
-      rank_to = 8 - (move[3] - '0');
-      return check_diagonals(BISHOP_TYPE, rank_from, file_from, rank_to,
-                             file_to);
-    } else { // disambiguous capture
-      return handle_bishop_disambiguation(move, rank_from, file_from, rank_to,
-                                          file_to, true);
-    }
-  } else {                    // no capture
-    if (move.length() == 3) { // unambiguous move
-      file_to = file_to_int(move[1]);
-      rank_to = 8 - (move[2] - '0');
-      return check_diagonals(BISHOP_TYPE, rank_from, file_from, rank_to,
-                             file_to);
-    } else { // disambiguous move
-      return handle_bishop_disambiguation(move, rank_from, file_from, rank_to,
-                                          file_to, false);
-    }
-  }
+int Chess_Board::handle_queen(const std::string &move, int &rank_from,
+                              int &file_from, int &rank_to, int &file_to) {
+  int square_to, is_capture;
+  Bitboard from_mask;
+  if (!parse_move(move, square_to, from_mask, is_capture) ||
+      !is_valid_target(square_to, is_capture))
+    return 0;
+
+  Bitboard occupied = occupancy[WHITE] | occupancy[BLACK];
+  Bitboard candidates =
+      (rook_attacks(square_to, occupied) |
+       bishop_attacks(square_to, occupied)) &
+      from_mask & pieces[QUEEN_TYPE + turn * NUM_FIGURES];
+  return select_candidate(candidates, square_to, rank_from, file_from, rank_to,
+                          file_to);
 }
 
 /**
- * Handles the disambiguation logic for bishop moves.
+ * Returns whether a king move is legal (1 = legal). Same notations apply as in
+ * is_legal_move(). Note that castling is handled in a separate function:
+ * handle_castling()
  * @param input move notation
  * @param output rank of figure before move
  * @param output file of figure before me
  * @param output rank of figure after move
  * @param output file of figure after move
- * @param input bool denoting if move captures piece
- */
-int Chess_Board::handle_bishop_disambiguation(std::string move, int &rank_from,
-                                              int &file_from, int &rank_to,
-                                              int &file_to, bool is_capture) {
-  int move_length = move.length();
-  int file_index = is_capture ? 3 : 2;
-  int rank_index = is_capture ? 4 : 3;
-
-  file_to = file_to_int(move[file_index]);
-  rank_to = 8 - (move[rank_index] - '0');
-
-  if (move_length == (is_capture ? 5 : 4)) { // file or rank disambiguation
-    if (is_file(move[1])) {                  // file disambiguation
-      file_from = file_to_int(move[1]);
-      int dist = file_from - file_to;
-
-      for (int offset : {dist, -dist}) {
-        rank_from = rank_to + offset;
-        if (is_legal_figure_move(BISHOP_TYPE, rank_from, file_from, rank_to,
-                                 file_to))
-          return true;
-      }
-    } else { // rank disambiguation
-      rank_from = 8 - (move[2] - '0');
-      int dist = rank_from - rank_to;
-
-      for (int offset : {dist, -dist}) {
-        file_from = file_to + offset;
-        if (is_legal_figure_move(BISHOP_TYPE, rank_from, file_from, rank_to,
-                                 file_to))
-          return true;
-      }
-    }
-  } else if (move_length ==
-             (is_capture ? 6 : 5)) { // both file and rank disambiguation
-    file_from = file_to_int(move[1]);
-    rank_from = 8 - (move[2] - '0');
-    return is_legal_figure_move(BISHOP_TYPE, rank_from, file_from, rank_to,
-                                file_to);
-  }
-
-  return false;
+ */
+int Chess_Board::handle_king(const std::string &move, int &rank_from,
+                             int &file_from, int &rank_to, int &file_to) {
+  int square_to, is_capture;
+  Bitboard from_mask;
+  if (!parse_move(move, square_to, from_mask, is_capture) ||
+      !is_valid_target(square_to, is_capture))
+    return 0;
+
+  Bitboard candidates = attack_tables.king[square_to] & from_mask &
+                        pieces[KING_TYPE + turn * NUM_FIGURES];
+  return select_candidate(candidates, square_to, rank_from, file_from, rank_to,
+                          file_to);
 }
 
 /**
- * Returns whether a rook move is legal (1 = legal). Same notations apply as in
- * is_legal_move().
+ * Returns whether a castling move is legal (1 = legal). Same notations apply as
+ * in is_legal_move().
  * @param input move notation
  * @param output rank of figure before move
  * @param output file of figure before me
  * @param output rank of figure after move
  * @param output file of figure after move
  */
-int Chess_Board::handle_rook(std::string move, int &rank_from, int &file_from,
-                             int &rank_to, int &file_to) {
-  bool is_capture = move.find('x') != std::string::npos;
+int Chess_Board::handle_castling(const std::string &move, int &rank_from,
+                                 int &file_from, int &rank_to, int &file_to) {
+  const int KING_SIDE_FILE = 6;
+  const int QUEEN_SIDE_FILE = 2;
 
-  if (is_capture) { // Capture case
-    file_to = file_to_int(move[2]);
-    rank_to = 8 - (move[3] - '0');
-  } else { // Non-capture case
-    file_to = file_to_int(move[1]);
-    rank_to = 8 - (move[2] - '0');
-  }
+  size_t length = move.length();
+  while (length > 0 && is_suffix(move[length - 1]))
+    length--;
 
-  // Handle unambiguous moves (e.g., "Rae1")
-  if (move.length() == 4 && is_file(move[1])) { // File disambiguation
-    file_from = file_to_int(move[1]);
-    return check_straight_line(ROOK_TYPE, rank_from, file_from, rank_to,
-                               file_to);
-  } else if (move.length() == 4 && isdigit(move[1])) { // Rank disambiguation
-    rank_from = 8 - (move[1] - '0');
-    return check_straight_line(ROOK_TYPE, rank_from, file_from, rank_to,
-                               file_to);
-  } else if (move.length() == 5) { // Both file and rank disambiguation
-    file_from = file_to_int(move[1]);
-    rank_from = 8 - (move[2] - '0');
-    return check_straight_line(ROOK_TYPE, rank_from, file_from, rank_to,
-                               file_to);
+  int side;
+  if (move.compare(0, length, "O-O") == 0) { // king side castle
+    side = 1;
+    file_to = KING_SIDE_FILE;
+  } else if (move.compare(0, length, "O-O-O") == 0) { // queen side castle
+    side = 0;
+    file_to = QUEEN_SIDE_FILE;
+  } else {
+    return 0; // invalid move format
   }
 
-  // Handle unambiguous moves (e.g., "Re1")
-  if (move.length() == 3) {
-    return check_straight_line(ROOK_TYPE, rank_from, file_from, rank_to,
-                               file_to);
-  }
+  file_from = 4;
+  rank_from = (turn == WHITE) ? 7 : 0;
+  rank_to = rank_from;
 
-  return 0; // Illegal move
+  return can_castle(side);
 }
 
 /**
- * Returns whether a queen move is legal (1 = legal). Same notations apply as in
- * is_legal_move().
- * @param input move notation
- * @param output rank of figure before move
- * @param output file of figure before me
- * @param output rank of figure after move
- * @param output file of figure after move
+ * Returns whether the player to move may castle (1 = legal).
+ * @param input 1 for king side, 0 for queen side
  */
-int Chess_Board::handle_queen(std::string move, int &rank_from, int &file_from,
-                              int &rank_to, int &file_to) {
-  bool is_capture = move.find('x') != std::string::npos;
-
-  if (is_capture) { // Capture case
-    file_to = file_to_int(move[2]);
-    rank_to = 8 - (move[3] - '0');
-  } else { // Non-capture case
-    file_to = file_to_int(move[1]);
-    rank_to = 8 - (move[2] - '0');
-  }
+int Chess_Board::can_castle(int side) {
+  int square_from = (turn == WHITE) ? 4 : 7 * BOARD_SIZE + 4;
+  int rook_square = square_from + (side ? 3 : -4);
+  if (king_moved[turn] || rook_moved[turn][side] ||
+      !(pieces[KING_TYPE + turn * NUM_FIGURES] & 1ULL << square_from) ||
+      !(pieces[ROOK_TYPE + turn * NUM_FIGURES] & 1ULL << rook_square))
+    return 0;
+
+  // Squares between king and rook have to be empty
+  Bitboard occupied = occupancy[WHITE] | occupancy[BLACK];
+  Bitboard between = side ? 0x60ULL : 0x0eULL;
+  if (turn == BLACK)
+    between <<= 7 * BOARD_SIZE;
+  if (occupied & between)
+    return 0;
+
+  // The king may not castle out of, through or into check
+  int step = side ? 1 : -1;
+  Bitboard attackers = occupancy[!turn];
+  return !is_under_attack(square_from, !turn, occupied, attackers) &&
+         !is_under_attack(square_from + step, !turn, occupied, attackers) &&
+         !is_under_attack(square_from + 2 * step, !turn, occupied, attackers);
+}
 
-  // Handle unambiguous moves (e.g., "Qae1" or "Q1e1")
-  if (move.length() == 4) {
-    if (is_file(move[1])) { // File disambiguation (e.g., "Qae1")
-      file_from = file_to_int(move[1]);
-      return find_queen_on_file(file_from, rank_from, rank_to, file_to);
-    } else if (isdigit(move[1])) { // Rank disambiguation (e.g., "Q1e1")
-      rank_from = 8 - (move[1] - '0');
-      return find_queen_on_rank(rank_from, file_from, rank_to, file_to);
-    }
-  } else if (move.length() ==
-             5) { // Both file and rank disambiguation (e.g., "Qa1e1")
-    file_from = file_to_int(move[1]);
-    rank_from = 8 - (move[2] - '0');
-    return check_queen_path(rank_from, file_from, rank_to, file_to);
+/**
+ * Writes all legal moves of the player to move into move_list and returns
+ * their amount. Moves are packed like pack_move() does and can be played with
+ * play_packed_move().
+ * @param output list of legal moves, overwritten
+ */
+int Chess_Board::generate_legal_moves(Move_List &move_list) {
+  move_list.size = 0;
+
+  Bitboard own = occupancy[turn];
+  Bitboard occupied = occupancy[WHITE] | occupancy[BLACK];
+  Bitboard kings = pieces[KING_TYPE + turn * NUM_FIGURES];
+
+  // Without a king no move can leave it in check
+  int king_square = -1;
+  Bitboard checkers = 0, pinned = 0;
+  if (kings) {
+    king_square = lowest_bit(kings);
+    checkers = attackers_of(king_square, !turn, occupied);
+    pinned = pinned_figures(king_square);
   }
 
-  // Handle unambiguous moves (e.g., "Qe1")
-  if (move.length() == 3) {
-    return find_queen(rank_from, file_from, rank_to, file_to);
+  // Squares the other figures may move to. In check they have to capture the
+  // checking figure or block its line, in double check only the king moves.
+  Bitboard targets = ~own;
+  if (checkers & (checkers - 1)) {
+    targets = 0;
+  } else if (checkers) {
+    int checker = lowest_bit(checkers);
+    targets = checkers;
+    if (attack_tables.rook[king_square] & checkers)
+      targets |= rook_attacks(king_square, occupied) &
+                 rook_attacks(checker, occupied);
+    else if (attack_tables.bishop[king_square] & checkers)
+      targets |= bishop_attacks(king_square, occupied) &
+                 bishop_attacks(checker, occupied);
   }
 
-  return 0; // Illegal move
-}
+  // Adds the moves of the figure on square_from, only pinned figures need the
+  // full check whether they expose the king
+  Bitboard last_ranks = RANK_1_BITBOARD | RANK_1_BITBOARD << 7 * BOARD_SIZE;
+  auto add_moves = [&](int square_from, Bitboard to_squares, int is_pawn) {
+    to_squares &= targets;
+    int is_pinned = (pinned >> square_from & 1) != 0;
+    while (to_squares) {
+      int square_to = lowest_bit(to_squares);
+      to_squares &= to_squares - 1;
+      if (is_pinned && king_into_check(square_from, square_to))
+        continue;
+
+      if (is_pawn && (last_ranks >> square_to & 1)) {
+        for (int promotion = PACKED_QUEEN; promotion >= PACKED_BISHOP;
+             promotion--)
+          move_list.moves[move_list.size++] =
+              pack_move(square_from, square_to, promotion, PACKED_PROMOTION);
+      } else {
+        move_list.moves[move_list.size++] =
+            pack_move(square_from, square_to, 0, PACKED_NORMAL);
+      }
+    }
+  };
 
-/**
- * Searches for the queen on the specified file that can legally move to
- * (rank_to, file_to).
- */
-int Chess_Board::find_queen_on_file(int file_from, int &rank_from, int rank_to,
-                                    int file_to) {
-  // Check both directions along the file (up and down)
-  for (int dir : {1, -1}) {
-    int r = rank_to + dir;
-    while (r >= 0 && r < 8) {
-      Figure curr = board[r][file_from];
-      if (curr.type != 0) {
-        if (curr.color == turn && curr.type == QUEEN_TYPE) {
-          rank_from = r;
-          return check_queen_path(rank_from, file_from, rank_to, file_to);
-        }
-        break; // Path is blocked
+  if (targets) {
+    Bitboard empty_squares = ~occupied;
+    Bitboard pawns = pieces[PAWN_TYPE + turn * NUM_FIGURES];
+    int forward = (turn == WHITE) ? BOARD_SIZE : -BOARD_SIZE;
+    int start_rank = (turn == WHITE) ? 1 : 6;
+    for (Bitboard b = pawns; b; b &= b - 1) {
+      int square_from = lowest_bit(b);
+      Bitboard to_squares =
+          attack_tables.pawn[turn][square_from] & occupancy[!turn];
+      int square_push = square_from + forward;
+      if (empty_squares >> square_push & 1) {
+        to_squares |= 1ULL << square_push;
+        if (square_from / BOARD_SIZE == start_rank &&
+            (empty_squares >> (square_push + forward) & 1))
+          to_squares |= 1ULL << (square_push + forward);
       }
-      r += dir;
+      add_moves(square_from, to_squares, 1);
+    }
+
+    for (Bitboard b = pieces[KNIGHT_TYPE + turn * NUM_FIGURES]; b;
+         b &= b - 1) {
+      int square_from = lowest_bit(b);
+      add_moves(square_from, attack_tables.knight[square_from], 0);
+    }
+
+    Bitboard queens = pieces[QUEEN_TYPE + turn * NUM_FIGURES];
+    for (Bitboard b = pieces[BISHOP_TYPE + turn * NUM_FIGURES] | queens; b;
+         b &= b - 1) {
+      int square_from = lowest_bit(b);
+      add_moves(square_from, bishop_attacks(square_from, occupied), 0);
+    }
+    for (Bitboard b = pieces[ROOK_TYPE + turn * NUM_FIGURES] | queens; b;
+         b &= b - 1) {
+      int square_from = lowest_bit(b);
+      add_moves(square_from, rook_attacks(square_from, occupied), 0);
     }
   }
-  return 0; // No queen found on the specified file
-}
 
-/**
- * Searches for the queen on the specified rank that can legally move to
- * (rank_to, file_to).
- */
-int Chess_Board::find_queen_on_rank(int rank_from, int &file_from, int rank_to,
-                                    int file_to) {
-  // Check both directions along the rank (left and right)
-  for (int dir : {1, -1}) {
-    int f = file_to + dir;
-    while (f >= 0 && f < 8) {
-      Figure curr = board[rank_from][f];
-      if (curr.type != 0) {
-        if (curr.color == turn && curr.type == QUEEN_TYPE) {
-          file_from = f;
-          return check_queen_path(rank_from, file_from, rank_to, file_to);
-        }
-        break; // Path is blocked
-      }
-      f += dir;
+  // En passant can remove two figures from a line to the king, so every
+  // capture gets the full check, also when it takes a checking pawn
+  if (en_passant_target[0] >= 0) {
+    int square_to = to_square(en_passant_target[0], en_passant_target[1]);
+    Bitboard capturers = attack_tables.pawn[!turn][square_to] &
+                         pieces[PAWN_TYPE + turn * NUM_FIGURES];
+    for (; capturers; capturers &= capturers - 1) {
+      int square_from = lowest_bit(capturers);
+      if (!king_into_check(square_from, square_to))
+        move_list.moves[move_list.size++] =
+            pack_move(square_from, square_to, 0, PACKED_EN_PASSANT);
     }
   }
-  return 0; // No queen found on the specified rank
-}
 
-/**
- * Searches for the queen that can legally move to (rank_to, file_to).
- */
-int Chess_Board::find_queen(int &rank_from, int &file_from, int rank_to,
-                            int file_to) {
-  // Check all 8 possible directions from the target square
-  const int directions[8][2] = {
-      {1, 0}, {-1, 0}, {0, 1},  {0, -1}, // Straight directions
-      {1, 1}, {1, -1}, {-1, 1}, {-1, -1} // Diagonal directions
-  };
+  if (kings) {
+    for (Bitboard b = attack_tables.king[king_square] & ~own; b; b &= b - 1) {
+      int square_to = lowest_bit(b);
+      if (!king_into_check(king_square, square_to))
+        move_list.moves[move_list.size++] =
+            pack_move(king_square, square_to, 0, PACKED_NORMAL);
+    }
 
-  for (const auto &dir : directions) {
-    int r = rank_to + dir[0];
-    int f = file_to + dir[1];
-
-    while (r >= 0 && r < 8 && f >= 0 && f < 8) {
-      Figure curr = board[r][f];
-      if (curr.type != 0) {
-        if (curr.color == turn && curr.type == QUEEN_TYPE) {
-          rank_from = r;
-          file_from = f;
-          return check_queen_path(rank_from, file_from, rank_to, file_to);
-        }
-        break; // Path is blocked
-      }
-      r += dir[0];
-      f += dir[1];
+    // 1: king side, 0: queen side
+    for (int side = 1; side >= 0 && !checkers; side--) {
+      if (can_castle(side))
+        move_list.moves[move_list.size++] = pack_move(
+            king_square, king_square + (side ? 2 : -2), 0, PACKED_CASTLING);
     }
   }
 
-  return 0; // No queen found
+  return move_list.size;
 }
 
 /**
- * Checks if a queen can move from (rank_from, file_from) to (rank_to, file_to)
- * without putting the king in check.
+ * Returns the standard algebraic notation of a legal move of the player to
+ * move, e.g. "Nbd7", "exd6", "e8=Q+" or "O-O-O#". The figure letter is only
+ * followed by the file, rank or square it moves from if another figure of
+ * the same type could move to the same square. Returns an empty string if no
+ * figure stands on the square the move starts from.
+ * @param input packed move, e.g. from generate_legal_moves()
  */
-int Chess_Board::check_queen_path(int &rank_from, int &file_from, int rank_to,
-                                  int file_to) {
-  // Check if the move is along a straight line or diagonal
-  int rank_diff = abs(rank_to - rank_from);
-  int file_diff = abs(file_to - file_from);
-  if (rank_diff != file_diff && rank_from != rank_to && file_from != file_to) {
-    return 0; // Not a straight line or diagonal
-  }
+std::string Chess_Board::get_notation(Packed_Move move) {
+  const char *figure_letters = "PBNRQK"; // indexed by figure type
+
+  int square_from, square_to, promotion, flag;
+  unpack_move(move, square_from, square_to, promotion, flag);
+  int figure = figures[square_from];
+  if (figure == EMPTY_TYPE)
+    return std::string();
+
+  std::string notation;
+  if (flag == PACKED_CASTLING) {
+    notation = (square_to > square_from) ? "O-O" : "O-O-O";
+  } else {
+    int type = figure % NUM_FIGURES;
+    int is_capture =
+        figures[square_to] != EMPTY_TYPE || flag == PACKED_EN_PASSANT;
+    Bitboard occupied = occupancy[WHITE] | occupancy[BLACK];
+
+    if (type == PAWN_TYPE) {
+      if (is_capture)
+        notation += static_cast<char>('a' + square_from % BOARD_SIZE);
+    } else {
+      notation += figure_letters[type];
+
+      // Other figures of the same type that may move to square_to
+      Bitboard others = 0;
+      if (type == KNIGHT_TYPE)
+        others = attack_tables.knight[square_to];
+      if (type == BISHOP_TYPE || type == QUEEN_TYPE)
+        others |= bishop_attacks(square_to, occupied);
+      if (type == ROOK_TYPE || type == QUEEN_TYPE)
+        others |= rook_attacks(square_to, occupied);
+      others &= pieces[figure] & ~(1ULL << square_from);
+
+      int is_ambiguous = 0, same_file = 0, same_rank = 0;
+      for (; others; others &= others - 1) {
+        int other = lowest_bit(others);
+        if (king_into_check(other, square_to))
+          continue;
+        is_ambiguous = 1;
+        same_file |= other % BOARD_SIZE == square_from % BOARD_SIZE;
+        same_rank |= other / BOARD_SIZE == square_from / BOARD_SIZE;
+      }
+      if (is_ambiguous && (!same_file || same_rank))
+        notation += static_cast<char>('a' + square_from % BOARD_SIZE);
+      if (is_ambiguous && same_file)
+        notation += static_cast<char>('1' + square_from / BOARD_SIZE);
+    }
 
-  // Determine the direction of movement
-  int rank_dir = (rank_to > rank_from) ? 1 : (rank_to < rank_from) ? -1 : 0;
-  int file_dir = (file_to > file_from) ? 1 : (file_to < file_from) ? -1 : 0;
-
-  // Traverse the path to ensure it's clear
-  int r = rank_from + rank_dir;
-  int f = file_from + file_dir;
-  while (r != rank_to || f != file_to) {
-    Figure curr = board[r][f];
-    if (curr.type != 0) {
-      return 0; // Path is blocked
+    if (is_capture)
+      notation += 'x';
+    notation += static_cast<char>('a' + square_to % BOARD_SIZE);
+    notation += static_cast<char>('1' + square_to / BOARD_SIZE);
+    if (flag == PACKED_PROMOTION) {
+      notation += '=';
+      notation += figure_letters[promotion + 1];
     }
-    r += rank_dir;
-    f += file_dir;
   }
 
-  // Check the target square
-  Figure target = board[rank_to][file_to];
-  if (target.color == turn && target.type != 0) {
-    return 0; // Cannot capture own piece
+  // Check and mate are found by playing the move on a copy of the board
+  Chess_Board next_board = *this;
+  next_board.play_packed_move(move);
+  Bitboard kings = next_board.pieces[KING_TYPE + next_board.turn * NUM_FIGURES];
+  if (kings && next_board.attackers_of(
+                   lowest_bit(kings), !next_board.turn,
+                   next_board.occupancy[WHITE] | next_board.occupancy[BLACK])) {
+    Move_List move_list;
+    notation += next_board.generate_legal_moves(move_list) ? '+' : '#';
   }
-
-  // Ensure the move doesn't put the king in check
-  return !king_into_check(rank_from, file_from, rank_to, file_to);
+  return notation;
 }
 
 /**
- * Returns whether a king move is legal (1 = legal). Same notations apply as in
- * is_legal_move(). Note that castling is handled in a separate function:
- * handle_castling()
- * @param input move notation
- * @param output rank of figure before move
- * @param output file of figure before me
- * @param output rank of figure after move
- * @param output file of figure after move
+ * Returns the squares of the figures of color that attack square.
+ * @param input square to check
+ * @param input color of the attacking figures
+ * @param input occupied squares that block sliding figures
  */
-int Chess_Board::handle_king(std::string move, int &rank_from, int &file_from,
-                             int &rank_to, int &file_to) {
-  bool is_capture = move.find('x') != std::string::npos;
-
-  if (is_capture) { // Capture case
-    file_to = file_to_int(move[2]);
-    rank_to = 8 - (move[3] - '0');
-  } else { // Non-capture case
-    file_to = file_to_int(move[1]);
-    rank_to = 8 - (move[2] - '0');
-  }
-
-  // Determine the king's current position
-  rank_from = king_pos[turn][0];
-  file_from = king_pos[turn][1];
-
-  // Check if the move is within one square in any direction
-  int rank_diff = abs(rank_to - rank_from);
-  int file_diff = abs(file_to - file_from);
-  if (rank_diff > 1 || file_diff > 1) {
-    return 0; // Illegal move (king can only move one square)
-  }
+Bitboard Chess_Board::attackers_of(int square, int color, Bitboard occupied) {
+  Bitboard queens = pieces[QUEEN_TYPE + color * NUM_FIGURES];
+  Bitboard straight = pieces[ROOK_TYPE + color * NUM_FIGURES] | queens;
+  Bitboard diagonal = pieces[BISHOP_TYPE + color * NUM_FIGURES] | queens;
+
+  Bitboard attackers =
+      (attack_tables.pawn[!color][square] &
+       pieces[PAWN_TYPE + color * NUM_FIGURES]) |
+      (attack_tables.knight[square] &
+       pieces[KNIGHT_TYPE + color * NUM_FIGURES]) |
+      (attack_tables.king[square] & pieces[KING_TYPE + color * NUM_FIGURES]);
+  if (attack_tables.rook[square] & straight)
+    attackers |= rook_attacks(square, occupied) & straight;
+  if (attack_tables.bishop[square] & diagonal)
+    attackers |= bishop_attacks(square, occupied) & diagonal;
+  return attackers;
+}
 
-  // Check if the target square is occupied by a friendly piece
-  Figure target = board[rank_to][file_to];
-  if (target.color == turn && target.type != 0) {
-    return 0; // Illegal move (cannot capture own piece)
+/**
+ * Returns the figures of the player to move that are pinned to their king on
+ * king_square, i.e. the only figure between the king and an enemy slider.
+ */
+Bitboard Chess_Board::pinned_figures(int king_square) {
+  Bitboard own = occupancy[turn];
+  Bitboard enemy = occupancy[!turn];
+  Bitboard occupied = own | enemy;
+  Bitboard queens = pieces[QUEEN_TYPE + !turn * NUM_FIGURES];
+  Bitboard straight = pieces[ROOK_TYPE + !turn * NUM_FIGURES] | queens;
+  Bitboard diagonal = pieces[BISHOP_TYPE + !turn * NUM_FIGURES] | queens;
+  Bitboard pinned = 0;
+
+  // Snipers see the king through own figures. The squares both the king and
+  // a sniper attack lie on the line between them and are a single blocker.
+  if (attack_tables.rook[king_square] & straight) {
+    Bitboard king_rays = rook_attacks(king_square, occupied);
+    for (Bitboard snipers = rook_attacks(king_square, enemy) & straight;
+         snipers; snipers &= snipers - 1)
+      pinned |= king_rays & rook_attacks(lowest_bit(snipers), occupied) & own;
   }
-
-  // Check if the move puts the king in check
-  if (king_into_check(rank_from, file_from, rank_to, file_to)) {
-    return 0; // Illegal move (king cannot move into check)
+  if (attack_tables.bishop[king_square] & diagonal) {
+    Bitboard king_rays = bishop_attacks(king_square, occupied);
+    for (Bitboard snipers = bishop_attacks(king_square, enemy) & diagonal;
+         snipers; snipers &= snipers - 1)
+      pinned |=
+          king_rays & bishop_attacks(lowest_bit(snipers), occupied) & own;
   }
-
-  return 1; // Legal move
+  return pinned;
 }
 
 /**
- * Returns whether a castling move is legal (1 = legal). Same notations apply as
- * in is_legal_move().
- * @param input move notation
- * @param output rank of figure before move
- * @param output file of figure before me
- * @param output rank of figure after move
- * @param output file of figure after move
+ * Returns whether the king will be in check after the figure on square_from
+ * has moved to square_to.
+ * @param input square of figure before move
+ * @param input square of figure after move
  */
-int Chess_Board::handle_castling(std::string move, int &rank_from,
-                                 int &file_from, int &rank_to, int &file_to) {
-  const int KING_SIDE_FILE = 6;
-  const int QUEEN_SIDE_FILE = 2;
-
-  file_from = 4;
-  rank_from = (turn == WHITE) ? 7 : 0;
-  rank_to = rank_from;
-
-  // Helper lambda to check if path is clear
-  auto isPathClear = [&](std::initializer_list<int> files) -> bool {
-    for (int file : files) {
-      if (!board[rank_to][file].empty) {
-        return false;
-      }
-    }
-    return true;
-  };
-
-  if (move == "O-O") { // king side castle
-    file_to = KING_SIDE_FILE;
-    if (!isPathClear({5, 6}))
-      return 0;
-
-    // Special case: Check if the king traversed a file that would have put him
-    // in check
-    return !king_moved[turn] && !rook_moved[turn][1] &&
-           !king_into_check(rank_from, file_from, rank_to, file_to) &&
-           !king_into_check(rank_from, file_from, rank_to, file_to - 1);
-
-  } else if (move == "O-O-O") { // queen side castle
-    file_to = QUEEN_SIDE_FILE;
-    if (!isPathClear({1, 2, 3}))
-      return 0;
-
-    // Special case: Check if the king traversed a file that would have put him
-    // in check
-    return !king_moved[turn] && !rook_moved[turn][0] &&
-           !king_into_check(rank_from, file_from, rank_to, file_to) &&
-           !king_into_check(rank_from, file_from, rank_to, file_to + 1);
-  }
-
-  return 0; // invalid move format
+int Chess_Board::king_into_check(int square_from, int square_to) {
+  Bitboard kings = pieces[KING_TYPE + turn * NUM_FIGURES];
+  if (!kings)
+    return 0;
+
+  Bitboard from = 1ULL << square_from;
+  Bitboard to = 1ULL << square_to;
+  int king_square = (kings & from) ? square_to : lowest_bit(kings);
+
+  // A pawn moving diagonally to an empty square captures en passant
+  Bitboard captured = to;
+  if ((pieces[PAWN_TYPE + turn * NUM_FIGURES] & from) &&
+      (square_from - square_to) % BOARD_SIZE != 0 &&
+      !((occupancy[WHITE] | occupancy[BLACK]) & to))
+    captured = 1ULL << (square_from / BOARD_SIZE * BOARD_SIZE +
+                        square_to % BOARD_SIZE);
+
+  // Occupancy after the move
+  Bitboard occupied =
+      ((occupancy[WHITE] | occupancy[BLACK]) & ~from & ~captured) | to;
+
+  return is_under_attack(king_square, !turn, occupied,
+                         occupancy[!turn] & ~captured);
 }
 
 /**
- * Returns whether the king will be in check after the referenced figure has
- * moved.
- * @param input rank of figure before move
- * @param input file of figure before me
- * @param input rank of figure after move
- * @param input file of figure after move
- */
-int Chess_Board::king_into_check(int rank_from, int file_from, int rank_to,
-                                 int file_to) {
-  // Update the board to after-move state
-  Figure fig_from = board[rank_from][file_from];
-  Figure fig_to = board[rank_to][file_to];
-  board[rank_to][file_to] = fig_from;
-  board[rank_from][file_from] = empty;
-
-  int king_rank = king_pos[turn][0];
-  int king_file = king_pos[turn][1];
-
-  // Check for attacks along ranks and files (rooks and queens)
-  bool isInCheck =
-      is_under_straight_attack(king_rank, king_file, 1, 0) ||  // Down
-      is_under_straight_attack(king_rank, king_file, -1, 0) || // Up
-      is_under_straight_attack(king_rank, king_file, 0, 1) ||  // Right
-      is_under_straight_attack(king_rank, king_file, 0, -1);   // Left
-
-  // Check for attacks along diagonals (bishops and queens)
-  isInCheck =
-      isInCheck ||
-      is_under_diagonal_attack(king_rank, king_file, 1, 1) ||  // Down-right
-      is_under_diagonal_attack(king_rank, king_file, 1, -1) || // Down-left
-      is_under_diagonal_attack(king_rank, king_file, -1, 1) || // Up-right
-      is_under_diagonal_attack(king_rank, king_file, -1, -1);  // Up-left
-
-  // Check for pawn attacks
-  isInCheck = isInCheck || is_under_pawn_attack(king_rank, king_file);
-
-  // Check for knight attacks
-  isInCheck = isInCheck || is_under_knight_attack(king_rank, king_file);
-
-  // Clean up board to before-move state
-  board[rank_to][file_to] = fig_to;
-  board[rank_from][file_from] = fig_from;
-
-  return isInCheck ? 1 : 0;
+ * Returns whether square is attacked by a figure of color. Only figures on
+ * squares of attackers attack, so that figures captured by a move can be left
+ * out.
+ * @param input square to check
+ * @param input color of the attacking figures
+ * @param input occupied squares that block sliding figures
+ * @param input squares of the attacking figures
+ */
+int Chess_Board::is_under_attack(int square, int color, Bitboard occupied,
+                                 Bitboard attackers) {
+  return is_under_straight_attack(square, color, occupied, attackers) ||
+         is_under_diagonal_attack(square, color, occupied, attackers) ||
+         is_under_pawn_attack(square, color, attackers) ||
+         is_under_knight_attack(square, color, attackers) ||
+         (attack_tables.king[square] & attackers &
+          pieces[KING_TYPE + color * NUM_FIGURES]);
 }
 
 /**
  * Checks if a square is under attack by a rook or queen along a straight
  * line.
  */
-int Chess_Board::is_under_straight_attack(int rank, int file, int delta_rank,
-                                          int delta_file) {
-  int r = rank + delta_rank;
-  int f = file + delta_file;
-
-  while (r >= 0 && r < 8 && f >= 0 && f < 8) {
-    Figure curr = board[r][f];
-    if (curr.color == turn)
-      break; // Friendly piece blocks
-    if (curr.color == !turn) {
-      return (curr.type == ROOK_TYPE || curr.type == QUEEN_TYPE);
-    }
-    r += delta_rank;
-    f += delta_file;
-  }
-  return false;
+int Chess_Board::is_under_straight_attack(int square, int color,
+                                          Bitboard occupied,
+                                          Bitboard attackers) {
+  Bitboard sliders = (pieces[ROOK_TYPE + color * NUM_FIGURES] |
+                      pieces[QUEEN_TYPE + color * NUM_FIGURES]) &
+                     attackers;
+
+  // Only follow the rays if a slider stands on one of the lines of square
+  if (!(attack_tables.rook[square] & sliders))
+    return 0;
+  return (rook_attacks(square, occupied) & sliders) != 0;
 }
 
 /**
  * Checks if a square is under attack by a bishop or queen along a diagonal.
  */
-int Chess_Board::is_under_diagonal_attack(int rank, int file, int delta_rank,
-                                          int delta_file) {
-  int r = rank + delta_rank;
-  int f = file + delta_file;
-
-  while (r >= 0 && r < 8 && f >= 0 && f < 8) {
-    Figure curr = board[r][f];
-    if (curr.color == turn)
-      break; // Friendly piece blocks
-    if (curr.color == !turn) {
-      return (curr.type == BISHOP_TYPE || curr.type == QUEEN_TYPE);
-    }
-    r += delta_rank;
-    f += delta_file;
-  }
-  return false;
+int Chess_Board::is_under_diagonal_attack(int square, int color,
+                                          Bitboard occupied,
+                                          Bitboard attackers) {
+  Bitboard sliders = (pieces[BISHOP_TYPE + color * NUM_FIGURES] |
+                      pieces[QUEEN_TYPE + color * NUM_FIGURES]) &
+                     attackers;
+
+  // Only follow the rays if a slider stands on one of the diagonals of square
+  if (!(attack_tables.bishop[square] & sliders))
+    return 0;
+  return (bishop_attacks(square, occupied) & sliders) != 0;
 }
 
 /**
  * Checks if a square is under attack by a pawn.
  */
-int Chess_Board::is_under_pawn_attack(int rank, int file) {
-  if (turn == WHITE) {
-    if (rank - 1 >= 0 && file - 1 >= 0) {
-      Figure curr = board[rank - 1][file - 1];
-      if (curr.color == BLACK && curr.type == PAWN_TYPE)
-        return true;
-    }
-    if (rank - 1 >= 0 && file + 1 < 8) {
-      Figure curr = board[rank - 1][file + 1];
-      if (curr.color == BLACK && curr.type == PAWN_TYPE)
-        return true;
-    }
-  } else {
-    if (rank + 1 < 8 && file - 1 >= 0) {
-      Figure curr = board[rank + 1][file - 1];
-      if (curr.color == WHITE && curr.type == PAWN_TYPE)
-        return true;
-    }
-    if (rank + 1 < 8 && file + 1 < 8) {
-      Figure curr = board[rank + 1][file + 1];
-      if (curr.color == WHITE && curr.type == PAWN_TYPE)
-        return true;
-    }
-  }
-  return false;
+int Chess_Board::is_under_pawn_attack(int square, int color,
+                                      Bitboard attackers) {
+  // Pawns of color attack square from where a pawn of the other color on
+  // square would attack
+  return (attack_tables.pawn[!color][square] & attackers &
+          pieces[PAWN_TYPE + color * NUM_FIGURES]) != 0;
 }
 
 /**
  * Checks if a square is under attack by a knight.
  */
-int Chess_Board::is_under_knight_attack(int rank, int file) {
-  const int knight_moves[8][2] = {{2, 1}, {2, -1}, {-2, 1}, {-2, -1},
-                                  {1, 2}, {1, -2}, {-1, 2}, {-1, -2}};
-
-  for (const auto &move : knight_moves) {
-    int r = rank + move[0];
-    int f = file + move[1];
-    if (r >= 0 && r < 8 && f >= 0 && f < 8) {
-      Figure curr = board[r][f];
-      if (curr.color == !turn && curr.type == KNIGHT_TYPE)
-        return true;
-    }
-  }
-  return false;
+int Chess_Board::is_under_knight_attack(int square, int color,
+                                        Bitboard attackers) {
+  return (attack_tables.knight[square] & attackers &
+          pieces[KNIGHT_TYPE + color * NUM_FIGURES]) != 0;
 }
 
 /**
- * Converts a file character (a-h) to an integer (0-7).
+ * Returns the squares a rook on square attacks, up to and including the first
+ * occupied square in every direction.
  */
-int Chess_Board::file_to_int(char file) { return file - 'a'; }
-
-/**
- * Returns whether the current character is referring to a file or rank (1 =
- * file).
- * @param input input character notation
- * @param output 1 if character notation is referring to file, else 0
- */
-int Chess_Board::is_file(char char_notation) { return isdigit(char_notation); }
+Bitboard Chess_Board::rook_attacks(int square, Bitboard occupied) {
+  return ray_attacks(DIRECTION_NORTH, square, occupied) |
+         ray_attacks(DIRECTION_EAST, square, occupied) |
+         ray_attacks(DIRECTION_SOUTH, square, occupied) |
+         ray_attacks(DIRECTION_WEST, square, occupied);
+}
 
 /**
- * Returns 1 if figure moves own king into check (1 = no check, 0 = check, -1
- * = position empty, -2 = other figure is blocking path). Returns
- * non-negative integer if and only if bishop figure has been found
- * @param input  int type of figure
- * @param output int
- * @param output rank of figure before move
- * @param output file of figure before move
- * @param output rank of figure after move
- * @param output file of figure after move
+ * Returns the squares a bishop on square attacks, up to and including the
+ * first occupied square in every direction.
  */
-int Chess_Board::figure_move_is_legal(int figure_type, int &rank_from,
-                                      int &file_from, int &rank_to,
-                                      int &file_to) {
-  Figure curr = board[rank_from][file_from];
-  if (curr.color == turn && curr.type == figure_type)
-    return !king_into_check(rank_from, file_from, rank_to, file_to);
-  else if (curr.empty)
-    return -1;
-
-  return -2;
+Bitboard Chess_Board::bishop_attacks(int square, Bitboard occupied) {
+  return ray_attacks(DIRECTION_NORTH_EAST, square, occupied) |
+         ray_attacks(DIRECTION_SOUTH_EAST, square, occupied) |
+         ray_attacks(DIRECTION_SOUTH_WEST, square, occupied) |
+         ray_attacks(DIRECTION_NORTH_WEST, square, occupied);
 }
 
 /**
- * Checks if a rook can move along a straight line from (rank_from, file_from)
- * to (rank_to, file_to) without putting the king in check.
+ * Returns the squares attacked along one direction from square, up to and
+ * including the first occupied square. The ray behind that blocker is cut off
+ * by its own ray in the same direction.
  */
-int Chess_Board::check_straight_line(int figure_type, int &rank_from,
-                                     int &file_from, int rank_to, int file_to) {
-  // Check if the move is along a straight line
-  if (rank_from != rank_to && file_from != file_to) {
-    return 0; // Not a straight line
-  }
-
-  // Determine the direction of movement
-  int rank_dir = (rank_to > rank_from) ? 1 : (rank_to < rank_from) ? -1 : 0;
-  int file_dir = (file_to > file_from) ? 1 : (file_to < file_from) ? -1 : 0;
-
-  // Traverse the path to ensure it's clear
-  int r = rank_from + rank_dir;
-  int f = file_from + file_dir;
-  while (r != rank_to || f != file_to) {
-    Figure curr = board[r][f];
-    if (curr.type != 0) {
-      return 0; // Path is blocked
-    }
-    r += rank_dir;
-    f += file_dir;
-  }
-
-  // Check the target square
-  Figure target = board[rank_to][file_to];
-  if (target.color == turn && target.type != 0) {
-    return 0; // Cannot capture own piece
+Bitboard Chess_Board::ray_attacks(int direction, int square,
+                                  Bitboard occupied) {
+  Bitboard attacks = attack_tables.rays[direction][square];
+  Bitboard blockers = attacks & occupied;
+  if (blockers) {
+    // The first four directions run towards higher squares
+    int blocker = direction < DIRECTION_SOUTH_EAST ? lowest_bit(blockers)
+                                                   : highest_bit(blockers);
+    attacks ^= attack_tables.rays[direction][blocker];
   }
-
-  // Ensure the move doesn't put the king in check
-  return !king_into_check(rank_from, file_from, rank_to, file_to);
+  return attacks;
 }
 
-int Chess_Board::check_diagonals(int figure_type, int &rank_from,
-                                 int &file_from, int &rank_to, int &file_to) {
-  // diagonal traversal, bottom-left
-  for (int i = rank_to + 1, j = file_to - 1; i < 8 && j >= 0; i++, j--) {
-    rank_from = i;
-    file_from = j;
-    int ret_move_legal = figure_move_is_legal(figure_type, rank_from, file_from,
-                                              rank_to, file_to);
-    if (ret_move_legal == -1)
-      continue;
-    else if (ret_move_legal < -1)
-      break;
-    else
-      return ret_move_legal;
-  }
-
-  // diagonal traversal, bottom-right
-  for (int i = rank_to + 1, j = file_to + 1; i < 8 && j < 8; i++, j++) {
-    rank_from = i;
-    file_from = j;
-    int ret_move_legal = figure_move_is_legal(figure_type, rank_from, file_from,
-                                              rank_to, file_to);
-    if (ret_move_legal == -1)
-      continue;
-    else if (ret_move_legal < -1)
-      break;
-    else
-      return ret_move_legal;
-  }
-
-  // diagonal traversal, top-left
-  for (int i = rank_to - 1, j = file_to - 1; i >= 0 && j >= 0; i--, j--) {
-    rank_from = i;
-    file_from = j;
-    int ret_move_legal = figure_move_is_legal(figure_type, rank_from, file_from,
-                                              rank_to, file_to);
-    if (ret_move_legal == -1)
-      continue;
-    else if (ret_move_legal < -1)
-      break;
-    else
-      return ret_move_legal;
-  }
-
-  // diagonal traversal, top-right
-  for (int i = rank_to - 1, j = file_to + 1; i >= 0 && j < 8; i--, j++) {
-    rank_from = i;
-    file_from = j;
-    int ret_move_legal = figure_move_is_legal(figure_type, rank_from, file_from,
-                                              rank_to, file_to);
-    if (ret_move_legal == -1)
-      continue;
-    else if (ret_move_legal < -1)
-      break;
-    else
-      return ret_move_legal;
-  }
+/**
+ * Converts a file character (a-h) to an integer (0-7).
+ */
+int Chess_Board::file_to_int(char file) { return file - 'a'; }
 
-  return -1;
+/**
+ * Returns whether the character is a check, mate or annotation suffix that
+ * may follow a move notation.
+ */
+int Chess_Board::is_suffix(char char_notation) {
+  return char_notation == '+' || char_notation == '#' ||
+         char_notation == '!' || char_notation == '?';
 }
 
 PYBIND11_MODULE(hpce, m) {
@@ -1526,14 +1722,246 @@ PYBIND11_MODULE(hpce, m) {
       .def_readwrite("turn", &Move::turn)
       .def_readwrite("move_notation", &Move::move_notation);
 
+  py::class_<Annotation>(m, "Annotation")
+      .def(py::init<>())
+      .def_readwrite("move_index", &Annotation::move_index)
+      .def_readwrite("type", &Annotation::type)
+      .def_readwrite("text", &Annotation::text);
+
   py::class_<PGN_Chess_Game>(m, "PGN_Chess_Game")
-      .def(py::init<std::map<std::string, std::string>>())
+      .def(py::init<>())
+      .def(py::init<const std::map<std::string, std::string> &>())
       .def("get_tag_pairs", &PGN_Chess_Game::get_tag_pairs)
-      .def("get_move_sequence", &PGN_Chess_Game::get_move_sequence);
+      .def("get_tag",
+           [](const PGN_Chess_Game &game, std::string key) -> py::object {
+             std::string_view value;
+             if (!game.get_tag(key, value))
+               return py::none();
+             return py::str(value.data(), value.size());
+           })
+      .def("get_move_sequence", &PGN_Chess_Game::get_move_sequence)
+      .def("get_annotations", &PGN_Chess_Game::get_annotations)
+      .def("get_amt_plies", &PGN_Chess_Game::get_amt_plies)
+      .def("get_packed_moves", &PGN_Chess_Game::get_packed_moves)
+      .def("has_packed_moves", &PGN_Chess_Game::has_packed_moves)
+      .def("get_white_elo", &PGN_Chess_Game::get_white_elo)
+      .def("get_black_elo", &PGN_Chess_Game::get_black_elo)
+      .def("get_date", &PGN_Chess_Game::get_date)
+      .def("get_result", &PGN_Chess_Game::get_result)
+      .def("get_eco", &PGN_Chess_Game::get_eco)
+      .def("get_raw_movetext", &PGN_Chess_Game::get_raw_movetext)
+      .def("is_tokenized", &PGN_Chess_Game::is_tokenized);
+
+  py::class_<PGN_Filter>(m, "PGN_Filter")
+      .def(py::init<>())
+      .def("add_tag_equals", &PGN_Filter::add_tag_equals)
+      .def("set_elo_range", &PGN_Filter::set_elo_range)
+      .def("set_white_elo_range", &PGN_Filter::set_white_elo_range)
+      .def("set_black_elo_range", &PGN_Filter::set_black_elo_range)
+      .def("set_date_range", &PGN_Filter::set_date_range)
+      .def("add_eco_prefix", &PGN_Filter::add_eco_prefix)
+      .def("clear", &PGN_Filter::clear);
+
+  py::class_<PGN_Diagnostics>(m, "PGN_Diagnostics")
+      .def("get_count", &PGN_Diagnostics::get_count)
+      .def("get_total_count", &PGN_Diagnostics::get_total_count)
+      .def("summary", &PGN_Diagnostics::summary);
+
+  py::class_<Game_Dedup_Set, std::shared_ptr<Game_Dedup_Set>>(
+      m, "Game_Dedup_Set")
+      .def(py::init<int>(), py::arg("use_key_tags") = 0)
+      .def("insert", &Game_Dedup_Set::insert)
+      .def("size", &Game_Dedup_Set::size)
+      .def("get_amt_duplicates", &Game_Dedup_Set::get_amt_duplicates)
+      .def("clear", &Game_Dedup_Set::clear);
 
   py::class_<PGN_Reader>(m, "PGN_Reader")
       .def(py::init<>())
-      .def("return_games", &PGN_Reader::return_games);
+      .def("return_games",
+           py::overload_cast<std::string>(&PGN_Reader::return_games),
+           py::call_guard<py::gil_scoped_release>())
+      .def("return_games",
+           py::overload_cast<std::string, int>(&PGN_Reader::return_games),
+           py::arg("file_path"), py::arg("num_threads"),
+           py::call_guard<py::gil_scoped_release>())
+      .def("open", &PGN_Reader::open)
+      .def("close", &PGN_Reader::close)
+      .def("open_index", &PGN_Reader::open_index)
+      .def("get_amt_indexed_games", &PGN_Reader::get_amt_indexed_games)
+      .def("read_game",
+           [](PGN_Reader &reader, size_t game_nr) {
+             PGN_Chess_Game game;
+             if (!reader.read_game(game_nr, game))
+               throw py::index_error();
+             return game;
+           })
+      .def("read_games", &PGN_Reader::read_games,
+           py::call_guard<py::gil_scoped_release>())
+      .def("close_index", &PGN_Reader::close_index)
+      .def("follow", &PGN_Reader::follow, py::arg("file_path"),
+           py::arg("start_offset") = 0)
+      .def("poll_games",
+           [](PGN_Reader &reader) {
+             std::vector<PGN_Chess_Game> games;
+             reader.poll_games(games);
+             return games;
+           })
+      .def(
+          "wait_for_games",
+          [](PGN_Reader &reader, int timeout_ms) {
+            std::vector<PGN_Chess_Game> games;
+            reader.wait_for_games(games, timeout_ms);
+            return games;
+          },
+          py::call_guard<py::gil_scoped_release>())
+      .def("get_follow_offset", &PGN_Reader::get_follow_offset)
+      .def("stop_following", &PGN_Reader::stop_following)
+      .def("set_print_summary", &PGN_Reader::set_print_summary)
+      .def("get_diagnostics", &PGN_Reader::get_diagnostics)
+      .def("set_filter", &PGN_Reader::set_filter)
+      .def("clear_filter", &PGN_Reader::clear_filter)
+      .def("set_capture_annotations", &PGN_Reader::set_capture_annotations)
+      .def("set_arena_mode", &PGN_Reader::set_arena_mode)
+      .def("set_lazy_movetext", &PGN_Reader::set_lazy_movetext)
+      .def("set_read_ahead", &PGN_Reader::set_read_ahead)
+      .def("set_dedup", &PGN_Reader::set_dedup, py::arg("dedup"),
+           py::arg("use_key_tags") = 0)
+      .def("set_dedup_set", &PGN_Reader::set_dedup_set)
+      .def("get_amt_duplicates", &PGN_Reader::get_amt_duplicates)
+      .def("next_game",
+           [](PGN_Reader &reader) -> py::object {
+             PGN_Chess_Game game;
+             if (!reader.next_game(game))
+               return py::none();
+             return py::cast(std::move(game));
+           })
+      .def(
+          "__iter__", [](PGN_Reader &reader) -> PGN_Reader & { return reader; },
+          py::return_value_policy::reference_internal)
+      .def("__next__", [](PGN_Reader &reader) {
+        PGN_Chess_Game game;
+        if (!reader.next_game(game))
+          throw py::stop_iteration();
+        return game;
+      });
+
+  py::class_<Game_Database>(m, "Game_Database")
+      .def(py::init<>())
+      .def("open", &Game_Database::open)
+      .def("close", &Game_Database::close)
+      .def("__len__", &Game_Database::size)
+      .def("get_game",
+           [](Game_Database &database, size_t i) {
+             PGN_Chess_Game game;
+             if (!database.get_game(i, game))
+               throw py::index_error();
+             return game;
+           })
+      .def("return_games", &Game_Database::return_games,
+           py::call_guard<py::gil_scoped_release>());
+
+  py::class_<Game_Database_Writer>(m, "Game_Database_Writer")
+      .def(py::init<>())
+      .def("open", &Game_Database_Writer::open)
+      .def("add_game", &Game_Database_Writer::add_game)
+      .def("add_pgn", &Game_Database_Writer::add_pgn,
+           py::call_guard<py::gil_scoped_release>())
+      .def("close", &Game_Database_Writer::close);
+
+  py::class_<Game_Table_View>(m, "Game_Table_View")
+      .def("get_game_nr", &Game_Table_View::get_game_nr)
+      .def("get_amt_tags", &Game_Table_View::get_amt_tags)
+      .def("get_tag_key", &Game_Table_View::get_tag_key)
+      .def("get_tag_value", &Game_Table_View::get_tag_value)
+      .def("get_white_elo", &Game_Table_View::get_white_elo)
+      .def("get_black_elo", &Game_Table_View::get_black_elo)
+      .def("get_date", &Game_Table_View::get_date)
+      .def("get_result", &Game_Table_View::get_result)
+      .def("get_eco", &Game_Table_View::get_eco)
+      .def("get_amt_plies", &Game_Table_View::get_amt_plies)
+      .def("get_move_notation", &Game_Table_View::get_move_notation)
+      .def("get_move", &Game_Table_View::get_move);
+
+  py::class_<Game_Table>(m, "Game_Table")
+      .def(py::init<>())
+      .def("add_game", &Game_Table::add_game)
+      .def("add_games", &Game_Table::add_games,
+           py::call_guard<py::gil_scoped_release>())
+      .def("add_pgn", &Game_Table::add_pgn,
+           py::call_guard<py::gil_scoped_release>())
+      .def("clear", &Game_Table::clear)
+      .def("size", &Game_Table::size)
+      .def("__len__", &Game_Table::size)
+      .def("get_view", &Game_Table::get_view, py::keep_alive<0, 1>())
+      .def("select", &Game_Table::select)
+      .def("sum_plies", py::overload_cast<>(&Game_Table::sum_plies, py::const_))
+      .def("sum_plies", py::overload_cast<const std::vector<size_t> &>(
+                            &Game_Table::sum_plies, py::const_))
+      .def("get_white_elos", &Game_Table::get_white_elos)
+      .def("get_black_elos", &Game_Table::get_black_elos)
+      .def("get_dates", &Game_Table::get_dates)
+      .def("get_results", &Game_Table::get_results)
+      .def("get_ecos", &Game_Table::get_ecos)
+      .def("get_move_offsets", &Game_Table::get_move_offsets);
+
+  py::class_<PGN_Writer>(m, "PGN_Writer")
+      .def(py::init<>())
+      .def("open", &PGN_Writer::open, py::arg("file_path"),
+           py::arg("compression") = COMPRESSION_NONE, py::arg("level") = -1)
+      .def("add_game", &PGN_Writer::add_game)
+      .def("add_games", &PGN_Writer::add_games,
+           py::call_guard<py::gil_scoped_release>())
+      .def("add_pgn", &PGN_Writer::add_pgn,
+           py::call_guard<py::gil_scoped_release>())
+      .def("close", &PGN_Writer::close)
+      .def("get_amt_games", &PGN_Writer::get_amt_games)
+      .def("get_amt_bytes", &PGN_Writer::get_amt_bytes);
+
+  py::class_<PGN_Shard>(m, "PGN_Shard")
+      .def_readonly("file_path", &PGN_Shard::file_path)
+      .def_readonly("amt_games", &PGN_Shard::amt_games)
+      .def_readonly("amt_plies", &PGN_Shard::amt_plies)
+      .def_readonly("amt_bytes", &PGN_Shard::amt_bytes)
+      .def_readonly("checksum", &PGN_Shard::checksum);
+
+  py::class_<PGN_Sharder>(m, "PGN_Sharder")
+      .def(py::init<>())
+      .def("add_input", &PGN_Sharder::add_input)
+      .def("shard", &PGN_Sharder::shard, py::arg("output_prefix"),
+           py::arg("amt_shards"), py::arg("compression") = COMPRESSION_NONE,
+           py::call_guard<py::gil_scoped_release>())
+      .def("get_shards", &PGN_Sharder::get_shards)
+      .def_static("checksum_file", [](std::string file_path) -> py::object {
+        uint64_t checksum;
+        if (!PGN_Sharder::checksum_file(file_path, checksum))
+          return py::none();
+        return py::int_(checksum);
+      });
+
+  m.attr("RESULT_UNKNOWN") = RESULT_UNKNOWN;
+  m.attr("RESULT_WHITE_WINS") = RESULT_WHITE_WINS;
+  m.attr("RESULT_BLACK_WINS") = RESULT_BLACK_WINS;
+  m.attr("RESULT_DRAW") = RESULT_DRAW;
+  m.attr("RESULT_ONGOING") = RESULT_ONGOING;
+
+  m.attr("PACKED_NORMAL") = PACKED_NORMAL;
+  m.attr("PACKED_PROMOTION") = PACKED_PROMOTION;
+  m.attr("PACKED_EN_PASSANT") = PACKED_EN_PASSANT;
+  m.attr("PACKED_CASTLING") = PACKED_CASTLING;
+  m.attr("PACKED_BISHOP") = PACKED_BISHOP;
+  m.attr("PACKED_KNIGHT") = PACKED_KNIGHT;
+  m.attr("PACKED_ROOK") = PACKED_ROOK;
+  m.attr("PACKED_QUEEN") = PACKED_QUEEN;
+
+  m.attr("COMPRESSION_NONE") = COMPRESSION_NONE;
+  m.attr("COMPRESSION_GZIP") = COMPRESSION_GZIP;
+  m.attr("COMPRESSION_ZSTD") = COMPRESSION_ZSTD;
+
+  m.def("build_pgn_index", &PGN_Index::build,
+        py::call_guard<py::gil_scoped_release>());
+
+  m.def("convert_pgn_to_database", &convert_pgn_to_database,
+        py::call_guard<py::gil_scoped_release>());
 
   // Bind the Figure struct
   py::class_<Figure>(m, "Figure")
@@ -1556,5 +1984,27 @@ PYBIND11_MODULE(hpce, m) {
       .def("play_move", py::overload_cast<std::string>(&Chess_Board::play_move))
       .def("print_board", &Chess_Board::print_board)
       .def("get_score", &Chess_Board::get_score)
-      .def("get_input_sequence", &Chess_Board::get_input_sequence);
+      .def("get_input_sequence", &Chess_Board::get_input_sequence)
+      .def("pack_moves", &Chess_Board::pack_moves)
+      .def("play_packed_move",
+           py::overload_cast<Packed_Move>(&Chess_Board::play_packed_move))
+      .def("generate_legal_moves",
+           [](Chess_Board &board) {
+             Move_List move_list;
+             board.generate_legal_moves(move_list);
+             return std::vector<Packed_Move>(
+                 move_list.moves.begin(),
+                 move_list.moves.begin() + move_list.size);
+           })
+      .def("load_fen", &Chess_Board::load_fen)
+      .def("get_notation", &Chess_Board::get_notation)
+      .def("get_figure", &Chess_Board::get_figure)
+      .def("get_bitboard", &Chess_Board::get_bitboard)
+      .def("get_occupancy", &Chess_Board::get_occupancy)
+      .def_static("pack_move", &Chess_Board::pack_move)
+      .def_static("unpack_move", [](Packed_Move move) {
+        int square_from, square_to, promotion, flag;
+        Chess_Board::unpack_move(move, square_from, square_to, promotion, flag);
+        return py::make_tuple(square_from, square_to, promotion, flag);
+      });
 }
\ No newline at end of file
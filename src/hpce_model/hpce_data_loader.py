@@ -1,8 +1,7 @@
 import os
 import torch
-from torch.utils.data import Dataset, DataLoader
+from torch.utils.data import Dataset, IterableDataset, DataLoader, get_worker_info
 import hpce
-from concurrent.futures import ThreadPoolExecutor
 
 class ChessDataset(Dataset):
     def __init__(self, pgn_dir):
@@ -12,21 +11,16 @@ class ChessDataset(Dataset):
         self.games = self._load_games()
 
     def _load_games(self):
-        """Load all PGN files in parallel and return a list of games."""
+        """Load all PGN files one after another and return a list of games."""
         pgn_files = [os.path.join(self.pgn_dir, f) for f in os.listdir(self.pgn_dir) if f.endswith(".pgn")]
         games = []
-        
-        def process_file(pgn_file):
-            """Read games from a PGN file."""
-            return self.pgn_reader.return_games(pgn_file)
-        
-        # Use ThreadPoolExecutor to parallelize PGN read in
-        with ThreadPoolExecutor() as executor:
-            results = list(executor.map(process_file, pgn_files))
-        
-        for result in results:
-            games.extend(result)
-        
+        # Each file is parsed in parallel chunks on all cores, so files are not
+        # read concurrently as well, which would oversubscribe the cores
+        num_threads = os.cpu_count() or 1
+
+        for pgn_file in pgn_files:
+            games.extend(self.pgn_reader.return_games(pgn_file, num_threads))
+
         return games
 
     def __len__(self):
@@ -37,6 +31,29 @@ class ChessDataset(Dataset):
         input_sequence = self.chess_board.get_input_sequence(curr_game).board_tokens
         return torch.tensor([input_sequence], dtype=torch.float32)
 
+class ChessStreamDataset(IterableDataset):
+    def __init__(self, pgn_dir):
+        self.pgn_dir = pgn_dir
+        self.pgn_files = sorted(os.path.join(self.pgn_dir, f) for f in os.listdir(self.pgn_dir) if f.endswith(".pgn"))
+
+    def __iter__(self):
+        """Stream games one at a time instead of loading all PGN files up front."""
+        worker_info = get_worker_info()
+        pgn_files = self.pgn_files
+        if worker_info is not None:
+            # Split files across DataLoader workers
+            pgn_files = pgn_files[worker_info.id::worker_info.num_workers]
+
+        pgn_reader = hpce.PGN_Reader()
+        chess_board = hpce.Chess_Board()
+        for pgn_file in pgn_files:
+            if not pgn_reader.open(pgn_file):
+                continue
+            for curr_game in pgn_reader:
+                input_sequence = chess_board.get_input_sequence(curr_game).board_tokens
+                yield torch.tensor([input_sequence], dtype=torch.float32)
+            pgn_reader.close()
+
 if __name__ == "__main__":
     training_dir = "../../training_data/"
     dataset = ChessDataset(training_dir)
@@ -0,0 +1,132 @@
+#include "../include/mapped_file.hpp"
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HPCE_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Default constructor. Initializes an empty, unmapped file.
+ */
+Mapped_File::Mapped_File()
+    : data{nullptr}, length{0}, opened{0}, mapped{0}, released{0} {}
+
+/**
+ * Default deconstructor. Releases the mapping.
+ */
+Mapped_File::~Mapped_File() { close(); }
+
+/**
+ * Maps the file at file_path read-only into memory. Returns 1 if the file
+ * could be opened. On platforms without mmap the file is read into a buffer.
+ */
+int Mapped_File::open(const std::string &file_path) {
+  close();
+
+#ifdef HPCE_HAVE_MMAP
+  int fd = ::open(file_path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return 0;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    ::close(fd);
+    return 0;
+  }
+
+  length = static_cast<size_t>(st.st_size);
+  if (length == 0) { // mmap rejects empty mappings
+    ::close(fd);
+    opened = 1;
+    return 1;
+  }
+
+  void *addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    length = 0;
+    return 0;
+  }
+
+  // The parser walks the file front to back exactly once
+  madvise(addr, length, MADV_SEQUENTIAL);
+
+  data = static_cast<const char *>(addr);
+  opened = 1;
+  mapped = 1;
+  return 1;
+#else
+  std::ifstream if_reader(file_path, std::ios::binary);
+  if (!if_reader.is_open())
+    return 0;
+
+  fallback_buffer.assign(std::istreambuf_iterator<char>(if_reader),
+                         std::istreambuf_iterator<char>());
+  data = fallback_buffer.data();
+  length = fallback_buffer.size();
+  opened = 1;
+  return 1;
+#endif
+}
+
+/**
+ * Unmaps the file. Views returned by view() are invalidated.
+ */
+void Mapped_File::close() {
+#ifdef HPCE_HAVE_MMAP
+  if (mapped)
+    munmap(const_cast<char *>(data), length);
+#endif
+  fallback_buffer.clear();
+  data = nullptr;
+  length = 0;
+  opened = 0;
+  mapped = 0;
+  released = 0;
+}
+
+/**
+ * Drops the resident pages before offset from memory. They are transparently
+ * read back from disk if accessed again. Returns the page-aligned offset up
+ * to which pages were released.
+ */
+size_t Mapped_File::release(size_t offset) {
+#ifdef HPCE_HAVE_MMAP
+  if (!mapped)
+    return offset;
+
+  size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  size_t aligned = offset - offset % page_size;
+  if (aligned > released) {
+    madvise(const_cast<char *>(data) + released, aligned - released,
+            MADV_DONTNEED);
+    released = aligned;
+  }
+  return released;
+#else
+  return offset;
+#endif
+}
+
+/**
+ * Returns 1 if a file is currently mapped.
+ */
+int Mapped_File::is_open() const { return opened; }
+
+/**
+ * Returns the size of the mapped file in bytes.
+ */
+size_t Mapped_File::size() const { return length; }
+
+/**
+ * Returns a view of the complete file contents.
+ */
+std::string_view Mapped_File::view() const {
+  return std::string_view(data, length);
+}
@@ -1,18 +1,103 @@
 #include "../include/pgn_chess_game.hpp"
 #include "../include/hpce.hpp"
+#include "../include/pgn_filter.hpp"
+#include "../include/pgn_lexer.hpp"
+#include "../include/string_pool.hpp"
 #include <algorithm>
 #include <map>
+#include <memory>
+#include <memory_resource>
 #include <sstream>
 #include <stdio.h>
 #include <string.h>
 #include <string>
+#include <string_view>
 #include <vector>
 
 /**
- * Default constructor. Initializes PGN Chess Game class.
+ * Initializes an empty PGN Chess Game, e.g. to be filled by
+ * PGN_Reader::next_game().
  */
-PGN_Chess_Game::PGN_Chess_Game(std::map<std::string, std::string> tag_pairs)
-    : tag_pairs{tag_pairs} {}
+PGN_Chess_Game::PGN_Chess_Game() {}
+
+/**
+ * Default constructor. Initializes PGN Chess Game class. The tag pairs are
+ * interned into a pool owned by this game.
+ */
+PGN_Chess_Game::PGN_Chess_Game(
+    const std::map<std::string, std::string> &tag_pairs) {
+  set_tag_pairs(tag_pairs);
+}
+
+/**
+ * Initializes an empty PGN Chess Game whose tag pairs are interned into
+ * tag_pool, which may be shared with other games.
+ */
+PGN_Chess_Game::PGN_Chess_Game(std::shared_ptr<String_Pool> tag_pool)
+    : tag_pool{tag_pool} {}
+
+/**
+ * Initializes an empty PGN Chess Game whose tag pairs, moves and annotations
+ * are allocated from arena, or from the heap if arena is empty. The arena is
+ * kept alive until all games using it are destroyed.
+ */
+PGN_Chess_Game::PGN_Chess_Game(std::shared_ptr<std::pmr::memory_resource> arena)
+    : arena{arena},
+      tag_pairs{arena ? arena.get() : std::pmr::get_default_resource()},
+      move_sequence{arena ? arena.get() : std::pmr::get_default_resource()},
+      annotations{arena ? arena.get() : std::pmr::get_default_resource()},
+      packed_moves{arena ? arena.get() : std::pmr::get_default_resource()} {}
+
+/**
+ * Copy constructor. The copy is allocated from the heap, independent of the
+ * arena of other.
+ */
+PGN_Chess_Game::PGN_Chess_Game(const PGN_Chess_Game &other)
+    : tag_pool{other.tag_pool},
+      tag_pairs{other.tag_pairs.begin(), other.tag_pairs.end()},
+      typed_tags{other.typed_tags},
+      move_sequence{other.move_sequence.begin(), other.move_sequence.end()},
+      annotations{other.annotations.begin(), other.annotations.end()},
+      packed_moves{other.packed_moves.begin(), other.packed_moves.end()},
+      raw_movetext_owner{other.raw_movetext_owner},
+      raw_movetext{other.raw_movetext},
+      raw_capture_annotations{other.raw_capture_annotations},
+      tokenized{other.tokenized} {}
+
+/**
+ * Copy assignment. The buffers stay in the allocator of this game.
+ */
+PGN_Chess_Game &PGN_Chess_Game::operator=(const PGN_Chess_Game &other) {
+  tag_pool = other.tag_pool;
+  tag_pairs = other.tag_pairs;
+  typed_tags = other.typed_tags;
+  move_sequence = other.move_sequence;
+  annotations = other.annotations;
+  packed_moves = other.packed_moves;
+  raw_movetext_owner = other.raw_movetext_owner;
+  raw_movetext = other.raw_movetext;
+  raw_capture_annotations = other.raw_capture_annotations;
+  tokenized = other.tokenized;
+  return *this;
+}
+
+/**
+ * Move assignment. Buffers are taken over if both games share an allocator
+ * and copied into the allocator of this game otherwise.
+ */
+PGN_Chess_Game &PGN_Chess_Game::operator=(PGN_Chess_Game &&other) {
+  tag_pool = std::move(other.tag_pool);
+  tag_pairs = std::move(other.tag_pairs);
+  typed_tags = other.typed_tags;
+  move_sequence = std::move(other.move_sequence);
+  annotations = std::move(other.annotations);
+  packed_moves = std::move(other.packed_moves);
+  raw_movetext_owner = std::move(other.raw_movetext_owner);
+  raw_movetext = other.raw_movetext;
+  raw_capture_annotations = other.raw_capture_annotations;
+  tokenized = other.tokenized;
+  return *this;
+}
 
 /**
  * Default deconstructor.
@@ -23,33 +108,394 @@ PGN_Chess_Game::~PGN_Chess_Game() {}
  * Adds move to chess game. Returns 1 if operation was successful.
  * TODO: Add error logic
  */
-int PGN_Chess_Game::add_move(Move move) {
+int PGN_Chess_Game::add_move(const Move &move) {
+  tokenize();
   move_sequence.push_back(move);
+  packed_moves.clear();
+
+  return 1;
+}
+
+/**
+ * Adds move to chess game, taking over its notation. Returns 1 if operation
+ * was successful.
+ */
+int PGN_Chess_Game::add_move(Move &&move) {
+  tokenize();
+  move_sequence.push_back(std::move(move));
+  packed_moves.clear();
+
+  return 1;
+}
+
+/**
+ * Adds annotation to chess game. Returns 1 if operation was successful.
+ */
+int PGN_Chess_Game::add_annotation(const Annotation &annotation) {
+  tokenize();
+  annotations.push_back(annotation);
+
+  return 1;
+}
+
+/**
+ * Adds annotation to chess game, taking over its text. Returns 1 if operation
+ * was successful.
+ */
+int PGN_Chess_Game::add_annotation(Annotation &&annotation) {
+  tokenize();
+  annotations.push_back(std::move(annotation));
+
+  return 1;
+}
 
+/**
+ * Adds an annotation whose text is copied straight into the allocator of the
+ * game. Returns 1 if operation was successful.
+ */
+int PGN_Chess_Game::add_annotation(size_t move_index, int type,
+                                   std::string_view text) {
+  tokenize();
+  annotations.emplace_back(move_index, type, text);
+
+  return 1;
+}
+
+/**
+ * Adds the tag pair key/value to the game. Returns 0 and keeps the existing
+ * value if the game already contains key.
+ */
+int PGN_Chess_Game::add_tag_pair(std::string_view key, std::string_view value) {
+  if (!tag_pool)
+    tag_pool = std::make_shared<String_Pool>();
+
+  uint32_t key_id = tag_pool->intern(key);
+  for (const Tag_Pair &tp : tag_pairs) {
+    if (tp.key == key_id)
+      return 0;
+  }
+
+  tag_pairs.push_back({key_id, tag_pool->intern(value)});
+
+  // Typed values of the tags filters look at most often
+  if (key == "WhiteElo")
+    typed_tags.white_elo = PGN_Filter::parse_elo(value);
+  else if (key == "BlackElo")
+    typed_tags.black_elo = PGN_Filter::parse_elo(value);
+  else if (key == "Date")
+    typed_tags.date = PGN_Filter::parse_date(value);
+  else if (key == "Result")
+    typed_tags.result = PGN_Filter::parse_result(value);
+  else if (key == "ECO")
+    typed_tags.eco = PGN_Filter::parse_eco(value);
   return 1;
 }
 
 /**
- * Retrieves the tag pairs.
+ * Sets value to the value of tag key without copying it. Returns 0 if the game
+ * does not contain key.
+ */
+int PGN_Chess_Game::get_tag(std::string_view key,
+                            std::string_view &value) const {
+  uint32_t key_id;
+  if (!tag_pool || !tag_pool->find(key, key_id))
+    return 0;
+
+  for (const Tag_Pair &tp : tag_pairs) {
+    if (tp.key == key_id) {
+      value = tag_pool->lookup(tp.value);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Retrieves the tag pairs. The map is assembled from the interned tag pairs
+ * on every call.
  */
 std::map<std::string, std::string> PGN_Chess_Game::get_tag_pairs(void) {
+  std::map<std::string, std::string> tag_pair_map;
+
+  for (const Tag_Pair &tp : tag_pairs) {
+    tag_pair_map.emplace(std::string(tag_pool->lookup(tp.key)),
+                         std::string(tag_pool->lookup(tp.value)));
+  }
+  return tag_pair_map;
+}
+
+/**
+ * Retrieves the tag pairs in the order they were added as views into the tag
+ * pool, which stay valid as long as the pool. Only the returned vector is
+ * allocated, no strings are copied.
+ */
+std::vector<std::pair<std::string_view, std::string_view>>
+PGN_Chess_Game::get_tag_pairs_view(void) const {
+  std::vector<std::pair<std::string_view, std::string_view>> tag_pair_views(
+      tag_pairs.size());
+  for (size_t i = 0; i < tag_pairs.size(); i++) {
+    tag_pair_views[i] = {tag_pool->lookup(tag_pairs[i].key),
+                         tag_pool->lookup(tag_pairs[i].value)};
+  }
+  return tag_pair_views;
+}
+
+/**
+ * Retrieves the pool the tag pairs are interned in.
+ */
+std::shared_ptr<String_Pool> PGN_Chess_Game::get_tag_pool(void) const {
+  return tag_pool;
+}
+
+/**
+ * Retrieves the interned tag pairs, to be resolved with get_tag_pool().
+ */
+const std::pmr::vector<Tag_Pair> &
+PGN_Chess_Game::get_tag_pair_ids(void) const {
   return tag_pairs;
 }
 
 /**
- * Retrieves the move sequence.
+ * Retrieves the typed values of the Elo, Date, Result and ECO tags.
+ */
+const Typed_Tags &PGN_Chess_Game::get_typed_tags(void) const {
+  return typed_tags;
+}
+
+/**
+ * Retrieves the WhiteElo tag as an integer, -1 if missing or empty.
+ */
+int PGN_Chess_Game::get_white_elo(void) const { return typed_tags.white_elo; }
+
+/**
+ * Retrieves the BlackElo tag as an integer, -1 if missing or empty.
+ */
+int PGN_Chess_Game::get_black_elo(void) const { return typed_tags.black_elo; }
+
+/**
+ * Retrieves the Date tag packed as YYYYMMDD, -1 if missing or malformed.
+ */
+int PGN_Chess_Game::get_date(void) const { return typed_tags.date; }
+
+/**
+ * Retrieves the Result tag as one of the RESULT_ constants.
+ */
+int PGN_Chess_Game::get_result(void) const { return typed_tags.result; }
+
+/**
+ * Retrieves the ECO tag as letter * 100 + number, -1 if missing or malformed.
+ */
+int PGN_Chess_Game::get_eco(void) const { return typed_tags.eco; }
+
+/**
+ * Retrieves the move sequence. Raw movetext is tokenized on the first call.
  * TODO: Add error logic
  */
 std::vector<Move> PGN_Chess_Game::get_move_sequence(void) {
+  tokenize();
+  return std::vector<Move>(move_sequence.begin(), move_sequence.end());
+}
+
+/**
+ * Retrieves the comments, variations and NAGs captured from the movetext.
+ */
+std::vector<Annotation> PGN_Chess_Game::get_annotations(void) {
+  tokenize();
+  return std::vector<Annotation>(annotations.begin(), annotations.end());
+}
+
+/**
+ * Retrieves the move sequence without copying it. The reference stays valid
+ * until the game is modified or destroyed.
+ */
+const std::pmr::vector<Move> &PGN_Chess_Game::get_move_sequence_view(void) {
+  tokenize();
   return move_sequence;
 }
 
+/**
+ * Retrieves the annotations without copying them. The reference stays valid
+ * until the game is modified or destroyed.
+ */
+const std::pmr::vector<Annotation> &
+PGN_Chess_Game::get_annotations_view(void) {
+  tokenize();
+  return annotations;
+}
+
+/**
+ * Retrieves the packed moves without copying them. The sequence is empty
+ * until the game has been replayed by Chess_Board::pack_moves().
+ */
+const std::pmr::vector<Packed_Move> &
+PGN_Chess_Game::get_packed_moves_view(void) const {
+  return packed_moves;
+}
+
+/**
+ * Retrieves a copy of the packed moves, one per ply.
+ */
+std::vector<Packed_Move> PGN_Chess_Game::get_packed_moves(void) const {
+  return std::vector<Packed_Move>(packed_moves.begin(), packed_moves.end());
+}
+
+/**
+ * Returns 1 if the game has been replayed into packed moves.
+ */
+int PGN_Chess_Game::has_packed_moves(void) const {
+  return !packed_moves.empty();
+}
+
+/**
+ * Returns the amount of moves in the move sequence.
+ */
+size_t PGN_Chess_Game::get_amt_moves(void) {
+  tokenize();
+  return move_sequence.size();
+}
+
+/**
+ * Returns the amount of half-moves played, without the empty move and the
+ * game termination marker stored at the end of the move sequence.
+ */
+size_t PGN_Chess_Game::get_amt_plies(void) {
+  tokenize();
+  size_t amt_plies = 0;
+  for (const Move &move : move_sequence) {
+    std::string_view notation = move.move_notation;
+    if (!notation.empty() && notation != "1-0" && notation != "0-1" &&
+        notation != "1/2-1/2" && notation != "*")
+      amt_plies++;
+  }
+  return amt_plies;
+}
+
+/**
+ * Reserves space for amt_moves moves.
+ */
+void PGN_Chess_Game::reserve_moves(size_t amt_moves) {
+  move_sequence.reserve(amt_moves);
+}
+
+/**
+ * Reserves space for amt_tag_pairs tag pairs.
+ */
+void PGN_Chess_Game::reserve_tag_pairs(size_t amt_tag_pairs) {
+  tag_pairs.reserve(amt_tag_pairs);
+}
+
 /**
  * Set move sequence to p_move_sequence by value.
  * TODO: Add error logic
  */
-void PGN_Chess_Game::set_move_sequence(std::vector<Move> &p_move_sequence) {
+void PGN_Chess_Game::set_move_sequence(
+    const std::vector<Move> &p_move_sequence) {
+  set_raw_movetext({}, nullptr);
   move_sequence.clear();
   move_sequence.insert(move_sequence.end(), p_move_sequence.begin(),
                        p_move_sequence.end());
-}
\ No newline at end of file
+}
+
+/**
+ * Set packed moves to the amt_moves moves at p_packed_moves, one per ply of
+ * the move sequence.
+ */
+void PGN_Chess_Game::set_packed_moves(const Packed_Move *p_packed_moves,
+                                      size_t amt_moves) {
+  packed_moves.assign(p_packed_moves, p_packed_moves + amt_moves);
+}
+
+/**
+ * Set tag pairs to p_tag_pairs by interning their keys and values.
+ */
+void PGN_Chess_Game::set_tag_pairs(
+    const std::map<std::string, std::string> &p_tag_pairs) {
+  tag_pairs.clear();
+  typed_tags = Typed_Tags();
+  for (const auto &tp : p_tag_pairs)
+    add_tag_pair(tp.first, tp.second);
+}
+
+/**
+ * Interns tag pairs into p_tag_pool from now on. Existing tag pairs are moved
+ * over to the new pool.
+ */
+void PGN_Chess_Game::set_tag_pool(std::shared_ptr<String_Pool> p_tag_pool) {
+  if (p_tag_pool == tag_pool)
+    return;
+
+  std::pmr::vector<Tag_Pair> old_tag_pairs(tag_pairs.get_allocator());
+  old_tag_pairs.swap(tag_pairs);
+  std::shared_ptr<String_Pool> old_tag_pool = tag_pool;
+
+  tag_pool = p_tag_pool;
+  for (const Tag_Pair &tp : old_tag_pairs) {
+    add_tag_pair(old_tag_pool->lookup(tp.key),
+                 old_tag_pool->lookup(tp.value));
+  }
+}
+
+/**
+ * Replaces the moves and annotations by movetext, which is only tokenized
+ * once they are accessed. The bytes of movetext are kept alive by owner; if
+ * owner is empty, movetext is copied. capture_annotations is passed on to
+ * the lexer. Tokenization on first access modifies the game, so a lazy game
+ * must not be accessed from multiple threads before it is tokenized.
+ */
+void PGN_Chess_Game::set_raw_movetext(std::string_view movetext,
+                                      std::shared_ptr<const void> owner,
+                                      int capture_annotations) {
+  move_sequence.clear();
+  annotations.clear();
+  packed_moves.clear();
+
+  if (!owner && !movetext.empty()) {
+    auto copy = std::make_shared<const std::string>(movetext);
+    movetext = *copy;
+    owner = std::move(copy);
+  }
+  raw_movetext_owner = std::move(owner);
+  raw_movetext = movetext;
+  raw_capture_annotations = capture_annotations;
+  tokenized = movetext.empty();
+}
+
+/**
+ * Retrieves the raw movetext of a game read in lazy mode, or an empty view if
+ * its moves were added directly.
+ */
+std::string_view PGN_Chess_Game::get_raw_movetext(void) const {
+  return raw_movetext;
+}
+
+/**
+ * Returns 1 if the movetext has been tokenized into moves.
+ */
+int PGN_Chess_Game::is_tokenized(void) const { return tokenized; }
+
+/**
+ * Tokenizes the pending raw movetext into moves and annotations. The raw
+ * movetext stays available for get_raw_movetext().
+ */
+void PGN_Chess_Game::tokenize() {
+  if (tokenized)
+    return;
+
+  tokenized = 1;
+  PGN_Lexer::tokenize_movetext(raw_movetext, *this, raw_capture_annotations);
+}
+
+/**
+ * Removes all tag pairs and moves. The buffers keep their capacity so that a
+ * game object can be reused across games.
+ */
+void PGN_Chess_Game::clear() {
+  tag_pairs.clear();
+  typed_tags = Typed_Tags();
+  move_sequence.clear();
+  annotations.clear();
+  packed_moves.clear();
+  raw_movetext_owner.reset();
+  raw_movetext = {};
+  tokenized = 1;
+}
@@ -0,0 +1,216 @@
+#include "../include/pgn_decompressor.hpp"
+#include "../include/chunk_queue.hpp"
+#include <climits>
+#include <string_view>
+#include <thread>
+
+#ifdef HPCE_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HPCE_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+// Decompressed bytes per buffer and buffers in flight between the threads
+#define DECOMPRESS_BUFFER_SIZE (1 << 20)
+#define DECOMPRESS_BUFFERS 4
+
+/**
+ * Default constructor. Initializes an idle decompressor.
+ */
+PGN_Decompressor::PGN_Decompressor()
+    : chunk_queue(DECOMPRESS_BUFFERS, DECOMPRESS_BUFFER_SIZE),
+      compression{COMPRESSION_NONE} {}
+
+/**
+ * Default deconstructor. Stops the producer thread.
+ */
+PGN_Decompressor::~PGN_Decompressor() { stop(); }
+
+/**
+ * Returns the compression format of data based on its magic bytes.
+ */
+int PGN_Decompressor::detect_compression(std::string_view data) {
+  const unsigned char *bytes =
+      reinterpret_cast<const unsigned char *>(data.data());
+
+  if (data.size() >= 2 && bytes[0] == 0x1f && bytes[1] == 0x8b)
+    return COMPRESSION_GZIP;
+  if (data.size() >= 4 && bytes[0] == 0x28 && bytes[1] == 0xb5 &&
+      bytes[2] == 0x2f && bytes[3] == 0xfd)
+    return COMPRESSION_ZSTD;
+  return COMPRESSION_NONE;
+}
+
+/**
+ * Returns 1 if support for the compression format was compiled in.
+ */
+int PGN_Decompressor::is_supported(int compression) {
+  switch (compression) {
+  case COMPRESSION_NONE:
+    return 1;
+#ifdef HPCE_HAVE_ZLIB
+  case COMPRESSION_GZIP:
+    return 1;
+#endif
+#ifdef HPCE_HAVE_ZSTD
+  case COMPRESSION_ZSTD:
+    return 1;
+#endif
+  default:
+    return 0;
+  }
+}
+
+/**
+ * Starts decompressing input on the producer thread. input must stay valid
+ * until stop() is called. Returns 1 if the format is supported.
+ */
+int PGN_Decompressor::start(std::string_view p_input, int p_compression) {
+  stop();
+
+  if (p_compression == COMPRESSION_NONE || !is_supported(p_compression))
+    return 0;
+
+  input = p_input;
+  compression = p_compression;
+  chunk_queue.reset();
+  producer = std::thread(&PGN_Decompressor::produce, this);
+  return 1;
+}
+
+/**
+ * Blocks until the next decompressed chunk is available. The chunk stays
+ * valid until the next call. Returns 0 at the end of the stream.
+ */
+int PGN_Decompressor::next_chunk(std::string_view &chunk) {
+  return chunk_queue.next(chunk);
+}
+
+/**
+ * Stops the producer thread and discards pending chunks.
+ */
+void PGN_Decompressor::stop() {
+  if (producer.joinable()) {
+    chunk_queue.cancel();
+    producer.join();
+  }
+}
+
+/**
+ * Returns 1 if the compressed stream was corrupt or truncated. Only final
+ * once next_chunk() has returned 0.
+ */
+int PGN_Decompressor::has_error() const { return chunk_queue.has_failed(); }
+
+/**
+ * Producer thread body. A corrupt or truncated stream ends the queue with
+ * fail(), after the chunks decompressed up to the error.
+ */
+void PGN_Decompressor::produce() {
+  int success = 0;
+
+  if (compression == COMPRESSION_GZIP)
+    success = inflate_gzip();
+  else if (compression == COMPRESSION_ZSTD)
+    success = decompress_zstd();
+
+  if (success)
+    chunk_queue.finish();
+  else
+    chunk_queue.fail();
+}
+
+/**
+ * Inflates all gzip members of input. Returns 1 on success.
+ */
+int PGN_Decompressor::inflate_gzip() {
+#ifdef HPCE_HAVE_ZLIB
+  z_stream stream = {};
+  // 15 window bits + 32 enables gzip and zlib header detection
+  if (inflateInit2(&stream, 15 + 32) != Z_OK)
+    return 0;
+
+  size_t consumed = 0;
+  int ret = Z_OK;
+  int done = 0;
+  char *buffer = nullptr;
+  size_t capacity;
+
+  while (!done && (buffer = chunk_queue.acquire(capacity)) != nullptr) {
+    stream.next_out = reinterpret_cast<Bytef *>(buffer);
+    stream.avail_out = static_cast<uInt>(capacity);
+
+    while (stream.avail_out > 0 && !done) {
+      if (stream.avail_in == 0) {
+        size_t remaining = input.size() - consumed;
+        if (remaining == 0) { // input is truncated
+          done = 1;
+          break;
+        }
+        size_t amt = remaining < UINT_MAX ? remaining : UINT_MAX;
+        stream.next_in = reinterpret_cast<Bytef *>(
+            const_cast<char *>(input.data() + consumed));
+        stream.avail_in = static_cast<uInt>(amt);
+        consumed += amt;
+      }
+
+      ret = inflate(&stream, Z_NO_FLUSH);
+      if (ret == Z_STREAM_END) {
+        // Concatenated gzip members (e.g. from pigz or bgzip)
+        if (stream.avail_in == 0 && consumed == input.size())
+          done = 1;
+        else
+          inflateReset(&stream);
+      } else if (ret != Z_OK) {
+        done = 1;
+      }
+    }
+
+    chunk_queue.commit(capacity - stream.avail_out);
+  }
+
+  inflateEnd(&stream);
+  return ret == Z_STREAM_END || buffer == nullptr;
+#else
+  return 0;
+#endif
+}
+
+/**
+ * Decompresses all zstd frames of input. Returns 1 on success.
+ */
+int PGN_Decompressor::decompress_zstd() {
+#ifdef HPCE_HAVE_ZSTD
+  ZSTD_DStream *stream = ZSTD_createDStream();
+  if (stream == nullptr)
+    return 0;
+
+  ZSTD_inBuffer in = {input.data(), input.size(), 0};
+  size_t ret = 1;
+  int done = 0;
+  char *buffer = nullptr;
+  size_t capacity;
+
+  while (!done && (buffer = chunk_queue.acquire(capacity)) != nullptr) {
+    ZSTD_outBuffer out = {buffer, capacity, 0};
+
+    while (out.pos < out.size) {
+      ret = ZSTD_decompressStream(stream, &out, &in);
+      // Without remaining input the decoder can not fill the buffer any more
+      if (ZSTD_isError(ret) || (in.pos == in.size && out.pos < out.size)) {
+        done = 1;
+        break;
+      }
+    }
+
+    chunk_queue.commit(out.pos);
+  }
+
+  ZSTD_freeDStream(stream);
+  // ret == 0 signals that the last frame was completely decoded
+  return buffer == nullptr || ret == 0;
+#else
+  return 0;
+#endif
+}
@@ -0,0 +1,131 @@
+#include "../include/pgn_diagnostics.hpp"
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Default constructor. Keeps up to max_samples located messages per category.
+ */
+PGN_Diagnostics::PGN_Diagnostics(size_t max_samples)
+    : max_samples{max_samples} {
+  reset();
+}
+
+/**
+ * Default deconstructor.
+ */
+PGN_Diagnostics::~PGN_Diagnostics() {}
+
+/**
+ * Records a problem of the given category in game game_nr at byte offset.
+ */
+void PGN_Diagnostics::report(int category, uint64_t offset, uint64_t game_nr) {
+  counts[category]++;
+  if (amt_samples[category] < max_samples) {
+    amt_samples[category]++;
+    samples.push_back({category, offset, game_nr});
+  }
+}
+
+/**
+ * Adds the problems recorded by other, whose game numbers start at
+ * game_nr_base.
+ */
+void PGN_Diagnostics::merge(const PGN_Diagnostics &other,
+                            uint64_t game_nr_base) {
+  for (int category = 0; category < DIAGNOSTIC_AMT_CATEGORIES; category++)
+    counts[category] += other.counts[category];
+
+  for (const Diagnostic &diagnostic : other.samples) {
+    if (amt_samples[diagnostic.category] < max_samples) {
+      amt_samples[diagnostic.category]++;
+      samples.push_back({diagnostic.category, diagnostic.offset,
+                         game_nr_base + diagnostic.game_nr});
+    }
+  }
+}
+
+/**
+ * Removes all recorded problems.
+ */
+void PGN_Diagnostics::reset() {
+  for (int category = 0; category < DIAGNOSTIC_AMT_CATEGORIES; category++) {
+    counts[category] = 0;
+    amt_samples[category] = 0;
+  }
+  samples.clear();
+}
+
+/**
+ * Returns the amount of problems recorded for category.
+ */
+uint64_t PGN_Diagnostics::get_count(int category) const {
+  return counts[category];
+}
+
+/**
+ * Returns the amount of problems recorded over all categories.
+ */
+uint64_t PGN_Diagnostics::get_total_count() const {
+  uint64_t total = 0;
+  for (int category = 0; category < DIAGNOSTIC_AMT_CATEGORIES; category++)
+    total += counts[category];
+  return total;
+}
+
+/**
+ * Returns the sampled problems in the order they were recorded.
+ */
+const std::vector<Diagnostic> &PGN_Diagnostics::get_samples() const {
+  return samples;
+}
+
+/**
+ * Returns a report listing the count of each category followed by the
+ * locations of its sampled problems.
+ */
+std::string PGN_Diagnostics::summary() const {
+  std::ostringstream report;
+
+  report << "PGN diagnostics: " << get_total_count() << " problem(s)\n";
+  for (int category = 0; category < DIAGNOSTIC_AMT_CATEGORIES; category++) {
+    if (counts[category] == 0)
+      continue;
+
+    report << "  " << get_message(category) << " (" << counts[category]
+           << "x)\n";
+    for (const Diagnostic &diagnostic : samples) {
+      if (diagnostic.category == category)
+        report << "    at byte " << diagnostic.offset << " in game "
+               << diagnostic.game_nr << "\n";
+    }
+    if (counts[category] > amt_samples[category])
+      report << "    ...\n";
+  }
+  return report.str();
+}
+
+/**
+ * Returns the message describing category.
+ */
+const char *PGN_Diagnostics::get_message(int category) {
+  switch (category) {
+  case DIAGNOSTIC_MALFORMED_TAG_PAIR:
+    return "The tag pair format is incorrect.";
+  case DIAGNOSTIC_MISSING_TAG_ROSTER:
+    return "Current Tag pair does not contain the seven tag roster.";
+  case DIAGNOSTIC_DUPLICATE_GAME:
+    return "The game repeats an earlier game and was removed.";
+  case DIAGNOSTIC_TRUNCATED_INPUT:
+    return "The PGN input is corrupt or truncated and was read only up to "
+           "here.";
+  case DIAGNOSTIC_RESTARTED_INPUT:
+    return "The followed PGN file was truncated here and is read again from "
+           "the start.";
+  case DIAGNOSTIC_UNSUPPORTED_INPUT:
+    return "Compressed PGN input is not supported by this build.";
+  default:
+    return "Unknown problem.";
+  }
+}
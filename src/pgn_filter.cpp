@@ -0,0 +1,243 @@
+#include "../include/pgn_filter.hpp"
+#include "../include/pgn_chess_game.hpp"
+#include "../include/pgn_lexer.hpp"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Default constructor. Initializes a filter that accepts all games.
+ */
+PGN_Filter::PGN_Filter() { clear(); }
+
+/**
+ * Default deconstructor.
+ */
+PGN_Filter::~PGN_Filter() {}
+
+/**
+ * Only accept games whose tag key has exactly the given value.
+ */
+void PGN_Filter::add_tag_equals(std::string key, std::string value) {
+  tag_equals.emplace_back(key, value);
+}
+
+/**
+ * Only accept games in which both players are rated within [min_elo, max_elo].
+ */
+void PGN_Filter::set_elo_range(int min_elo, int max_elo) {
+  set_white_elo_range(min_elo, max_elo);
+  set_black_elo_range(min_elo, max_elo);
+}
+
+/**
+ * Only accept games whose WhiteElo lies within [min_elo, max_elo].
+ */
+void PGN_Filter::set_white_elo_range(int min_elo, int max_elo) {
+  white_elo_range[0] = min_elo;
+  white_elo_range[1] = max_elo;
+  has_white_elo_range = 1;
+}
+
+/**
+ * Only accept games whose BlackElo lies within [min_elo, max_elo].
+ */
+void PGN_Filter::set_black_elo_range(int min_elo, int max_elo) {
+  black_elo_range[0] = min_elo;
+  black_elo_range[1] = max_elo;
+  has_black_elo_range = 1;
+}
+
+/**
+ * Only accept games played between from_date and to_date (inclusive). Dates
+ * use the PGN format YYYY.MM.DD. Unknown parts ("??") of from_date compare as
+ * 0 and those of to_date as 99, so "2020.??.??" includes all of 2020. Returns
+ * 0 and keeps the previous range if a date is malformed.
+ */
+int PGN_Filter::set_date_range(std::string from_date, std::string to_date) {
+  int from = parse_date(from_date), to = parse_date(to_date, 99);
+  if (from < 0 || to < 0)
+    return 0;
+
+  date_range[0] = from;
+  date_range[1] = to;
+  has_date_range = 1;
+  return 1;
+}
+
+/**
+ * Accept games whose ECO code starts with prefix, e.g. "B" or "B2". Games are
+ * accepted if they match any of the added prefixes.
+ */
+void PGN_Filter::add_eco_prefix(std::string prefix) {
+  eco_prefixes.push_back(prefix);
+}
+
+/**
+ * Removes all conditions.
+ */
+void PGN_Filter::clear() {
+  tag_equals.clear();
+  eco_prefixes.clear();
+  has_white_elo_range = 0;
+  has_black_elo_range = 0;
+  has_date_range = 0;
+}
+
+/**
+ * Returns 1 if no condition has been configured.
+ */
+int PGN_Filter::is_empty() const {
+  return tag_equals.empty() && eco_prefixes.empty() && !has_white_elo_range &&
+         !has_black_elo_range && !has_date_range;
+}
+
+/**
+ * Returns 1 if the game with the given tag section satisfies all conditions.
+ * Missing or malformed tags fail the conditions that refer to them. Like
+ * PGN_Chess_Game::add_tag_pair(), a key that occurs more than once keeps its
+ * first value.
+ */
+int PGN_Filter::matches(std::string_view tag_section) const {
+  int white_elo = -1, black_elo = -1, date = -1;
+  std::string_view eco;
+  std::string_view key, value;
+  size_t pos = 0;
+
+  // Keys whose first tag pair has been seen, one bit per typed tag
+  enum { SEEN_WHITE_ELO = 1, SEEN_BLACK_ELO = 2, SEEN_DATE = 4, SEEN_ECO = 8 };
+  int seen = 0;
+
+  // One bit per tag_equals condition, set once the first tag pair with its
+  // key is seen and if its value matches
+  size_t amt_words = (tag_equals.size() + 63) / 64;
+  uint64_t small_bits[2] = {0, 0};
+  std::vector<uint64_t> large_bits;
+  if (amt_words > 1)
+    large_bits.resize(2 * amt_words);
+  uint64_t *decided = amt_words > 1 ? large_bits.data() : &small_bits[0];
+  uint64_t *satisfied = amt_words > 1 ? decided + amt_words : &small_bits[1];
+
+  while (pos < tag_section.size()) {
+    std::string_view line = PGN_Lexer::next_line(tag_section, pos);
+    if (!PGN_Lexer::parse_tag_pair(line, key, value))
+      continue;
+
+    if (key == "WhiteElo" && !(seen & SEEN_WHITE_ELO)) {
+      white_elo = parse_elo(value);
+      seen |= SEEN_WHITE_ELO;
+    } else if (key == "BlackElo" && !(seen & SEEN_BLACK_ELO)) {
+      black_elo = parse_elo(value);
+      seen |= SEEN_BLACK_ELO;
+    } else if (key == "Date" && !(seen & SEEN_DATE)) {
+      date = parse_date(value);
+      seen |= SEEN_DATE;
+    } else if (key == "ECO" && !(seen & SEEN_ECO)) {
+      eco = value;
+      seen |= SEEN_ECO;
+    }
+
+    for (size_t i = 0; i < tag_equals.size(); i++) {
+      uint64_t bit = 1ULL << (i % 64);
+      if (key != tag_equals[i].first || (decided[i / 64] & bit))
+        continue;
+      decided[i / 64] |= bit;
+      if (value == tag_equals[i].second)
+        satisfied[i / 64] |= bit;
+    }
+  }
+
+  for (size_t i = 0; i < tag_equals.size(); i++) {
+    if (!(satisfied[i / 64] >> (i % 64) & 1))
+      return 0;
+  }
+  if (has_white_elo_range && (white_elo < white_elo_range[0] ||
+                              white_elo > white_elo_range[1] || white_elo < 0))
+    return 0;
+  if (has_black_elo_range && (black_elo < black_elo_range[0] ||
+                              black_elo > black_elo_range[1] || black_elo < 0))
+    return 0;
+  if (has_date_range &&
+      (date < 0 || date < date_range[0] || date > date_range[1]))
+    return 0;
+
+  if (eco_prefixes.empty())
+    return 1;
+  for (const std::string &prefix : eco_prefixes) {
+    if (eco.substr(0, prefix.size()) == prefix)
+      return 1;
+  }
+  return 0;
+}
+
+/**
+ * Converts an Elo tag value to an integer. Returns -1 if the value is empty
+ * or not a number.
+ */
+int PGN_Filter::parse_elo(std::string_view value) {
+  if (value.empty() || value.size() > 9)
+    return -1;
+
+  int elo = 0;
+  for (char c : value) {
+    if (c < '0' || c > '9')
+      return -1;
+    elo = elo * 10 + (c - '0');
+  }
+  return elo;
+}
+
+/**
+ * Packs a YYYY.MM.DD date into the integer YYYYMMDD. Unknown month or day
+ * ("??") are packed as unknown_part. Returns -1 if the year is unknown or the
+ * value is malformed.
+ */
+int PGN_Filter::parse_date(std::string_view value, int unknown_part) {
+  if (value.size() != 10 || value[4] != '.' || value[7] != '.')
+    return -1;
+
+  auto parse_part = [&](size_t offset, size_t length, int unknown) {
+    int part = 0;
+    for (size_t i = offset; i < offset + length; i++) {
+      if (value[i] == '?')
+        return unknown;
+      if (value[i] < '0' || value[i] > '9')
+        return -1;
+      part = part * 10 + (value[i] - '0');
+    }
+    return part;
+  };
+
+  int year = parse_part(0, 4, -1), month = parse_part(5, 2, unknown_part),
+      day = parse_part(8, 2, unknown_part);
+  if (year <= 0 || month < 0 || day < 0)
+    return -1;
+  return year * 10000 + month * 100 + day;
+}
+
+/**
+ * Converts a Result tag value to one of the RESULT_ constants.
+ */
+int PGN_Filter::parse_result(std::string_view value) {
+  if (value == "1-0")
+    return RESULT_WHITE_WINS;
+  if (value == "0-1")
+    return RESULT_BLACK_WINS;
+  if (value == "1/2-1/2")
+    return RESULT_DRAW;
+  if (value == "*")
+    return RESULT_ONGOING;
+  return RESULT_UNKNOWN;
+}
+
+/**
+ * Converts an ECO code A00 to E99 to the letter index times 100 plus its
+ * number, e.g. C20 to 220. Returns -1 if the value is not an ECO code.
+ */
+int PGN_Filter::parse_eco(std::string_view value) {
+  if (value.size() != 3 || value[0] < 'A' || value[0] > 'E' ||
+      value[1] < '0' || value[1] > '9' || value[2] < '0' || value[2] > '9')
+    return -1;
+  return (value[0] - 'A') * 100 + (value[1] - '0') * 10 + (value[2] - '0');
+}
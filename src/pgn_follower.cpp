@@ -0,0 +1,193 @@
+#include "../include/pgn_follower.hpp"
+#include "../include/pgn_diagnostics.hpp"
+#include "../include/pgn_lexer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Default constructor. Initializes a closed follower.
+ */
+PGN_Follower::PGN_Follower() : buffer_offset{0}, pos{0}, inotify_fd{-1} {}
+
+/**
+ * Default deconstructor.
+ */
+PGN_Follower::~PGN_Follower() { close(); }
+
+/**
+ * Starts following the PGN file at file_path from start_offset, which has to
+ * be a game boundary such as a value previously returned by get_offset().
+ * Returns 1 if the file could be opened.
+ */
+int PGN_Follower::open(const std::string &file_path, uint64_t start_offset) {
+  close();
+
+  in.open(file_path, std::ios::binary);
+  if (!in.is_open())
+    return 0;
+
+  this->file_path = file_path;
+  buffer_offset = start_offset;
+
+#ifdef __linux__
+  inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd >= 0 &&
+      inotify_add_watch(inotify_fd, file_path.c_str(),
+                        IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB) < 0) {
+    ::close(inotify_fd);
+    inotify_fd = -1;
+  }
+#endif
+  return 1;
+}
+
+/**
+ * Reads the bytes appended to the file since the last call. Invalidates all
+ * spans returned so far. Returns 1 if new bytes were read. If the file shrank,
+ * it is assumed to have been replaced and is read again from the start, which
+ * is reported to sink at the old read offset with the next game number
+ * game_nr.
+ */
+int PGN_Follower::refill(PGN_Diagnostics &sink, uint64_t game_nr) {
+  if (!in.is_open())
+    return 0;
+
+  std::error_code error;
+  uint64_t file_size = std::filesystem::file_size(file_path, error);
+  if (error)
+    return 0;
+
+  uint64_t read_offset = buffer_offset + buffer.size();
+  if (file_size < read_offset) {
+    sink.report(DIAGNOSTIC_RESTARTED_INPUT, read_offset, game_nr);
+    buffer.clear();
+    buffer_offset = 0;
+    pos = 0;
+    read_offset = 0;
+  }
+  if (file_size == read_offset)
+    return 0;
+
+  // Drop the consumed games before appending
+  buffer.erase(0, pos);
+  buffer_offset += pos;
+  pos = 0;
+
+  size_t old_size = buffer.size();
+  buffer.resize(old_size + (file_size - read_offset));
+  in.clear();
+  in.seekg(static_cast<std::streamoff>(read_offset));
+  in.read(&buffer[old_size], static_cast<std::streamsize>(file_size - read_offset));
+  buffer.resize(old_size + static_cast<size_t>(in.gcount()));
+
+  return buffer.size() > old_size ? 1 : 0;
+}
+
+/**
+ * Retrieves the next complete game span from the bytes read so far. The span
+ * offset refers to the file. Returns 0 if no further complete game is
+ * available yet.
+ */
+int PGN_Follower::next_span(PGN_Game_Span &span) {
+  std::string_view view(buffer);
+
+  if (PGN_Lexer::next_game_span(view, pos, span, 0)) {
+    span.offset += buffer_offset;
+    return 1;
+  }
+
+  // The last game may not be followed by a blank line yet. It is complete if
+  // its movetext ends with a termination marker on a finished line.
+  size_t end_pos = pos;
+  if (!PGN_Lexer::next_game_span(view, end_pos, span) ||
+      !ends_with_result(span.movetext))
+    return 0;
+
+  size_t span_end = span.offset + span.length;
+  if (view.find('\n', span_end) == std::string_view::npos)
+    return 0;
+
+  pos = span_end;
+  span.offset += buffer_offset;
+  return 1;
+}
+
+/**
+ * Blocks until the file is modified or timeout_ms passed. Returns 1 if the
+ * file may have grown. Without inotify the file is polled every
+ * FOLLOW_POLL_INTERVAL milliseconds.
+ */
+int PGN_Follower::wait(int timeout_ms) {
+#ifdef __linux__
+  if (inotify_fd >= 0) {
+    struct pollfd poll_fd = {inotify_fd, POLLIN, 0};
+    if (poll(&poll_fd, 1, timeout_ms) <= 0)
+      return 0;
+
+    // Drain the pending events, the file size is checked by refill()
+    char events[4096];
+    while (read(inotify_fd, events, sizeof(events)) > 0)
+      ;
+    return 1;
+  }
+#endif
+  std::this_thread::sleep_for(std::chrono::milliseconds(
+      std::max(0, std::min(timeout_ms, FOLLOW_POLL_INTERVAL))));
+  return 1;
+}
+
+/**
+ * Stops following the file.
+ */
+void PGN_Follower::close() {
+#ifdef __linux__
+  if (inotify_fd >= 0)
+    ::close(inotify_fd);
+#endif
+  inotify_fd = -1;
+  in.close();
+  file_path.clear();
+  buffer.clear();
+  buffer_offset = 0;
+  pos = 0;
+}
+
+/**
+ * Returns 1 if a file is being followed.
+ */
+int PGN_Follower::is_open() const { return in.is_open(); }
+
+/**
+ * Returns the file offset after the last complete game returned, from which
+ * following can be resumed.
+ */
+uint64_t PGN_Follower::get_offset() const { return buffer_offset + pos; }
+
+/**
+ * Returns 1 if the last token of movetext is a game termination marker.
+ */
+int PGN_Follower::ends_with_result(std::string_view movetext) {
+  size_t end = movetext.find_last_not_of(" \t\r\n");
+  if (end == std::string_view::npos)
+    return 0;
+
+  movetext = movetext.substr(0, end + 1);
+  size_t begin = movetext.find_last_of(" \t\r\n");
+  std::string_view token =
+      begin == std::string_view::npos ? movetext : movetext.substr(begin + 1);
+
+  return token == "1-0" || token == "0-1" || token == "1/2-1/2" ||
+         token == "*";
+}
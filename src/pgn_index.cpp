@@ -0,0 +1,177 @@
+#include "../include/pgn_index.hpp"
+#include "../include/mapped_file.hpp"
+#include "../include/pgn_decompressor.hpp"
+#include "../include/pgn_lexer.hpp"
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+static const char INDEX_MAGIC[8] = {'H', 'P', 'C', 'E', '_', 'I', 'D', 'X'};
+#define INDEX_BYTE_ORDER 0x01020304
+
+/**
+ * Appends the offsets of all games in buffer to entries. Returns 0 if buffer
+ * is compressed, as compressed files can not be indexed.
+ */
+static int scan_entries(std::string_view buffer,
+                        std::vector<PGN_Index_Entry> &entries) {
+  if (PGN_Decompressor::detect_compression(buffer) != COMPRESSION_NONE)
+    return 0;
+
+  PGN_Game_Span span;
+  size_t pos = 0;
+  while (PGN_Lexer::next_game_span(buffer, pos, span))
+    entries.push_back({span.offset, span.length});
+  return 1;
+}
+
+/**
+ * Default constructor. Initializes an empty index.
+ */
+PGN_Index::PGN_Index() {}
+
+/**
+ * Default deconstructor.
+ */
+PGN_Index::~PGN_Index() {}
+
+/**
+ * Returns the path of the sidecar index of the PGN file at file_path.
+ */
+std::string PGN_Index::index_path(std::string file_path) {
+  return file_path + ".idx";
+}
+
+/**
+ * Scans the PGN file at file_path and writes the offsets of its games to the
+ * sidecar index. The index is written to a temporary file first, so readers
+ * never observe a partially written index. Returns 1 on success.
+ */
+int PGN_Index::build(std::string file_path) {
+  Mapped_File mapped_file;
+  PGN_Index_Header header{};
+
+  if (!file_stamp(file_path, header.file_size, header.file_mtime) ||
+      !mapped_file.open(file_path))
+    return 0;
+
+  std::vector<PGN_Index_Entry> file_entries;
+  if (!scan_entries(mapped_file.view(), file_entries))
+    return 0;
+
+  memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+  header.version = PGN_INDEX_VERSION;
+  header.byte_order = INDEX_BYTE_ORDER;
+  header.amt_games = file_entries.size();
+
+  std::string tmp_path = index_path(file_path) + ".tmp";
+  std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char *>(file_entries.data()),
+            file_entries.size() * sizeof(PGN_Index_Entry));
+  out.close();
+  if (!out.good())
+    return 0;
+
+  std::error_code error;
+  std::filesystem::rename(tmp_path, index_path(file_path), error);
+  return error ? 0 : 1;
+}
+
+/**
+ * Loads the sidecar index of the PGN file at file_path. Returns 0 if there is
+ * no index, if it is corrupt or if it is stale, i.e. the PGN file changed
+ * since the index was built. All of these are expected and are resolved by
+ * rebuilding the index, so they are not reported.
+ */
+int PGN_Index::open(std::string file_path) {
+  close();
+
+  std::ifstream in(index_path(file_path), std::ios::binary);
+  if (!in.is_open())
+    return 0;
+
+  PGN_Index_Header header;
+  if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+      memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 ||
+      header.version != PGN_INDEX_VERSION ||
+      header.byte_order != INDEX_BYTE_ORDER)
+    return 0;
+
+  uint64_t file_size;
+  int64_t file_mtime;
+  if (!file_stamp(file_path, file_size, file_mtime) ||
+      file_size != header.file_size || file_mtime != header.file_mtime)
+    return 0;
+
+  // Entries are bounded by the PGN file, which also bounds the allocation
+  if (header.amt_games > file_size)
+    return 0;
+
+  entries.resize(header.amt_games);
+  if (!in.read(reinterpret_cast<char *>(entries.data()),
+               entries.size() * sizeof(PGN_Index_Entry))) {
+    close();
+    return 0;
+  }
+
+  for (const PGN_Index_Entry &entry : entries) {
+    if (entry.offset > file_size || entry.length > file_size - entry.offset) {
+      close();
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+/**
+ * Scans the PGN data in buffer and keeps the offsets of its games in memory
+ * only. Used when the sidecar index can not be written. Returns 0 if buffer
+ * is compressed.
+ */
+int PGN_Index::scan(std::string_view buffer) {
+  close();
+  return scan_entries(buffer, entries);
+}
+
+/**
+ * Removes all entries.
+ */
+void PGN_Index::close() { entries.clear(); }
+
+/**
+ * Returns the amount of indexed games.
+ */
+size_t PGN_Index::size() const { return entries.size(); }
+
+/**
+ * Returns the byte range of the game with index game_nr.
+ */
+const PGN_Index_Entry &PGN_Index::get_entry(size_t game_nr) const {
+  return entries[game_nr];
+}
+
+/**
+ * Retrieves size and last write time of the file at file_path. Returns 0 if
+ * the file does not exist.
+ */
+int PGN_Index::file_stamp(const std::string &file_path, uint64_t &file_size,
+                          int64_t &file_mtime) {
+  std::error_code error;
+
+  file_size = std::filesystem::file_size(file_path, error);
+  if (error)
+    return 0;
+
+  auto mtime = std::filesystem::last_write_time(file_path, error);
+  if (error)
+    return 0;
+
+  file_mtime = static_cast<int64_t>(mtime.time_since_epoch().count());
+  return 1;
+}
@@ -0,0 +1,440 @@
+#include "../include/pgn_lexer.hpp"
+#include "../include/pgn_chess_game.hpp"
+#include "../include/pgn_scanner.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+/**
+ * Returns the line starting at pos (without its line feed) and advances pos
+ * past the line feed.
+ */
+std::string_view PGN_Lexer::next_line(std::string_view buffer, size_t &pos) {
+  const char *begin = buffer.data() + pos;
+  size_t remaining = buffer.size() - pos;
+  const char *newline =
+      static_cast<const char *>(memchr(begin, '\n', remaining));
+
+  if (newline == nullptr) {
+    pos = buffer.size();
+    return std::string_view(begin, remaining);
+  }
+
+  size_t line_length = static_cast<size_t>(newline - begin);
+  pos += line_length + 1;
+  return std::string_view(begin, line_length);
+}
+
+/**
+ * Locates the next game in buffer starting at pos. A game consists of a tag
+ * section and a movetext section, each terminated by a blank line. Returns 1
+ * if a game was found and advances pos past it.
+ * If at_end is 0, buffer is the prefix of a stream that may still grow. Then
+ * only games whose movetext is terminated by a complete blank line are
+ * returned, and pos is left unchanged if no complete game is available.
+ */
+int PGN_Lexer::next_game_span(std::string_view buffer, size_t &pos,
+                              PGN_Game_Span &span, int at_end) {
+  size_t size = buffer.size();
+  size_t start_pos = pos;
+  size_t line_start = pos;
+  std::string_view line;
+
+  // A trailing line without line feed may still be incomplete
+  auto ends_section = [&]() {
+    return is_blank(line) && (at_end || buffer[pos - 1] == '\n');
+  };
+  auto incomplete = [&]() {
+    pos = start_pos;
+    return 0;
+  };
+
+  // Skip initial whitespace lines
+  do {
+    if (pos >= size)
+      return at_end ? 0 : incomplete();
+    line_start = pos;
+    line = next_line(buffer, pos);
+  } while (is_blank(line));
+
+  // Read current tag pairs until newline
+  size_t tag_start = line_start;
+  size_t tag_end = line_start + line.size();
+  int terminated = 0;
+  while (pos < size) {
+    line_start = pos;
+    line = next_line(buffer, pos);
+    if ((terminated = ends_section()))
+      break;
+    tag_end = line_start + line.size();
+  }
+  if (!terminated && !at_end)
+    return incomplete();
+
+  // Skip whitespace lines before the notation section
+  size_t movetext_start = pos;
+  size_t movetext_end = pos;
+  while (pos < size) {
+    line_start = pos;
+    line = next_line(buffer, pos);
+    if (!is_blank(line)) {
+      movetext_start = line_start;
+      movetext_end = line_start + line.size();
+      break;
+    }
+  }
+
+  // Continue reading movetext until newline
+  terminated = 0;
+  if (movetext_end > movetext_start) {
+    while (pos < size) {
+      line_start = pos;
+      line = next_line(buffer, pos);
+      if ((terminated = ends_section()))
+        break;
+      movetext_end = line_start + line.size();
+    }
+  }
+  if (!terminated && !at_end)
+    return incomplete();
+
+  span.offset = tag_start;
+  span.tag_section = buffer.substr(tag_start, tag_end - tag_start);
+  span.movetext = buffer.substr(movetext_start, movetext_end - movetext_start);
+  span.length = (movetext_end > movetext_start ? movetext_end : tag_end) -
+                tag_start;
+  return 1;
+}
+
+/**
+ * Returns the offset of the first game starting at or after pos, i.e. the
+ * first tag line that follows a blank line. Returns the buffer size if there
+ * is none.
+ */
+size_t PGN_Lexer::next_game_boundary(std::string_view buffer, size_t pos) {
+  const char *data = buffer.data();
+  size_t size = buffer.size();
+
+  while (pos < size) {
+    const char *newline =
+        static_cast<const char *>(memchr(data + pos, '\n', size - pos));
+    if (newline == nullptr)
+      break;
+
+    size_t line_start = static_cast<size_t>(newline - data) + 1;
+    if (line_start < size && data[line_start] == '[') {
+      // Walk back over the previous line and check that it is blank
+      size_t i = line_start - 1;
+      while (i > 0 && (data[i - 1] == ' ' || data[i - 1] == '\t' ||
+                       data[i - 1] == '\r'))
+        i--;
+      if (i == 0 || data[i - 1] == '\n')
+        return line_start;
+    }
+    pos = line_start;
+  }
+
+  return size;
+}
+
+/**
+ * Splits a tag pair line of the form [Key "Value"] into key and value. Both
+ * views point into line. Returns 1 if the tag pair format is correct.
+ */
+int PGN_Lexer::parse_tag_pair(std::string_view line, std::string_view &key,
+                              std::string_view &value) {
+  std::string_view str = trim(line);
+  size_t i = 0, size = str.size();
+
+  while (i < size && (std::isalnum(static_cast<unsigned char>(str[i])) ||
+                      str[i] == '_'))
+    i++;
+  if (i == 0)
+    return 0;
+  key = str.substr(0, i);
+
+  size_t key_end = i;
+  while (i < size && std::isspace(static_cast<unsigned char>(str[i])))
+    i++;
+  if (i == key_end || i == size || str[i] != '"')
+    return 0;
+
+  size_t value_start = ++i;
+  while (i < size && str[i] != '"')
+    i++;
+
+  // The closing quote must terminate the tag pair
+  if (i != size - 1)
+    return 0;
+
+  value = str.substr(value_start, i - value_start);
+  return 1;
+}
+
+/**
+ * Tokenizes a movetext section in a single forward pass and adds its moves to
+ * game. A move number "N." starts a pair of white and black moves, "N..."
+ * continues with black's move. Every started pair is completed with a black
+ * move, which holds the game termination marker or is empty if the game ends
+ * on a white move. Tokens without a preceding move number are skipped.
+ * Comments ("{...}", ";..."), variations ("(...)"), NAGs ("$n") and escaped
+ * lines ("%...") are skipped, or added to the game as annotations if
+ * capture_annotations is 1. Token boundaries are taken from the character
+ * class masks of PGN_Scanner.
+ */
+void PGN_Lexer::tokenize_movetext(std::string_view movetext,
+                                  PGN_Chess_Game &game,
+                                  int capture_annotations) {
+  const char *p = movetext.data();
+  const char *end = p + movetext.size();
+  Scan_State scan;
+  PGN_Scanner::start(movetext, scan);
+  int move_nr = 0;
+  int expected_turn = -1; // -1: waiting for a move number
+  int pair_open = 0;      // 1 iff white's move of move_nr has been added
+
+  // A ply takes four to six bytes of movetext, e.g. "Nf3 " or "12.Nf3 "
+  game.reserve_moves(game.get_amt_moves() + movetext.size() / 4 + 2);
+
+  auto annotate = [&](int type, const char *begin, const char *stop) {
+    if (!capture_annotations)
+      return;
+    while (begin < stop && is_space(*begin))
+      begin++;
+    while (stop > begin && is_space(stop[-1]))
+      stop--;
+    std::string_view text(begin, static_cast<size_t>(stop - begin));
+    game.add_annotation(game.get_amt_moves(), type, text);
+  };
+
+  while (p < end) {
+    // Skip whitespace between tokens
+    p = skip_whitespace(p, scan);
+    if (p == end)
+      break;
+
+    const char *token = p;
+
+    // Annotations that are not part of the main line
+    switch (*p) {
+    case '{':
+      p = skip_comment(p, end);
+      annotate(ANNOTATION_COMMENT, token + 1, p - (p[-1] == '}'));
+      continue;
+    case ';':
+    case '%':
+      p = skip_line(p, end);
+      if (*token == ';')
+        annotate(ANNOTATION_COMMENT, token + 1, p);
+      continue;
+    case '(':
+      p = skip_variation(p, scan);
+      annotate(ANNOTATION_VARIATION, token + 1, p - (p[-1] == ')'));
+      continue;
+    case '$':
+      while (++p < end && is_digit(*p))
+        ;
+      annotate(ANNOTATION_NAG, token + 1, p);
+      continue;
+    case ')': // unbalanced variation end
+      p++;
+      continue;
+    }
+
+    // Move number, e.g. "12." or "12..."
+    if (is_digit(*p)) {
+      int number = 0;
+      while (p < end && is_digit(*p)) {
+        number = number * 10 + (*p - '0');
+        p++;
+      }
+
+      if (p < end && *p == '.') {
+        int amt_dots = 0;
+        while (p < end && *p == '.') {
+          amt_dots++;
+          p++;
+        }
+
+        // "N..." resumes the open pair after a comment or variation
+        if (pair_open && amt_dots >= 3 && number == move_nr) {
+          expected_turn = 1;
+          continue;
+        }
+
+        if (pair_open)
+          game.add_move({move_nr, 1, ""});
+
+        move_nr = number;
+        expected_turn = amt_dots >= 3 ? 1 : 0;
+        pair_open = 0;
+        continue;
+      }
+    }
+
+    // SAN move or game termination marker, annotations may follow without
+    // separating whitespace
+    p = find_token_end(p, scan);
+    std::string_view notation(token, static_cast<size_t>(p - token));
+
+    if (expected_turn == 0) {
+      game.add_move({move_nr, 0, notation});
+      expected_turn = 1;
+      pair_open = 1;
+    } else if (expected_turn == 1) {
+      game.add_move({move_nr, 1, notation});
+      expected_turn = -1;
+      pair_open = 0;
+    }
+  }
+
+  if (pair_open)
+    game.add_move({move_nr, 1, ""});
+}
+
+/**
+ * Returns the index of the lowest set bit of mask, which must not be 0.
+ */
+static int lowest_bit(uint64_t mask) {
+#ifdef __GNUC__
+  return __builtin_ctzll(mask);
+#else
+  int i = 0;
+  while (!(mask & 1)) {
+    mask >>= 1;
+    i++;
+  }
+  return i;
+#endif
+}
+
+/**
+ * Returns the first position at or after p whose bit is set in the mask
+ * select returns for its block, or the end of the scanned buffer.
+ */
+template <typename Select>
+static const char *find_first(const char *p, Scan_State &state,
+                              Select select) {
+  while (p < state.end) {
+    if (p < state.block || p >= state.block + SCAN_BLOCK_SIZE)
+      PGN_Scanner::load(p, state);
+
+    uint64_t candidates = select(state.masks) >> (p - state.block);
+    if (candidates != 0)
+      return std::min(p + lowest_bit(candidates), state.end);
+    p = state.block + SCAN_BLOCK_SIZE;
+  }
+  return state.end;
+}
+
+/**
+ * Returns the first position at or after p that is not whitespace, or the end
+ * of the scanned buffer.
+ */
+const char *PGN_Lexer::skip_whitespace(const char *p, Scan_State &state) {
+  return find_first(p, state,
+                    [](const Scan_Masks &masks) { return ~masks.whitespace; });
+}
+
+/**
+ * Returns the first position at or after p that is whitespace or starts a
+ * comment, variation or NAG, or the end of the scanned buffer.
+ */
+const char *PGN_Lexer::find_token_end(const char *p, Scan_State &state) {
+  return find_first(p, state, [](const Scan_Masks &masks) {
+    return masks.whitespace | masks.annotation;
+  });
+}
+
+/**
+ * Returns the position after the comment starting with '{' at p. Comments do
+ * not nest and may span multiple lines.
+ */
+const char *PGN_Lexer::skip_comment(const char *p, const char *end) {
+  const char *close =
+      static_cast<const char *>(memchr(p, '}', static_cast<size_t>(end - p)));
+  return close == nullptr ? end : close + 1;
+}
+
+/**
+ * Returns the position after the line feed of the line containing p.
+ */
+const char *PGN_Lexer::skip_line(const char *p, const char *end) {
+  const char *newline =
+      static_cast<const char *>(memchr(p, '\n', static_cast<size_t>(end - p)));
+  return newline == nullptr ? end : newline + 1;
+}
+
+/**
+ * Returns the position after the variation starting with '(' at p. Nested
+ * variations and the comments inside them are skipped as well. Only the
+ * annotation characters of the variation are visited.
+ */
+const char *PGN_Lexer::skip_variation(const char *p, Scan_State &state) {
+  const char *end = state.end;
+  int depth = 0;
+
+  auto annotation = [](const Scan_Masks &masks) { return masks.annotation; };
+  while ((p = find_first(p, state, annotation)) < end) {
+    switch (*p) {
+    case '(':
+      depth++;
+      break;
+    case ')':
+      if (--depth == 0)
+        return p + 1;
+      break;
+    case '{':
+      p = skip_comment(p, end);
+      continue;
+    case ';':
+      p = skip_line(p, end);
+      continue;
+    }
+    p++;
+  }
+  return end;
+}
+
+/**
+ * Returns 1 if c separates movetext tokens.
+ */
+int PGN_Lexer::is_space(char c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' ||
+         c == '\f';
+}
+
+/**
+ * Returns 1 if c is a decimal digit.
+ */
+int PGN_Lexer::is_digit(char c) { return c >= '0' && c <= '9'; }
+
+/**
+ * Returns 1 if line only consists of whitespace characters.
+ */
+int PGN_Lexer::is_blank(std::string_view line) {
+  for (char c : line) {
+    if (c != ' ' && c != '\t' && c != '\r' && c != '\n')
+      return 0;
+  }
+  return 1;
+}
+
+/**
+ * Trims whitespace and tag brackets from both ends of str.
+ */
+std::string_view PGN_Lexer::trim(std::string_view str) {
+  auto is_trimmed = [](unsigned char ch) {
+    return std::isspace(ch) || ch == '[' || ch == ']';
+  };
+
+  size_t begin = 0, end = str.size();
+  while (begin < end && is_trimmed(str[begin]))
+    begin++;
+  while (end > begin && is_trimmed(str[end - 1]))
+    end--;
+  return str.substr(begin, end - begin);
+}
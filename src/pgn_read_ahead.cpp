@@ -0,0 +1,317 @@
+#include "../include/pgn_read_ahead.hpp"
+#include "../include/chunk_queue.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HPCE_HAVE_PREAD 1
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef HPCE_HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+/**
+ * Default constructor. Initializes an idle reader with amt_buffers buffers of
+ * buffer_size bytes, which are allocated by start().
+ */
+PGN_Read_Ahead::PGN_Read_Ahead(size_t amt_buffers, size_t buffer_size)
+    : amt_buffers{amt_buffers < 2 ? 2 : amt_buffers},
+      buffer_size{buffer_size}, fd{-1}, file_size{0}, error{0},
+      ring{nullptr}, next_offset{0}, consuming{-1} {}
+
+/**
+ * Default deconstructor. Stops pending reads.
+ */
+PGN_Read_Ahead::~PGN_Read_Ahead() { stop(); }
+
+/**
+ * Opens the file at file_path and starts reading it ahead of the consumer.
+ * Returns 1 if the file could be opened. Returns 0 on platforms without
+ * pread.
+ */
+int PGN_Read_Ahead::start(const std::string &file_path) {
+  stop();
+
+#ifdef HPCE_HAVE_PREAD
+  fd = ::open(file_path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return 0;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    stop();
+    return 0;
+  }
+  file_size = static_cast<uint64_t>(st.st_size);
+  error = 0;
+
+#ifdef POSIX_FADV_SEQUENTIAL
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+  if (start_ring())
+    return 1;
+
+  if (!chunk_queue)
+    chunk_queue = std::make_unique<Chunk_Queue>(amt_buffers, buffer_size);
+  chunk_queue->reset();
+  producer = std::thread(&PGN_Read_Ahead::produce, this);
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+/**
+ * Returns the buffer of the previous chunk for the next read and blocks until
+ * the next chunk of the file is available. The chunk stays valid until the
+ * next call. Returns 0 at the end of the file or after a read error.
+ */
+int PGN_Read_Ahead::next_chunk(std::string_view &chunk) {
+  if (ring != nullptr)
+    return next_ring_chunk(chunk);
+  if (!producer.joinable())
+    return 0;
+  return chunk_queue->next(chunk);
+}
+
+/**
+ * Stops reading, waits for pending reads and closes the file.
+ */
+void PGN_Read_Ahead::stop() {
+  if (producer.joinable()) {
+    chunk_queue->cancel();
+    producer.join();
+  }
+  stop_ring();
+
+#ifdef HPCE_HAVE_PREAD
+  if (fd >= 0)
+    ::close(fd);
+#endif
+  fd = -1;
+  file_size = 0;
+}
+
+/**
+ * Returns 1 if reading the file failed.
+ */
+int PGN_Read_Ahead::has_error() const { return error; }
+
+/**
+ * Returns 1 if reads are queued with io_uring.
+ */
+int PGN_Read_Ahead::uses_io_uring() const { return ring != nullptr; }
+
+/**
+ * Producer thread body. Fills free buffers with consecutive ranges of the
+ * file until the end of the file is reached. A read error, or a file that
+ * ends before its size at start(), ends the queue with fail().
+ */
+void PGN_Read_Ahead::produce() {
+  uint64_t offset = 0;
+  char *buffer;
+  size_t capacity;
+
+  while (offset < file_size) {
+    // Cancelled by stop(), nobody consumes the remaining chunks
+    if ((buffer = chunk_queue->acquire(capacity)) == nullptr) {
+      chunk_queue->finish();
+      return;
+    }
+    size_t length = read_fully(buffer, capacity, offset);
+    chunk_queue->commit(length);
+    offset += length;
+    if (length < capacity)
+      break;
+  }
+
+  // A file that ends before the size it had at start() was truncated
+  if (offset < file_size)
+    error = 1;
+  if (error)
+    chunk_queue->fail();
+  else
+    chunk_queue->finish();
+}
+
+/**
+ * Reads up to length bytes at offset into buffer. Returns the amount of bytes
+ * read, which is only less than length at the end of the file or on error.
+ */
+size_t PGN_Read_Ahead::read_fully(char *buffer, size_t length,
+                                  uint64_t offset) {
+  size_t filled = 0;
+
+#ifdef HPCE_HAVE_PREAD
+  while (filled < length) {
+    ssize_t amt = pread(fd, buffer + filled, length - filled,
+                        static_cast<off_t>(offset + filled));
+    if (amt < 0 && errno == EINTR)
+      continue;
+    if (amt < 0) {
+      error = 1;
+      break;
+    }
+    if (amt == 0)
+      break;
+    filled += static_cast<size_t>(amt);
+  }
+#endif
+  return filled;
+}
+
+/**
+ * Sets up an io_uring with one read queued per buffer. Returns 0 if io_uring
+ * is not available, e.g. if it was not compiled in or the kernel refuses it.
+ */
+int PGN_Read_Ahead::start_ring() {
+#ifdef HPCE_HAVE_LIBURING
+  ring = new struct io_uring;
+  if (io_uring_queue_init(static_cast<unsigned>(amt_buffers), ring, 0) < 0) {
+    delete ring;
+    ring = nullptr;
+    return 0;
+  }
+
+  if (ring_buffers.size() != amt_buffers) {
+    ring_buffers.assign(amt_buffers, std::vector<char>(buffer_size));
+    ring_offsets.assign(amt_buffers, 0);
+    ring_results.assign(amt_buffers, 0);
+    ring_done.assign(amt_buffers, 0);
+  }
+  in_flight.clear();
+  next_offset = 0;
+  consuming = -1;
+
+  for (size_t i = 0; i < amt_buffers && next_offset < file_size; i++)
+    submit_read(static_cast<int>(i));
+  io_uring_submit(ring);
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+/**
+ * Queues a read of the next range of the file into buffer. The read is only
+ * passed to the kernel by the next io_uring_submit().
+ */
+void PGN_Read_Ahead::submit_read([[maybe_unused]] int buffer) {
+#ifdef HPCE_HAVE_LIBURING
+  struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+  io_uring_prep_read(sqe, fd, ring_buffers[buffer].data(),
+                     static_cast<unsigned>(buffer_size), next_offset);
+  io_uring_sqe_set_data(sqe, reinterpret_cast<void *>(
+                                 static_cast<intptr_t>(buffer)));
+
+  ring_offsets[buffer] = next_offset;
+  ring_done[buffer] = 0;
+  in_flight.push_back(buffer);
+  next_offset += buffer_size;
+#endif
+}
+
+/**
+ * Requeues the buffer of the previous chunk and waits for the read of the
+ * oldest buffer in flight. Reads may complete out of order, chunks are
+ * returned in file order.
+ */
+int PGN_Read_Ahead::next_ring_chunk(
+    [[maybe_unused]] std::string_view &chunk) {
+#ifdef HPCE_HAVE_LIBURING
+  if (consuming >= 0) {
+    if (next_offset < file_size && !error) {
+      submit_read(consuming);
+      io_uring_submit(ring);
+    }
+    consuming = -1;
+  }
+  if (in_flight.empty() || error)
+    return 0;
+
+  int buffer = in_flight.front();
+  while (!ring_done[buffer]) {
+    struct io_uring_cqe *cqe;
+    int ret = io_uring_wait_cqe(ring, &cqe);
+    if (ret == -EINTR)
+      continue;
+    if (ret < 0) {
+      error = 1;
+      return 0;
+    }
+
+    int completed =
+        static_cast<int>(reinterpret_cast<intptr_t>(io_uring_cqe_get_data(cqe)));
+    ring_results[completed] = cqe->res;
+    ring_done[completed] = 1;
+    io_uring_cqe_seen(ring, cqe);
+  }
+  in_flight.pop_front();
+
+  int64_t result = ring_results[buffer];
+  if (result < 0) {
+    error = 1;
+    return 0;
+  }
+
+  // Complete short reads before the end of the file synchronously
+  size_t length = static_cast<size_t>(result);
+  uint64_t expected = std::min<uint64_t>(buffer_size,
+                                         file_size - ring_offsets[buffer]);
+  if (length < expected) {
+    length += read_fully(ring_buffers[buffer].data() + length,
+                         static_cast<size_t>(expected) - length,
+                         ring_offsets[buffer] + length);
+    // The file was truncated, the chunk is the last one returned
+    if (length < expected)
+      error = 1;
+  }
+
+  consuming = buffer;
+  chunk = std::string_view(ring_buffers[buffer].data(), length);
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+/**
+ * Waits for all reads in flight and tears down the io_uring.
+ */
+void PGN_Read_Ahead::stop_ring() {
+#ifdef HPCE_HAVE_LIBURING
+  if (ring == nullptr)
+    return;
+
+  // The kernel may still write into the buffers until the reads completed
+  for (int buffer : in_flight) {
+    while (!ring_done[buffer]) {
+      struct io_uring_cqe *cqe;
+      int ret = io_uring_wait_cqe(ring, &cqe);
+      if (ret == -EINTR)
+        continue;
+      if (ret < 0)
+        break;
+      int completed = static_cast<int>(
+          reinterpret_cast<intptr_t>(io_uring_cqe_get_data(cqe)));
+      ring_done[completed] = 1;
+      io_uring_cqe_seen(ring, cqe);
+    }
+  }
+  in_flight.clear();
+  consuming = -1;
+
+  io_uring_queue_exit(ring);
+  delete ring;
+  ring = nullptr;
+#endif
+}
@@ -1,21 +1,52 @@
 #include "../include/pgn_reader.hpp"
 #include "../include/hpce.hpp"
+#include "../include/mapped_file.hpp"
+#include "../include/pgn_decompressor.hpp"
+#include "../include/pgn_diagnostics.hpp"
+#include "../include/pgn_filter.hpp"
+#include "../include/pgn_follower.hpp"
+#include "../include/pgn_index.hpp"
+#include "../include/pgn_lexer.hpp"
+#include "../include/pgn_source.hpp"
+#include "../include/string_pool.hpp"
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cctype>
 #include <fstream>
 #include <iostream>
 #include <map>
-#include <regex>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <sstream>
 #include <stdio.h>
 #include <string.h>
 #include <string>
+#include <thread>
 #include <vector>
 
+// Smallest byte range handed to a single worker by the parallel parser
+#define MIN_CHUNK_SIZE (64 << 10)
+// Chunks per worker thread, allows fast threads to steal remaining work
+#define CHUNKS_PER_THREAD 4
+// Size of the first block of a game arena, later blocks grow geometrically
+#define ARENA_BLOCK_SIZE (256 << 10)
+// Strings after which a streaming read starts a new tag pool
+#define MAX_STREAM_POOL_SIZE (1 << 16)
+
 /**
- * Default constructor. Initializes PGN Reader class.
+ * Default constructor. Initializes PGN Reader class. The games of a read
+ * intern their tag pairs into a common string pool. Every read starts a new
+ * pool that only its games hold, so a reader that streams many files does
+ * not keep their tag strings alive and concurrent reads do not share a pool.
  */
-PGN_Reader::PGN_Reader() {}
+PGN_Reader::PGN_Reader()
+    : indexed_file{std::make_shared<Mapped_File>()},
+      cursor_tag_pool{std::make_shared<String_Pool>()},
+      index_tag_pool{std::make_shared<String_Pool>()}, capture_annotations{0},
+      arena_mode{0}, lazy_movetext{0}, amt_read_ahead_buffers{0},
+      print_summary{1}, cursor_game_nr{0}, follow_game_nr{0} {}
 
 /**
  * Default deconstructor.
@@ -24,142 +55,621 @@ PGN_Reader::~PGN_Reader() {}
 
 /**
  * Returns all games contained in the specified PGN file as a vector of
- * PGN_Chess_Games.
+ * PGN_Chess_Games. The file is memory-mapped and tokenized in place; gzip and
+ * zstd compressed files are decompressed on the fly. Games rejected by the
+ * filter set with set_filter() are skipped.
  */
 std::vector<PGN_Chess_Game> PGN_Reader::return_games(std::string file_path) {
   std::vector<PGN_Chess_Game> pgn_chess_games;
-  std::ifstream if_reader(file_path);
-  std::string tp;
-  std::string curr_move;
-
-  // Define regex for tag pair tokenizer
-  std::regex re(R"((\w+)\s+\"([^\"]*)\")");
-  std::smatch match;
-
-  if (if_reader.is_open()) {
-    while (!if_reader.eof()) {
-      // Initialize current chess game
-      std::vector<std::string> str_tag_pairs; // non-tokenized tag pairs
-      std::map<std::string, std::string>
-          curr_tp; // used to initialize chess game
-
-      // Skip initial whitespace lines
-      while (std::getline(if_reader, tp)) {
-        if (!tp.empty() &&
-            tp.find_first_not_of(" \t\r\n") != std::string::npos) {
-          break;
-        }
-      }
+  PGN_Source source;
+  PGN_Game_Span span;
+  PGN_Diagnostics read_diagnostics;
+  auto tag_pool = std::make_shared<String_Pool>();
+  uint64_t game_nr = 0;
 
-      // Read current tag pairs until newline
-      do {
-        if (tp.empty() ||
-            tp.find_first_not_of(" \t\r\n") == std::string::npos) {
-          break;
-        }
-        str_tag_pairs.push_back(tp);
-      } while (std::getline(if_reader, tp));
-
-      // Match key and value from each tag pair string and add into tag pair map
-      for (std::string s : str_tag_pairs) {
-        PGN_Reader::trim_string(s);
-        if (std::regex_match(s, match, re)) {
-          std::string key = match[1].str();
-          std::string value = match[2].str();
-
-          if ((key == "WhiteElo" || key == "BlackElo") && value.empty()) {
-            value = "-1";
-          }
-
-          curr_tp.insert({key, value});
-        } else {
-          std::cerr << "The tag pair format is incorrect." << std::endl;
+  source.set_read_ahead(amt_read_ahead_buffers);
+  if (!source.open(file_path, read_diagnostics)) {
+    finish_read(read_diagnostics);
+    return pgn_chess_games;
+  }
+
+  std::shared_ptr<std::pmr::memory_resource> arena = new_arena();
+  std::shared_ptr<const void> span_owner = source.get_span_owner();
+  for (; source.next_span(span); game_nr++) {
+    if (!accept_game(span))
+      continue;
+    pgn_chess_games.emplace_back(arena);
+    build_game(span, pgn_chess_games.back(), read_diagnostics, game_nr,
+               span_owner, tag_pool);
+    if (is_duplicate(pgn_chess_games.back(), read_diagnostics, span.offset,
+                     game_nr))
+      pgn_chess_games.pop_back();
+  }
+
+  if (source.has_error())
+    read_diagnostics.report(DIAGNOSTIC_TRUNCATED_INPUT,
+                            source.get_stream_offset(), game_nr);
+  finish_read(read_diagnostics);
+  return pgn_chess_games;
+}
+
+/**
+ * Returns all games contained in the specified PGN file, parsed on
+ * num_threads threads. The file is split into byte ranges at game boundaries
+ * which are parsed independently and concatenated in their original order.
+ * A num_threads <= 0 uses all hardware threads. Compressed files are parsed
+ * sequentially.
+ */
+std::vector<PGN_Chess_Game> PGN_Reader::return_games(std::string file_path,
+                                                     int num_threads) {
+  if (num_threads <= 0)
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  if (num_threads == 1)
+    return return_games(file_path);
+
+  std::vector<PGN_Chess_Game> pgn_chess_games;
+  auto mapped_file = std::make_shared<Mapped_File>();
+  PGN_Diagnostics read_diagnostics;
+  auto tag_pool = std::make_shared<String_Pool>();
+
+  if (!mapped_file->open(file_path)) {
+    publish_diagnostics(read_diagnostics);
+    return pgn_chess_games;
+  }
+
+  // Compressed streams can not be split, they are decompressed and parsed in
+  // a pipeline instead
+  std::string_view buffer = mapped_file->view();
+  if (PGN_Decompressor::detect_compression(buffer) != COMPRESSION_NONE)
+    return return_games(file_path);
+
+  size_t amt_chunks = std::min<size_t>(num_threads * CHUNKS_PER_THREAD,
+                                       buffer.size() / MIN_CHUNK_SIZE + 1);
+
+  // Split into byte ranges, moving each cut forward to the next game start
+  std::vector<size_t> boundaries = {0};
+  for (size_t i = 1; i < amt_chunks; i++) {
+    size_t cut = std::max(buffer.size() / amt_chunks * i, boundaries.back());
+    size_t boundary = PGN_Lexer::next_game_boundary(buffer, cut);
+    if (boundary > boundaries.back() && boundary < buffer.size())
+      boundaries.push_back(boundary);
+  }
+  boundaries.push_back(buffer.size());
+  amt_chunks = boundaries.size() - 1;
+
+  // Parse chunks on a pool of workers pulling from a shared chunk counter
+  std::vector<std::vector<PGN_Chess_Game>> chunk_games(amt_chunks);
+  std::vector<std::vector<Game_Fingerprint>> chunk_fingerprints(amt_chunks);
+  std::vector<PGN_Diagnostics> chunk_diagnostics(amt_chunks);
+  std::vector<uint64_t> chunk_spans(amt_chunks);
+  std::atomic<size_t> next_chunk{0};
+  auto worker = [&]() {
+    for (size_t i = next_chunk++; i < amt_chunks; i = next_chunk++) {
+      chunk_spans[i] = parse_chunk(
+          buffer.substr(boundaries[i], boundaries[i + 1] - boundaries[i]),
+          boundaries[i], chunk_games[i], chunk_fingerprints[i],
+          chunk_diagnostics[i], mapped_file, tag_pool);
+    }
+  };
+
+  std::vector<std::thread> workers;
+  size_t amt_workers = std::min<size_t>(num_threads, amt_chunks);
+  for (size_t i = 1; i < amt_workers; i++)
+    workers.emplace_back(worker);
+  worker();
+  for (std::thread &t : workers)
+    t.join();
+
+  // Stitch the chunk results together in file order. Duplicates are dropped
+  // here rather than in the workers, so that the first copy of a game is kept
+  // like in a sequential read.
+  size_t amt_games = 0;
+  for (const auto &games : chunk_games)
+    amt_games += games.size();
+  pgn_chess_games.reserve(amt_games);
+
+  // Chunk-local game numbers start at the amount of games before the chunk
+  uint64_t game_nr_base = 0;
+  for (size_t i = 0; i < amt_chunks; i++) {
+    read_diagnostics.merge(chunk_diagnostics[i], game_nr_base);
+    for (size_t j = 0; j < chunk_games[i].size(); j++) {
+      if (dedup_set) {
+        const Game_Fingerprint &fingerprint = chunk_fingerprints[i][j];
+        if (!dedup_set->insert_hash(fingerprint.hash)) {
+          read_diagnostics.report(DIAGNOSTIC_DUPLICATE_GAME,
+                                  fingerprint.offset,
+                                  game_nr_base + fingerprint.game_nr);
+          continue;
         }
       }
+      pgn_chess_games.push_back(std::move(chunk_games[i][j]));
+    }
+    game_nr_base += chunk_spans[i];
+  }
 
-      // The tag pairs are required to have at least the seven tag roster
-      // [Event, Site, Date, Round, White, Black, Result]
-      // Additionally, optional tag pairs may be specified.
-      if (!validate_tag_pair_map(curr_tp)) {
-        std::cerr << "Current Tag pair does not contain the seven tag roster."
-                  << std::endl;
-        // break;
-      }
+  finish_read(read_diagnostics);
+  return pgn_chess_games;
+}
 
-      // Initialize game from current tag pair map
-      PGN_Chess_Game curr_chess_game = PGN_Chess_Game(curr_tp);
+/**
+ * Parses all games in chunk, which starts at chunk_offset of the file, and
+ * appends them to pgn_chess_games. If deduplication is on, the fingerprint of
+ * every appended game is added to fingerprints, the games are not looked up
+ * in the dedup set yet. Problems are reported to chunk_diagnostics with game
+ * numbers relative to the chunk. Returns the amount of games found, including
+ * games rejected by the filter.
+ */
+uint64_t PGN_Reader::parse_chunk(std::string_view chunk, uint64_t chunk_offset,
+                                 std::vector<PGN_Chess_Game> &pgn_chess_games,
+                                 std::vector<Game_Fingerprint> &fingerprints,
+                                 PGN_Diagnostics &chunk_diagnostics,
+                                 const std::shared_ptr<const void> &span_owner,
+                                 const std::shared_ptr<String_Pool> &tag_pool) {
+  size_t pos = 0;
+  PGN_Game_Span span;
+  uint64_t game_nr = 0;
 
-      // Skip whitespace lines before the notation section
-      while (std::getline(if_reader, curr_move)) {
-        if (!curr_move.empty() &&
-            curr_move.find_first_not_of(" \t\r\n") != std::string::npos) {
-          break;
-        }
+  // Arenas are not thread-safe, every chunk gets its own
+  std::shared_ptr<std::pmr::memory_resource> arena = new_arena();
+  for (; PGN_Lexer::next_game_span(chunk, pos, span); game_nr++) {
+    if (!accept_game(span))
+      continue;
+    span.offset += chunk_offset;
+    pgn_chess_games.emplace_back(arena);
+    build_game(span, pgn_chess_games.back(), chunk_diagnostics, game_nr,
+               span_owner, tag_pool);
+    if (dedup_set)
+      fingerprints.push_back(
+          {dedup_set->hash_game(pgn_chess_games.back()), span.offset, game_nr});
+  }
+  return game_nr;
+}
+
+/**
+ * Opens the specified PGN file for streaming with next_game(). Returns 1 if the
+ * file could be opened.
+ */
+int PGN_Reader::open(std::string file_path) {
+  cursor_diagnostics.reset();
+  cursor_tag_pool = std::make_shared<String_Pool>();
+  cursor_game_nr = 0;
+  cursor.set_read_ahead(amt_read_ahead_buffers);
+  if (!cursor.open(file_path, cursor_diagnostics)) {
+    finish_read(cursor_diagnostics);
+    return 0;
+  }
+  return 1;
+}
+
+/**
+ * Parses the next game of the opened PGN file into game, reusing its buffers.
+ * Only a single game is held in memory at a time. Games rejected by the filter
+ * are skipped. Returns 0 once all games have been read. The tag pool is
+ * replaced once it holds MAX_STREAM_POOL_SIZE strings, so that memory stays
+ * bounded on files of any size.
+ */
+int PGN_Reader::next_game(PGN_Chess_Game &game) {
+  PGN_Game_Span span;
+
+  if (cursor_tag_pool->size() >= MAX_STREAM_POOL_SIZE)
+    cursor_tag_pool = std::make_shared<String_Pool>();
+
+  do {
+    do {
+      if (!cursor.next_span(span)) {
+        if (cursor.has_error())
+          cursor_diagnostics.report(DIAGNOSTIC_TRUNCATED_INPUT,
+                                    cursor.get_stream_offset(), cursor_game_nr);
+        if (cursor.is_open())
+          finish_read(cursor_diagnostics);
+        cursor.close();
+        return 0;
       }
+      cursor_game_nr++;
+    } while (!accept_game(span));
 
-      // Continue reading moves and add them to PGN_Chess_Game
-      do {
-        if (curr_move.empty() ||
-            curr_move.find_first_not_of(" \t\r\n") == std::string::npos)
-          break;
+    build_game(span, game, cursor_diagnostics, cursor_game_nr - 1,
+               cursor.get_span_owner(), cursor_tag_pool);
+  } while (is_duplicate(game, cursor_diagnostics, span.offset,
+                        cursor_game_nr - 1));
+  return 1;
+}
 
-        PGN_Reader::trim_string(curr_move);
-        // Clean up unwanted carriage returns or newlines
-        curr_move.erase(std::remove(curr_move.begin(), curr_move.end(), '\r'),
-                        curr_move.end());
-        curr_move.erase(std::remove(curr_move.begin(), curr_move.end(), '\n'),
-                        curr_move.end());
+/**
+ * Closes the file opened with open() and publishes the problems found so far.
+ */
+void PGN_Reader::close() {
+  if (cursor.is_open())
+    publish_diagnostics(cursor_diagnostics);
+  cursor.close();
+}
 
-        std::regex move_regex(R"((\d+)\.\s*([^\s]+)(?:\s+([^\s]+))?)");
-        std::sregex_iterator it(curr_move.begin(), curr_move.end(), move_regex);
-        std::sregex_iterator end(curr_move.end(), curr_move.end(), move_regex);
+/**
+ * Opens the specified PGN file for random access with read_game(). The game
+ * offsets are taken from the sidecar index, which is (re)built if it is
+ * missing or stale. If the index can not be written, e.g. in a read-only
+ * directory, the offsets are kept in memory instead. Returns 1 if the file
+ * could be opened.
+ */
+int PGN_Reader::open_index(std::string file_path) {
+  close_index();
+  index_tag_pool = std::make_shared<String_Pool>();
 
-        while (it != end) {
-          std::smatch match = *it;
-          int move_number = std::stoi(match[1]); // Move number
-          std::string white_move = match[2];     // White move
-          std::string black_move = match[3];     // Black move (may be empty)
+  if (!indexed_file->open(file_path))
+    return 0;
 
-          Move white = {move_number, 0, white_move};
-          Move black = {move_number, 1, black_move};
+  if (!index.open(file_path) &&
+      (!PGN_Index::build(file_path) || !index.open(file_path)) &&
+      !index.scan(indexed_file->view())) {
+    indexed_file->close();
+    return 0;
+  }
+  return 1;
+}
 
-          curr_chess_game.add_move(white);
-          curr_chess_game.add_move(black);
+/**
+ * Returns the amount of games of the file opened with open_index().
+ */
+size_t PGN_Reader::get_amt_indexed_games() const { return index.size(); }
 
-          ++it;
-        }
-      } while (std::getline(if_reader, curr_move));
+/**
+ * Parses the game with index game_nr of the file opened with open_index()
+ * into game. The filter is not applied. Returns 0 if there is no such game.
+ */
+int PGN_Reader::read_game(size_t game_nr, PGN_Chess_Game &game) {
+  PGN_Diagnostics read_diagnostics;
+  int found = read_indexed_game(game_nr, game, read_diagnostics);
+  publish_diagnostics(read_diagnostics);
+  return found;
+}
 
-      pgn_chess_games.push_back(curr_chess_game);
-    }
+/**
+ * Parses the game with index game_nr of the indexed file into game and
+ * reports its problems to sink. Returns 0 if there is no such game.
+ */
+int PGN_Reader::read_indexed_game(size_t game_nr, PGN_Chess_Game &game,
+                                  PGN_Diagnostics &sink) {
+  if (game_nr >= index.size())
+    return 0;
+
+  const PGN_Index_Entry &entry = index.get_entry(game_nr);
+  std::string_view buffer = indexed_file->view();
+  if (entry.offset + entry.length > buffer.size())
+    return 0;
+
+  PGN_Game_Span span;
+  size_t pos = 0;
+  if (!PGN_Lexer::next_game_span(buffer.substr(entry.offset, entry.length),
+                                 pos, span))
+    return 0;
+
+  span.offset += entry.offset;
+  build_game(span, game, sink, game_nr, indexed_file, index_tag_pool);
+  return 1;
+}
+
+/**
+ * Returns up to amt_games consecutive games starting at game_nr
+ * first_game_nr of the file opened with open_index(). Games that can not be
+ * read are skipped.
+ */
+std::vector<PGN_Chess_Game> PGN_Reader::read_games(size_t first_game_nr,
+                                                   size_t amt_games) {
+  std::vector<PGN_Chess_Game> pgn_chess_games;
+  PGN_Diagnostics read_diagnostics;
+  if (first_game_nr >= index.size()) {
+    publish_diagnostics(read_diagnostics);
+    return pgn_chess_games;
   }
 
-  if_reader.close();
+  amt_games = std::min(amt_games, index.size() - first_game_nr);
+  std::shared_ptr<std::pmr::memory_resource> arena = new_arena();
+  pgn_chess_games.reserve(amt_games);
+  for (size_t i = 0; i < amt_games; i++) {
+    pgn_chess_games.emplace_back(arena);
+    if (!read_indexed_game(first_game_nr + i, pgn_chess_games.back(),
+                           read_diagnostics))
+      pgn_chess_games.pop_back();
+  }
+  publish_diagnostics(read_diagnostics);
   return pgn_chess_games;
 }
 
-// Returns a positive number if the seven tag roster is contained within tag
-// pair map
-int PGN_Reader::validate_tag_pair_map(
-    std::map<std::string, std::string> tag_pair_map) {
+/**
+ * Closes the file opened with open_index().
+ */
+void PGN_Reader::close_index() {
+  // Lazy games may still point into the mapping
+  if (indexed_file.use_count() == 1)
+    indexed_file->close();
+  else
+    indexed_file = std::make_shared<Mapped_File>();
+  index.close();
+}
+
+/**
+ * Starts following the specified PGN file, which may still be appended to.
+ * Games are parsed from start_offset on, e.g. the value of
+ * get_follow_offset() of a previous session. Returns 1 if the file could be
+ * opened.
+ */
+int PGN_Reader::follow(std::string file_path, uint64_t start_offset) {
+  follow_diagnostics.reset();
+  follow_game_nr = 0;
+  return follower.open(file_path, start_offset);
+}
+
+/**
+ * Parses the complete games appended to the followed file since the last call
+ * and appends them to pgn_chess_games. A partially written trailing game is
+ * held back. Returns the amount of added games. Every poll interns into a new
+ * tag pool, as a followed file may grow without end.
+ */
+int PGN_Reader::poll_games(std::vector<PGN_Chess_Game> &pgn_chess_games) {
+  PGN_Game_Span span;
+  int amt_games = 0;
+
+  follower.refill(follow_diagnostics, follow_game_nr);
+  auto tag_pool = std::make_shared<String_Pool>();
+  std::shared_ptr<std::pmr::memory_resource> arena = new_arena();
+  for (; follower.next_span(span); follow_game_nr++) {
+    if (!accept_game(span))
+      continue;
+    pgn_chess_games.emplace_back(arena);
+    // The follow buffer is compacted, lazy games keep a copy of the movetext
+    build_game(span, pgn_chess_games.back(), follow_diagnostics,
+               follow_game_nr, nullptr, tag_pool);
+    if (is_duplicate(pgn_chess_games.back(), follow_diagnostics, span.offset,
+                     follow_game_nr)) {
+      pgn_chess_games.pop_back();
+      continue;
+    }
+    amt_games++;
+  }
+  publish_diagnostics(follow_diagnostics);
+  return amt_games;
+}
+
+/**
+ * Like poll_games(), but waits up to timeout_ms milliseconds for new complete
+ * games to be appended. Returns the amount of added games.
+ */
+int PGN_Reader::wait_for_games(std::vector<PGN_Chess_Game> &pgn_chess_games,
+                               int timeout_ms) {
+  auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+
+  while (follower.is_open()) {
+    int amt_games = poll_games(pgn_chess_games);
+    if (amt_games > 0)
+      return amt_games;
+
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now());
+    if (remaining.count() <= 0)
+      break;
+    follower.wait(static_cast<int>(remaining.count()));
+  }
+  return 0;
+}
+
+/**
+ * Returns the file offset after the last complete game of the followed file.
+ */
+uint64_t PGN_Reader::get_follow_offset() const { return follower.get_offset(); }
+
+/**
+ * Stops following the file opened with follow().
+ */
+void PGN_Reader::stop_following() {
+  if (follower.is_open())
+    finish_read(follow_diagnostics);
+  follower.close();
+}
+
+/**
+ * Only games matching filter are returned by subsequent reads.
+ */
+void PGN_Reader::set_filter(const PGN_Filter &filter) { this->filter = filter; }
+
+/**
+ * Removes the filter, subsequent reads return all games.
+ */
+void PGN_Reader::clear_filter() { filter.clear(); }
+
+/**
+ * If capture is 1, comments, variations and NAGs of the movetext are added to
+ * the games as annotations. Otherwise they are skipped.
+ */
+void PGN_Reader::set_capture_annotations(int capture) {
+  capture_annotations = capture;
+}
+
+/**
+ * If arena_mode is 1, the tag pair and move buffers of all games returned by a
+ * read are carved out of a few large blocks. The blocks are released at once
+ * when the last of these games is destroyed. Intended for batches that are
+ * read, used and dropped together.
+ */
+void PGN_Reader::set_arena_mode(int arena_mode) {
+  this->arena_mode = arena_mode;
+}
+
+/**
+ * If lazy is 1, games only keep a reference to their raw movetext, which is
+ * tokenized on the first access to its moves. Reads that only inspect tags
+ * then skip tokenization entirely. Games of plain files share the file
+ * mapping, which stays alive until the last of them is destroyed; games of
+ * compressed or followed files keep a copy of their movetext.
+ */
+void PGN_Reader::set_lazy_movetext(int lazy) { lazy_movetext = lazy; }
+
+/**
+ * If amt_buffers is positive, sequential reads (return_games() with a single
+ * thread, open() and next_game()) read plain files with amt_buffers large
+ * buffers in flight ahead of the parser, using io_uring if available and a
+ * pread thread otherwise. Reading then overlaps with parsing on storage with
+ * high latency. By default files are memory-mapped.
+ */
+void PGN_Reader::set_read_ahead(int amt_buffers) {
+  amt_read_ahead_buffers = amt_buffers;
+}
+
+/**
+ * If dedup is 1, games repeating the moves of a game read before are dropped
+ * by subsequent reads. If use_key_tags is 1, their White, Black, Date and
+ * Result tags have to be equal as well. The seen games are remembered across
+ * reads until set_dedup() is called again. Deduplication tokenizes lazily
+ * read movetext and does not apply to read_game() and read_games().
+ */
+void PGN_Reader::set_dedup(int dedup, int use_key_tags) {
+  if (dedup)
+    dedup_set = std::make_shared<Game_Dedup_Set>(use_key_tags);
+  else
+    dedup_set.reset();
+}
+
+/**
+ * Deduplicates subsequent reads against dedup_set, which may be shared with
+ * readers ingesting other files in parallel. An empty pointer turns
+ * deduplication off.
+ */
+void PGN_Reader::set_dedup_set(std::shared_ptr<Game_Dedup_Set> dedup_set) {
+  this->dedup_set = dedup_set;
+}
+
+/**
+ * Returns the amount of duplicate games dropped by the last read.
+ */
+uint64_t PGN_Reader::get_amt_duplicates() const {
+  std::lock_guard<std::mutex> lock(diagnostics_mutex);
+  return diagnostics.get_count(DIAGNOSTIC_DUPLICATE_GAME);
+}
+
+/**
+ * Returns a new arena for the games of a read, or an empty pointer if arena
+ * mode is off.
+ */
+std::shared_ptr<std::pmr::memory_resource> PGN_Reader::new_arena() const {
+  if (!arena_mode)
+    return nullptr;
+  return std::make_shared<std::pmr::monotonic_buffer_resource>(ARENA_BLOCK_SIZE);
+}
+
+/**
+ * If print is 1, a summary of the problems found is written to std::cerr
+ * after each completed read. The problems are always available through
+ * get_diagnostics().
+ */
+void PGN_Reader::set_print_summary(int print) { print_summary = print; }
+
+/**
+ * Returns a copy of the problems found by the last finished read. Game
+ * numbers count all games of the file, including games rejected by the
+ * filter. A streaming read publishes its problems once the file is exhausted,
+ * a followed file after every poll.
+ */
+PGN_Diagnostics PGN_Reader::get_diagnostics() const {
+  std::lock_guard<std::mutex> lock(diagnostics_mutex);
+  return diagnostics;
+}
+
+/**
+ * Makes the problems collected in sink by a read the result of
+ * get_diagnostics().
+ */
+void PGN_Reader::publish_diagnostics(const PGN_Diagnostics &sink) {
+  std::lock_guard<std::mutex> lock(diagnostics_mutex);
+  diagnostics = sink;
+}
+
+/**
+ * Publishes the problems of a completed read and writes their summary, if
+ * there were any.
+ */
+void PGN_Reader::finish_read(const PGN_Diagnostics &sink) {
+  publish_diagnostics(sink);
+  if (print_summary && sink.get_total_count() > 0)
+    std::cerr << sink.summary();
+}
+
+/**
+ * Returns 1 if the game in span passes the filter. Only the tag section is
+ * inspected, so the movetext of rejected games is never tokenized.
+ */
+int PGN_Reader::accept_game(const PGN_Game_Span &span) const {
+  return filter.is_empty() || filter.matches(span.tag_section);
+}
+
+/**
+ * Returns 1 if deduplication is on and game repeats an earlier game, which is
+ * then reported to sink.
+ */
+int PGN_Reader::is_duplicate(PGN_Chess_Game &game, PGN_Diagnostics &sink,
+                             uint64_t offset, uint64_t game_nr) {
+  if (!dedup_set || dedup_set->insert(game))
+    return 0;
+
+  sink.report(DIAGNOSTIC_DUPLICATE_GAME, offset, game_nr);
+  return 1;
+}
+
+/**
+ * Builds game from the tag and movetext sections of span, the game_nr-th game
+ * of the file. Tag pairs are interned into tag_pool, the pool of the read, and
+ * problems are reported to sink. In lazy mode the movetext is referenced
+ * through span_owner, or copied if span_owner is empty.
+ */
+void PGN_Reader::build_game(const PGN_Game_Span &span, PGN_Chess_Game &game,
+                            PGN_Diagnostics &sink, uint64_t game_nr,
+                            const std::shared_ptr<const void> &span_owner,
+                            const std::shared_ptr<String_Pool> &tag_pool) {
+  std::string_view tag_section = span.tag_section;
+  std::string_view key, value;
+  size_t pos = 0;
+
+  game.clear();
+  game.set_tag_pool(tag_pool);
+  // One tag pair per line, so the tag pairs are allocated at once
+  game.reserve_tag_pairs(
+      std::count(tag_section.begin(), tag_section.end(), '\n') + 1);
+
+  // Match key and value from each tag pair line and add to the game
+  while (pos < tag_section.size()) {
+    std::string_view line = PGN_Lexer::next_line(tag_section, pos);
+
+    if (PGN_Lexer::parse_tag_pair(line, key, value)) {
+      if ((key == "WhiteElo" || key == "BlackElo") && value.empty()) {
+        value = "-1";
+      }
+
+      game.add_tag_pair(key, value);
+    } else {
+      sink.report(DIAGNOSTIC_MALFORMED_TAG_PAIR,
+                  span.offset + (line.data() - tag_section.data()), game_nr);
+    }
+  }
+
+  // The tag pairs are required to have at least the seven tag roster
+  // [Event, Site, Date, Round, White, Black, Result]
+  // Additionally, optional tag pairs may be specified.
+  if (!validate_tag_pairs(game))
+    sink.report(DIAGNOSTIC_MISSING_TAG_ROSTER, span.offset, game_nr);
+
+  if (lazy_movetext)
+    game.set_raw_movetext(span.movetext, span_owner, capture_annotations);
+  else
+    PGN_Lexer::tokenize_movetext(span.movetext, game, capture_annotations);
+}
+
+// Returns a positive number if the seven tag roster is contained within the
+// tag pairs of game
+int PGN_Reader::validate_tag_pairs(const PGN_Chess_Game &game) {
+  std::string_view value;
   for (auto &tp : seven_tag_roster) {
-    if (tag_pair_map.find(tp) == tag_pair_map.end())
+    if (!game.get_tag(tp, value))
       return 0;
   }
 
   return 1;
 }
-
-// Helps trim the getline strings from pgn files.
-void PGN_Reader::trim_string(std::string &str) {
-  str.erase(str.begin(),
-            std::find_if(str.begin(), str.end(), [](unsigned char ch) {
-              return !std::isspace(ch) && ch != '[' && ch != ']';
-            }));
-  str.erase(std::find_if(str.rbegin(), str.rend(),
-                         [](unsigned char ch) {
-                           return !std::isspace(ch) && ch != '[' && ch != ']';
-                         })
-                .base(),
-            str.end());
-}
\ No newline at end of file
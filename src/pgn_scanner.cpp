@@ -0,0 +1,191 @@
+#include "../include/pgn_scanner.hpp"
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#if !defined(HPCE_NO_SIMD) && defined(__GNUC__) &&                            \
+    (defined(__x86_64__) || defined(__i386__))
+#define HPCE_HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+typedef void (*Classify_Function)(const char *, Scan_Masks &);
+
+/**
+ * Returns 1 if c separates movetext tokens.
+ */
+static inline int is_whitespace(unsigned char c) {
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+/**
+ * Returns 1 if c starts a comment, variation or NAG.
+ */
+static inline int is_annotation(unsigned char c) {
+  return c == '{' || c == '(' || c == ')' || c == ';' || c == '$';
+}
+
+/**
+ * Classifies the 64 bytes at block one byte at a time.
+ */
+void PGN_Scanner::classify_scalar(const char *block, Scan_Masks &masks) {
+  masks.whitespace = 0;
+  masks.annotation = 0;
+  for (int i = 0; i < SCAN_BLOCK_SIZE; i++) {
+    unsigned char c = static_cast<unsigned char>(block[i]);
+    masks.whitespace |= static_cast<uint64_t>(is_whitespace(c)) << i;
+    masks.annotation |= static_cast<uint64_t>(is_annotation(c)) << i;
+  }
+}
+
+#ifdef HPCE_HAVE_X86_SIMD
+/**
+ * Classifies the 64 bytes at block in four 16 byte lanes.
+ */
+__attribute__((target("sse2"))) static void
+classify_sse2(const char *block, Scan_Masks &masks) {
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i control_range = _mm_set1_epi8('\r' - '\t');
+  const __m128i brace = _mm_set1_epi8('{');
+  const __m128i open = _mm_set1_epi8('(');
+  const __m128i close = _mm_set1_epi8(')');
+  const __m128i semicolon = _mm_set1_epi8(';');
+  const __m128i dollar = _mm_set1_epi8('$');
+
+  masks.whitespace = 0;
+  masks.annotation = 0;
+  for (int i = 0; i < SCAN_BLOCK_SIZE; i += 16) {
+    __m128i x =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + i));
+
+    // '\t' to '\r' are contiguous, x - '\t' <= 4 as unsigned bytes
+    __m128i control = _mm_sub_epi8(x, tab);
+    control = _mm_cmpeq_epi8(_mm_min_epu8(control, control_range), control);
+    __m128i whitespace = _mm_or_si128(_mm_cmpeq_epi8(x, space), control);
+
+    __m128i annotation = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(x, brace), _mm_cmpeq_epi8(x, open)),
+        _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(x, close),
+                         _mm_cmpeq_epi8(x, semicolon)),
+            _mm_cmpeq_epi8(x, dollar)));
+
+    masks.whitespace |=
+        static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(whitespace)))
+        << i;
+    masks.annotation |=
+        static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(annotation)))
+        << i;
+  }
+}
+
+/**
+ * Classifies the 64 bytes at block in two 32 byte lanes.
+ */
+__attribute__((target("avx2"))) static void
+classify_avx2(const char *block, Scan_Masks &masks) {
+  const __m256i space = _mm256_set1_epi8(' ');
+  const __m256i tab = _mm256_set1_epi8('\t');
+  const __m256i control_range = _mm256_set1_epi8('\r' - '\t');
+  const __m256i brace = _mm256_set1_epi8('{');
+  const __m256i open = _mm256_set1_epi8('(');
+  const __m256i close = _mm256_set1_epi8(')');
+  const __m256i semicolon = _mm256_set1_epi8(';');
+  const __m256i dollar = _mm256_set1_epi8('$');
+
+  masks.whitespace = 0;
+  masks.annotation = 0;
+  for (int i = 0; i < SCAN_BLOCK_SIZE; i += 32) {
+    __m256i x =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + i));
+
+    __m256i control = _mm256_sub_epi8(x, tab);
+    control =
+        _mm256_cmpeq_epi8(_mm256_min_epu8(control, control_range), control);
+    __m256i whitespace =
+        _mm256_or_si256(_mm256_cmpeq_epi8(x, space), control);
+
+    __m256i annotation = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(x, brace),
+                        _mm256_cmpeq_epi8(x, open)),
+        _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(x, close),
+                            _mm256_cmpeq_epi8(x, semicolon)),
+            _mm256_cmpeq_epi8(x, dollar)));
+
+    masks.whitespace |=
+        static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(whitespace)))
+        << i;
+    masks.annotation |=
+        static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(annotation)))
+        << i;
+  }
+}
+#endif
+
+/**
+ * Picks the widest classifier supported by the CPU the program runs on.
+ */
+static Classify_Function select_classifier(const char *&isa) {
+#ifdef HPCE_HAVE_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    isa = "avx2";
+    return classify_avx2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    isa = "sse2";
+    return classify_sse2;
+  }
+#endif
+  isa = "scalar";
+  return PGN_Scanner::classify_scalar;
+}
+
+static const char *classifier_isa = "scalar";
+static const Classify_Function classifier = select_classifier(classifier_isa);
+
+/**
+ * Classifies the 64 bytes at block with the classifier selected for this CPU.
+ */
+void PGN_Scanner::classify(const char *block, Scan_Masks &masks) {
+  classifier(block, masks);
+}
+
+/**
+ * Returns the name of the instruction set used by classify(), i.e. "avx2",
+ * "sse2" or "scalar".
+ */
+const char *PGN_Scanner::get_isa() { return classifier_isa; }
+
+/**
+ * Starts a scan over buffer. Blocks are classified when they are first
+ * entered.
+ */
+void PGN_Scanner::start(std::string_view buffer, Scan_State &state) {
+  state.begin = buffer.data();
+  state.end = buffer.data() + buffer.size();
+  state.block = state.end;
+  state.masks = {0, 0};
+}
+
+/**
+ * Classifies the block of state containing p. Blocks are aligned relative to
+ * the start of the buffer. The last block is padded with whitespace, so that
+ * scans stop at the end of the buffer.
+ */
+void PGN_Scanner::load(const char *p, Scan_State &state) {
+  size_t offset = static_cast<size_t>(p - state.begin);
+  state.block = state.begin + offset - offset % SCAN_BLOCK_SIZE;
+
+  if (state.end - state.block >= SCAN_BLOCK_SIZE) {
+    classify(state.block, state.masks);
+    return;
+  }
+
+  char padded[SCAN_BLOCK_SIZE];
+  memset(padded, ' ', SCAN_BLOCK_SIZE);
+  memcpy(padded, state.block, static_cast<size_t>(state.end - state.block));
+  classify(padded, state.masks);
+}
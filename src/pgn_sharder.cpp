@@ -0,0 +1,148 @@
+#include "../include/pgn_sharder.hpp"
+#include "../include/mapped_file.hpp"
+#include "../include/pgn_chess_game.hpp"
+#include "../include/pgn_reader.hpp"
+#include "../include/pgn_writer.hpp"
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+/**
+ * Default constructor. Initializes a sharder without inputs.
+ */
+PGN_Sharder::PGN_Sharder() {}
+
+/**
+ * Default deconstructor.
+ */
+PGN_Sharder::~PGN_Sharder() {}
+
+/**
+ * Adds the PGN file at file_path to the inputs of the next shard() call.
+ */
+void PGN_Sharder::add_input(std::string file_path) {
+  input_paths.push_back(file_path);
+}
+
+/**
+ * Distributes the games of all inputs over amt_shards files named
+ * output_prefix_<n>.pgn, compressed if compression is COMPRESSION_GZIP or
+ * COMPRESSION_ZSTD, and writes output_prefix.manifest. Every game goes to the
+ * shard with the fewest plies so far. Returns 1 if all shards and the
+ * manifest were written.
+ */
+int PGN_Sharder::shard(std::string output_prefix, size_t amt_shards,
+                       int compression) {
+  shards.clear();
+  if (amt_shards == 0)
+    return 0;
+
+  std::string extension = ".pgn";
+  if (compression == COMPRESSION_GZIP)
+    extension += ".gz";
+  else if (compression == COMPRESSION_ZSTD)
+    extension += ".zst";
+
+  std::vector<std::unique_ptr<PGN_Writer>> writers;
+  for (size_t i = 0; i < amt_shards; i++) {
+    PGN_Shard shard_info{output_prefix + "_" + std::to_string(i) + extension,
+                         0, 0, 0, 0};
+    writers.push_back(std::make_unique<PGN_Writer>());
+    if (!writers.back()->open(shard_info.file_path, compression))
+      return 0;
+    shards.push_back(shard_info);
+  }
+
+  int success = 1;
+  PGN_Chess_Game game;
+  for (const std::string &input_path : input_paths) {
+    PGN_Reader pgn_reader;
+    if (!pgn_reader.open(input_path)) {
+      success = 0;
+      continue;
+    }
+
+    while (pgn_reader.next_game(game)) {
+      size_t lightest = 0;
+      for (size_t i = 1; i < amt_shards; i++) {
+        if (shards[i].amt_plies < shards[lightest].amt_plies)
+          lightest = i;
+      }
+
+      // Counting plies tokenizes the game, so it is counted before it is
+      // formatted
+      size_t amt_plies = game.get_amt_plies();
+      if (!writers[lightest]->add_game(game)) {
+        success = 0;
+        break;
+      }
+      shards[lightest].amt_games++;
+      shards[lightest].amt_plies += amt_plies;
+    }
+    pgn_reader.close();
+  }
+
+  for (size_t i = 0; i < amt_shards; i++) {
+    if (!writers[i]->close() ||
+        !checksum_file(shards[i].file_path, shards[i].checksum)) {
+      success = 0;
+      continue;
+    }
+    Mapped_File shard_file;
+    if (shard_file.open(shards[i].file_path))
+      shards[i].amt_bytes = shard_file.size();
+  }
+
+  if (!write_manifest(output_prefix + ".manifest"))
+    success = 0;
+  return success;
+}
+
+/**
+ * Returns the shards written by the last shard() call.
+ */
+const std::vector<PGN_Shard> &PGN_Sharder::get_shards() const {
+  return shards;
+}
+
+/**
+ * Stores the 64-bit FNV-1a hash of the bytes of the file at file_path in
+ * checksum. Returns 1 if the file could be read.
+ */
+int PGN_Sharder::checksum_file(std::string file_path, uint64_t &checksum) {
+  Mapped_File file;
+  if (!file.open(file_path))
+    return 0;
+
+  uint64_t hash = FNV_OFFSET_BASIS;
+  for (unsigned char c : file.view()) {
+    hash ^= c;
+    hash *= FNV_PRIME;
+  }
+  checksum = hash;
+  return 1;
+}
+
+/**
+ * Writes one tab-separated line per shard with its file, games, plies, bytes
+ * and checksum in hexadecimal. Returns 1 if the manifest was written.
+ */
+int PGN_Sharder::write_manifest(std::string manifest_path) const {
+  std::ofstream manifest(manifest_path);
+  manifest << "# file\tgames\tplies\tbytes\tfnv1a64\n";
+  for (const PGN_Shard &shard_info : shards) {
+    manifest << shard_info.file_path << '\t' << shard_info.amt_games << '\t'
+             << shard_info.amt_plies << '\t' << shard_info.amt_bytes << '\t'
+             << std::hex << std::setw(16) << std::setfill('0')
+             << shard_info.checksum << std::dec << '\n';
+  }
+  manifest.close();
+  return manifest.fail() ? 0 : 1;
+}
@@ -0,0 +1,194 @@
+#include "../include/pgn_source.hpp"
+#include "../include/mapped_file.hpp"
+#include "../include/pgn_decompressor.hpp"
+#include "../include/pgn_diagnostics.hpp"
+#include "../include/pgn_lexer.hpp"
+#include "../include/pgn_read_ahead.hpp"
+#include <memory>
+#include <string>
+
+// Amount of parsed input kept resident before it is released behind the
+// cursor. Keeps the footprint of a scan constant regardless of file size.
+#define RELEASE_WINDOW (64 << 20)
+// Bytes per read ahead buffer
+#define READ_AHEAD_BUFFER_SIZE (4 << 20)
+
+/**
+ * Default constructor. Initializes a closed source.
+ */
+PGN_Source::PGN_Source()
+    : mapped_file{std::make_shared<Mapped_File>()}, pos{0}, released{0},
+      compression{COMPRESSION_NONE}, amt_read_ahead_buffers{0}, stream_pos{0},
+      stream_offset{0}, stream_end{0} {}
+
+/**
+ * Default deconstructor.
+ */
+PGN_Source::~PGN_Source() {}
+
+/**
+ * If amt_buffers is positive, plain files opened from now on are read with
+ * amt_buffers buffers in flight ahead of the parser instead of being
+ * memory-mapped. Intended for network or spinning storage, where page faults
+ * on a mapping stall the parser on every read.
+ */
+void PGN_Source::set_read_ahead(int amt_buffers) {
+  amt_read_ahead_buffers = amt_buffers > 0 ? amt_buffers : 0;
+}
+
+/**
+ * Opens the PGN file at file_path. Compressed files are detected by their
+ * magic bytes. A compression this build can not decompress is reported to
+ * sink. Returns 1 if the file could be opened.
+ */
+int PGN_Source::open(const std::string &file_path, PGN_Diagnostics &sink) {
+  close();
+
+  if (!mapped_file->open(file_path))
+    return 0;
+
+  compression = PGN_Decompressor::detect_compression(mapped_file->view());
+  if (compression == COMPRESSION_NONE && amt_read_ahead_buffers > 0) {
+    read_ahead = std::make_unique<PGN_Read_Ahead>(amt_read_ahead_buffers,
+                                                  READ_AHEAD_BUFFER_SIZE);
+    // Platforms without pread fall back to the mapping
+    if (read_ahead->start(file_path))
+      mapped_file->close();
+    else
+      read_ahead.reset();
+  }
+  if (compression == COMPRESSION_NONE)
+    return 1;
+
+  if (!decompressor.start(mapped_file->view(), compression)) {
+    sink.report(DIAGNOSTIC_UNSUPPORTED_INPUT, 0, 0);
+    close();
+    return 0;
+  }
+  return 1;
+}
+
+/**
+ * Retrieves the next game span. Returns 0 once the file is exhausted.
+ */
+int PGN_Source::next_span(PGN_Game_Span &span) {
+  if (read_ahead)
+    return next_stream_span(span);
+  if (!mapped_file->is_open())
+    return 0;
+  if (compression != COMPRESSION_NONE)
+    return next_stream_span(span);
+
+  if (pos - released >= RELEASE_WINDOW)
+    released = mapped_file->release(pos);
+
+  return PGN_Lexer::next_game_span(mapped_file->view(), pos, span);
+}
+
+/**
+ * Retrieves the next complete game span from the decompressed or read ahead
+ * stream. Chunks are appended to the carry buffer until it holds a complete
+ * game. The span offset refers to the decompressed stream.
+ */
+int PGN_Source::next_stream_span(PGN_Game_Span &span) {
+  std::string_view chunk;
+
+  while (!PGN_Lexer::next_game_span(stream_buffer, stream_pos, span,
+                                    stream_end)) {
+    if (stream_end)
+      return 0;
+
+    // Drop consumed bytes before growing the buffer
+    stream_buffer.erase(0, stream_pos);
+    stream_offset += stream_pos;
+    stream_pos = 0;
+
+    if (next_chunk(chunk))
+      stream_buffer.append(chunk);
+    else
+      stream_end = 1;
+  }
+
+  span.offset += stream_offset;
+  return 1;
+}
+
+/**
+ * Retrieves the next chunk of the stream.
+ */
+int PGN_Source::next_chunk(std::string_view &chunk) {
+  if (read_ahead)
+    return read_ahead->next_chunk(chunk);
+  return decompressor.next_chunk(chunk);
+}
+
+/**
+ * Closes the underlying file. The mapping stays alive while span owners
+ * returned by get_span_owner() are held.
+ */
+void PGN_Source::close() {
+  decompressor.stop();
+  read_ahead.reset();
+  if (mapped_file.use_count() == 1)
+    mapped_file->close();
+  else
+    mapped_file = std::make_shared<Mapped_File>();
+  pos = 0;
+  released = 0;
+  compression = COMPRESSION_NONE;
+  stream_buffer.clear();
+  stream_pos = 0;
+  stream_offset = 0;
+  stream_end = 0;
+}
+
+/**
+ * Returns 1 if a file is currently open.
+ */
+int PGN_Source::is_open() const {
+  return read_ahead != nullptr || mapped_file->is_open();
+}
+
+/**
+ * Returns 1 if the opened file is gzip or zstd compressed.
+ */
+int PGN_Source::is_compressed() const {
+  return compression != COMPRESSION_NONE;
+}
+
+/**
+ * Returns 1 if the opened file is read ahead into buffers.
+ */
+int PGN_Source::is_read_ahead() const { return read_ahead != nullptr; }
+
+/**
+ * Returns 1 if the stream ended early because the compressed input is
+ * corrupt or truncated, or because reading ahead failed. The spans returned
+ * before cover the input up to the error.
+ */
+int PGN_Source::has_error() const {
+  if (read_ahead)
+    return read_ahead->has_error();
+  return compression != COMPRESSION_NONE && decompressor.has_error();
+}
+
+/**
+ * Returns the offset in the (decompressed) stream up to which bytes have been
+ * read.
+ */
+uint64_t PGN_Source::get_stream_offset() const {
+  if (compression == COMPRESSION_NONE && !read_ahead)
+    return pos;
+  return stream_offset + stream_buffer.size();
+}
+
+/**
+ * Returns a handle that keeps the bytes of the spans of a mapped file valid,
+ * even after the source is closed. Returns an empty pointer for compressed
+ * and read ahead files, whose spans point into a buffer that is reused.
+ */
+std::shared_ptr<const void> PGN_Source::get_span_owner() const {
+  if (compression != COMPRESSION_NONE || read_ahead)
+    return nullptr;
+  return mapped_file;
+}
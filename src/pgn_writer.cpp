@@ -0,0 +1,479 @@
+#include "../include/pgn_writer.hpp"
+#include "../include/pgn_chess_game.hpp"
+#include "../include/pgn_decompressor.hpp"
+#include "../include/pgn_reader.hpp"
+#include <charconv>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef HPCE_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HPCE_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+// Formatted bytes collected before they are compressed and written
+#define WRITE_BUFFER_SIZE (4 << 20)
+
+static const std::string_view seven_tag_roster[] = {
+    "Event", "Site", "Date", "Round", "White", "Black", "Result"};
+
+/**
+ * Returns 1 if str is a game termination marker.
+ */
+static int is_termination(std::string_view str) {
+  return str == "1-0" || str == "0-1" || str == "1/2-1/2" || str == "*";
+}
+
+/**
+ * Default constructor. Initializes a closed writer.
+ */
+PGN_Writer::PGN_Writer()
+    : compression{COMPRESSION_NONE}, stream{nullptr}, amt_games{0},
+      amt_bytes{0}, failed{0}, roster_pool_size{0} {}
+
+/**
+ * Default deconstructor. Completes the file if it is still open.
+ */
+PGN_Writer::~PGN_Writer() {
+  if (out.is_open())
+    close();
+}
+
+/**
+ * Creates the PGN file at file_path. The output is compressed if compression
+ * is COMPRESSION_GZIP or COMPRESSION_ZSTD, with the library default level if
+ * level is negative. Returns 1 if the file could be created, 0 if it could
+ * not or if the compression is not supported by this build.
+ */
+int PGN_Writer::open(std::string file_path, int p_compression, int level) {
+  if (out.is_open())
+    close();
+
+  if (!PGN_Decompressor::is_supported(p_compression))
+    return 0;
+
+  out.open(file_path, std::ios::binary | std::ios::trunc);
+  if (!out.is_open())
+    return 0;
+
+  compression = p_compression;
+  amt_games = 0;
+  amt_bytes = 0;
+  failed = 0;
+  buffer.clear();
+  buffer.reserve(WRITE_BUFFER_SIZE + (64 << 10));
+  if (!start_compression(level)) {
+    out.close();
+    return 0;
+  }
+  return 1;
+}
+
+/**
+ * Appends game to the file. Games that were read lazily and never accessed
+ * keep their original movetext. Returns 0 if writing failed.
+ */
+int PGN_Writer::add_game(PGN_Chess_Game &game) {
+  if (!out.is_open())
+    return 0;
+
+  format_game(game, buffer);
+  amt_games++;
+  if (buffer.size() >= WRITE_BUFFER_SIZE)
+    flush(0);
+  return !failed;
+}
+
+/**
+ * Appends all remaining games of the file opened with pgn_reader.open(). The
+ * filter and lazy movetext setting of pgn_reader apply. Returns the amount of
+ * games written.
+ */
+size_t PGN_Writer::add_games(PGN_Reader &pgn_reader) {
+  PGN_Chess_Game game;
+  size_t amt_written = 0;
+
+  while (pgn_reader.next_game(game)) {
+    if (!add_game(game))
+      break;
+    amt_written++;
+  }
+  return amt_written;
+}
+
+/**
+ * Appends all games of the PGN file at pgn_path, streaming them one at a time.
+ * The movetext is copied without being tokenized. Returns the amount of games
+ * written.
+ */
+size_t PGN_Writer::add_pgn(std::string pgn_path) {
+  PGN_Reader pgn_reader;
+
+  pgn_reader.set_lazy_movetext(1);
+  if (!pgn_reader.open(pgn_path))
+    return 0;
+  return add_games(pgn_reader);
+}
+
+/**
+ * Writes the buffered games and completes the file. Returns 1 if all games
+ * were written successfully.
+ */
+int PGN_Writer::close() {
+  if (!out.is_open())
+    return 0;
+
+  flush(1);
+  end_compression();
+  out.close();
+  if (out.fail())
+    failed = 1;
+  buffer.clear();
+  return !failed;
+}
+
+/**
+ * Returns the amount of games written since open().
+ */
+uint64_t PGN_Writer::get_amt_games() const { return amt_games; }
+
+/**
+ * Returns the amount of uncompressed bytes written since open().
+ */
+uint64_t PGN_Writer::get_amt_bytes() const {
+  return amt_bytes + buffer.size();
+}
+
+/**
+ * Appends game in PGN export format to pgn, terminated by a blank line.
+ */
+void PGN_Writer::format_game(PGN_Chess_Game &game, std::string &pgn) {
+  format_tags(game, pgn);
+  pgn += '\n';
+
+  if (!game.is_tokenized()) {
+    pgn.append(game.get_raw_movetext());
+    pgn += "\n\n";
+    return;
+  }
+  format_movetext(game, pgn);
+}
+
+/**
+ * Appends the tag section of game to pgn, the seven tag roster first. Roster
+ * tags missing from game are written with the export format placeholders
+ * "?", "????.??.??" for the Date and the termination marker for the Result.
+ * Quotes and backslashes in values are escaped.
+ */
+void PGN_Writer::format_tags(PGN_Chess_Game &game, std::string &pgn) {
+  auto append_tag = [&pgn](std::string_view key, std::string_view value) {
+    pgn += '[';
+    pgn.append(key);
+    pgn += " \"";
+    if (memchr(value.data(), '"', value.size()) == nullptr &&
+        memchr(value.data(), '\\', value.size()) == nullptr) {
+      pgn.append(value);
+    } else {
+      for (char c : value) {
+        if (c == '\\' || c == '"')
+          pgn += '\\';
+        pgn += c;
+      }
+    }
+    pgn += "\"]\n";
+  };
+
+  // Games of a reader share a pool, so the roster ids are resolved again only
+  // when the pool changed
+  // Games without a pool have no tag pairs
+  std::shared_ptr<String_Pool> tag_pool = game.get_tag_pool();
+  const std::pmr::vector<Tag_Pair> &tag_pairs = game.get_tag_pair_ids();
+  size_t amt_tag_pairs = tag_pool ? tag_pairs.size() : 0;
+  if (tag_pool &&
+      (tag_pool != roster_pool || tag_pool->size() != roster_pool_size)) {
+    roster_pool = tag_pool;
+    roster_pool_size = tag_pool->size();
+    for (int i = 0; i < 7; i++) {
+      if (!tag_pool->find(seven_tag_roster[i], roster_ids[i]))
+        roster_ids[i] = UINT32_MAX;
+    }
+  }
+
+  // Resolves all keys and values under a single lock of the pool
+  tag_ids.clear();
+  for (size_t i = 0; i < amt_tag_pairs; i++) {
+    tag_ids.push_back(tag_pairs[i].key);
+    tag_ids.push_back(tag_pairs[i].value);
+  }
+  tag_strs.resize(tag_ids.size());
+  if (tag_pool)
+    tag_pool->lookup(tag_ids.data(), tag_ids.size(), tag_strs.data());
+
+  size_t roster_pairs[7];
+  for (int i = 0; i < 7; i++)
+    roster_pairs[i] = amt_tag_pairs;
+  for (size_t i = 0; i < amt_tag_pairs; i++) {
+    for (int j = 0; j < 7; j++) {
+      if (tag_pairs[i].key == roster_ids[j])
+        roster_pairs[j] = i;
+    }
+  }
+
+  for (int i = 0; i < 7; i++) {
+    if (roster_pairs[i] < amt_tag_pairs) {
+      append_tag(seven_tag_roster[i], tag_strs[2 * roster_pairs[i] + 1]);
+    } else if (seven_tag_roster[i] == "Date") {
+      append_tag(seven_tag_roster[i], "????.??.??");
+    } else if (seven_tag_roster[i] == "Result") {
+      const std::pmr::vector<Move> &moves = game.get_move_sequence_view();
+      if (!moves.empty() && is_termination(moves.back().move_notation))
+        append_tag(seven_tag_roster[i], moves.back().move_notation);
+      else
+        append_tag(seven_tag_roster[i], "*");
+    } else {
+      append_tag(seven_tag_roster[i], "?");
+    }
+  }
+  for (size_t i = 0; i < amt_tag_pairs; i++) {
+    int in_roster = 0;
+    for (int j = 0; j < 7; j++)
+      in_roster |= tag_pairs[i].key == roster_ids[j];
+    if (!in_roster)
+      append_tag(tag_strs[2 * i], tag_strs[2 * i + 1]);
+  }
+}
+
+/**
+ * Appends the moves and annotations of game to pgn, wrapped at
+ * PGN_LINE_LENGTH columns and completed with a game termination marker. The
+ * marker is taken from the last move, the Result tag or "*", in that order.
+ * The moves are formatted into a reused buffer large enough for the whole
+ * movetext.
+ */
+void PGN_Writer::format_movetext(PGN_Chess_Game &game, std::string &pgn) {
+  const std::pmr::vector<Move> &moves = game.get_move_sequence_view();
+  const std::pmr::vector<Annotation> &annotations =
+      game.get_annotations_view();
+
+  std::string_view termination = "*";
+  std::string_view result;
+  size_t amt_moves = moves.size();
+  if (amt_moves > 0 && is_termination(moves.back().move_notation)) {
+    termination = moves.back().move_notation;
+    amt_moves--;
+  } else if (game.get_tag("Result", result) && is_termination(result)) {
+    termination = result;
+  }
+
+  // Every token is preceded by one separator, a move by at most one move
+  // number of up to 11 digits and three dots
+  size_t capacity = termination.size() + 3;
+  for (const Move &move : moves)
+    capacity += move.move_notation.size() + 17;
+  for (const Annotation &annotation : annotations)
+    capacity += annotation.text.size() + 3;
+
+  if (movetext.size() < capacity)
+    movetext.resize(capacity);
+  char *p = &movetext[0];
+  const char *line_start = p;
+
+  // Tokens are separated by a space, or by a line feed if the line is full.
+  // A move number is kept on the same line as its move.
+  auto append_token = [&](const char *prefix, size_t prefix_size,
+                          std::string_view token, char suffix) {
+    size_t length = prefix_size + token.size() + (suffix != 0);
+    if (p > line_start) {
+      if (static_cast<size_t>(p - line_start) + 1 + length > PGN_LINE_LENGTH) {
+        *p++ = '\n';
+        line_start = p;
+      } else {
+        *p++ = ' ';
+      }
+    }
+    memcpy(p, prefix, prefix_size);
+    p += prefix_size;
+    memcpy(p, token.data(), token.size());
+    p += token.size();
+    if (suffix != 0)
+      *p++ = suffix;
+  };
+  auto append_annotation = [&](char open, std::string_view text, char close) {
+    append_token(&open, 1, text, close);
+
+    // Comments and variations may span multiple lines
+    size_t newline = text.rfind('\n');
+    if (newline != std::string_view::npos)
+      line_start = p - 1 - text.size() + newline + 1;
+  };
+
+  size_t next_annotation = 0;
+  int open_move_nr = -1; // white's move of this move number was just written
+  char number[16];
+  for (size_t i = 0; i <= amt_moves; i++) {
+    for (; next_annotation < annotations.size() &&
+           annotations[next_annotation].move_index <= i;
+         next_annotation++) {
+      const Annotation &annotation = annotations[next_annotation];
+      switch (annotation.type) {
+      case ANNOTATION_COMMENT:
+        append_annotation('{', annotation.text, '}');
+        break;
+      case ANNOTATION_VARIATION:
+        append_annotation('(', annotation.text, ')');
+        break;
+      case ANNOTATION_NAG:
+        append_token("$", 1, annotation.text, 0);
+        break;
+      }
+      open_move_nr = -1;
+    }
+    if (i == amt_moves)
+      break;
+
+    const Move &move = moves[i];
+    if (move.move_notation.empty()) {
+      open_move_nr = -1;
+      continue;
+    }
+
+    size_t number_size = 0;
+    if (move.turn == 0 || open_move_nr != move.move_nr) {
+      char *end = std::to_chars(number, number + 11, move.move_nr).ptr;
+      *end++ = '.';
+      if (move.turn != 0) {
+        *end++ = '.';
+        *end++ = '.';
+      }
+      *end++ = ' ';
+      number_size = static_cast<size_t>(end - number);
+    }
+    open_move_nr = move.turn == 0 ? move.move_nr : -1;
+    append_token(number, number_size, move.move_notation, 0);
+  }
+
+  append_token(nullptr, 0, termination, 0);
+  *p++ = '\n';
+  *p++ = '\n';
+  pgn.append(movetext.data(), static_cast<size_t>(p - movetext.data()));
+}
+
+/**
+ * Writes the buffered bytes to the file, compressing them if requested. If
+ * finish is 1, the compressed stream is completed. Returns 0 on failure.
+ */
+int PGN_Writer::flush([[maybe_unused]] int finish) {
+  amt_bytes += buffer.size();
+
+  if (compression == COMPRESSION_NONE) {
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+  }
+#ifdef HPCE_HAVE_ZLIB
+  else if (compression == COMPRESSION_GZIP) {
+    z_stream *z = static_cast<z_stream *>(stream);
+    z->next_in = reinterpret_cast<Bytef *>(buffer.data());
+    z->avail_in = static_cast<uInt>(buffer.size());
+    int ret;
+    do {
+      z->next_out = reinterpret_cast<Bytef *>(compressed_buffer.data());
+      z->avail_out = static_cast<uInt>(compressed_buffer.size());
+      ret = deflate(z, finish ? Z_FINISH : Z_NO_FLUSH);
+      if (ret == Z_STREAM_ERROR) {
+        failed = 1;
+        break;
+      }
+      out.write(compressed_buffer.data(),
+                static_cast<std::streamsize>(compressed_buffer.size() -
+                                             z->avail_out));
+      // Z_FINISH returns Z_OK until the stream end has been written
+    } while (z->avail_out == 0 || (finish && ret == Z_OK));
+  }
+#endif
+#ifdef HPCE_HAVE_ZSTD
+  else if (compression == COMPRESSION_ZSTD) {
+    ZSTD_CCtx *cctx = static_cast<ZSTD_CCtx *>(stream);
+    ZSTD_inBuffer in = {buffer.data(), buffer.size(), 0};
+    size_t remaining;
+    do {
+      ZSTD_outBuffer output = {compressed_buffer.data(),
+                               compressed_buffer.size(), 0};
+      remaining = ZSTD_compressStream2(cctx, &output, &in,
+                                       finish ? ZSTD_e_end : ZSTD_e_continue);
+      if (ZSTD_isError(remaining)) {
+        failed = 1;
+        break;
+      }
+      out.write(compressed_buffer.data(),
+                static_cast<std::streamsize>(output.pos));
+    } while (in.pos < in.size || (finish && remaining != 0));
+  }
+#endif
+
+  buffer.clear();
+  if (!out.good())
+    failed = 1;
+  return !failed;
+}
+
+/**
+ * Sets up the compression stream for the format chosen in open(). Returns 0
+ * if the stream could not be initialized.
+ */
+int PGN_Writer::start_compression([[maybe_unused]] int level) {
+  stream = nullptr;
+  if (compression == COMPRESSION_NONE)
+    return 1;
+  compressed_buffer.resize(1 << 20);
+
+#ifdef HPCE_HAVE_ZLIB
+  if (compression == COMPRESSION_GZIP) {
+    z_stream *z = new z_stream();
+    // 15 window bits + 16 writes a gzip header
+    if (deflateInit2(z, level < 0 ? Z_DEFAULT_COMPRESSION : level, Z_DEFLATED,
+                     15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+      delete z;
+      return 0;
+    }
+    stream = z;
+  }
+#endif
+#ifdef HPCE_HAVE_ZSTD
+  if (compression == COMPRESSION_ZSTD) {
+    ZSTD_CCtx *cctx = ZSTD_createCCtx();
+    if (cctx == nullptr)
+      return 0;
+    if (level >= 0)
+      ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
+    stream = cctx;
+  }
+#endif
+  return stream != nullptr;
+}
+
+/**
+ * Releases the compression stream.
+ */
+void PGN_Writer::end_compression() {
+  if (stream == nullptr)
+    return;
+
+#ifdef HPCE_HAVE_ZLIB
+  if (compression == COMPRESSION_GZIP) {
+    deflateEnd(static_cast<z_stream *>(stream));
+    delete static_cast<z_stream *>(stream);
+  }
+#endif
+#ifdef HPCE_HAVE_ZSTD
+  if (compression == COMPRESSION_ZSTD)
+    ZSTD_freeCCtx(static_cast<ZSTD_CCtx *>(stream));
+#endif
+  stream = nullptr;
+}
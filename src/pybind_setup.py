@@ -3,6 +3,7 @@ from setuptools.command.build_ext import build_ext
 import os
 import shutil
 import pybind11
+import ctypes.util
 
 # Compiles hpce and pgn_reader .so files with
 # python3 pybind_setup.py build_ext --inplace
@@ -15,11 +16,29 @@ class BuildExt(build_ext):
             ext.include_dirs.append(pybind11.get_include())
         build_ext.build_extensions(self)
 
+# Enable compressed PGN input and io_uring read ahead for the libraries
+# available on this system
+define_macros = []
+libraries = []
+for library, macro in (('z', 'HPCE_HAVE_ZLIB'), ('zstd', 'HPCE_HAVE_ZSTD'),
+                       ('uring', 'HPCE_HAVE_LIBURING')):
+    if ctypes.util.find_library(library):
+        define_macros.append((macro, None))
+        libraries.append(library)
+
 # Define the extension module for hpce (including pgn_reader.cpp)
 hpce_module = Extension(
     'hpce',  
-    sources=['hpce.cpp', 'pgn_reader.cpp'],
+    sources=['hpce.cpp', 'pgn_chess_game.cpp', 'pgn_reader.cpp',
+             'pgn_lexer.cpp', 'pgn_source.cpp', 'mapped_file.cpp',
+             'pgn_decompressor.cpp', 'chunk_queue.cpp', 'pgn_filter.cpp',
+             'string_pool.cpp', 'game_database.cpp', 'pgn_index.cpp',
+             'pgn_follower.cpp', 'pgn_diagnostics.cpp', 'pgn_scanner.cpp',
+             'pgn_read_ahead.cpp', 'pgn_writer.cpp', 'pgn_sharder.cpp',
+             'game_dedup_set.cpp', 'game_table.cpp'],
     include_dirs=[pybind11.get_include()],
+    define_macros=define_macros,
+    libraries=libraries,
     language='c++',
     extra_compile_args=['-std=c++17', '-O3'],
 )
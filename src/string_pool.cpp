@@ -0,0 +1,100 @@
+#include "../include/string_pool.hpp"
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+
+/**
+ * Default constructor. Initializes an empty pool.
+ */
+String_Pool::String_Pool() : amt_bytes{0} {}
+
+/**
+ * Default deconstructor.
+ */
+String_Pool::~String_Pool() {}
+
+/**
+ * Returns the id of str, adding it to the pool if it is not contained yet.
+ * Lookups of known strings only take a shared lock, so concurrent parser
+ * threads rarely contend.
+ */
+uint32_t String_Pool::intern(std::string_view str) {
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto it = ids.find(str);
+    if (it != ids.end())
+      return it->second;
+  }
+
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  auto it = ids.find(str); // may have been added in between
+  if (it != ids.end())
+    return it->second;
+
+  uint32_t id = static_cast<uint32_t>(strings.size());
+  strings.emplace_back(str);
+  ids.emplace(strings.back(), id);
+  amt_bytes += str.size();
+  return id;
+}
+
+/**
+ * Looks up the id of str without adding it. Returns 1 if str is contained.
+ */
+int String_Pool::find(std::string_view str, uint32_t &id) const {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  auto it = ids.find(str);
+  if (it == ids.end())
+    return 0;
+
+  id = it->second;
+  return 1;
+}
+
+/**
+ * Returns the string with the given id.
+ */
+std::string_view String_Pool::lookup(uint32_t id) const {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  return strings[id];
+}
+
+/**
+ * Stores the strings with the given ids in strs, taking the lock only once.
+ */
+void String_Pool::lookup(const uint32_t *ids, size_t amt_ids,
+                         std::string_view *strs) const {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  for (size_t i = 0; i < amt_ids; i++)
+    strs[i] = strings[ids[i]];
+}
+
+/**
+ * Returns the amount of distinct strings in the pool.
+ */
+size_t String_Pool::size() const {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  return strings.size();
+}
+
+/**
+ * Returns an estimate of the heap memory held by the pool in bytes.
+ */
+size_t String_Pool::memory_usage() const {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  return amt_bytes + strings.size() * (sizeof(std::string) +
+                                       sizeof(std::string_view) +
+                                       sizeof(uint32_t) + 2 * sizeof(void *));
+}
+
+/**
+ * Removes all strings. Previously returned ids and views are invalidated.
+ */
+void String_Pool::clear() {
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  ids.clear();
+  strings.clear();
+  amt_bytes = 0;
+}
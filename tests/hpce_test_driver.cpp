@@ -1,6 +1,113 @@
 #include "../include/hpce_test_driver.hpp"
 #include "../include/hpce.hpp"
 #include "../include/pgn_reader.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Counts calls to the global operator new of the test binary. The complete
+// set of replaceable allocation functions is replaced, so every allocation is
+// counted and released by the matching std::free().
+static std::atomic<size_t> amt_allocations{0};
+
+/**
+ * Allocates size bytes, or returns nullptr on failure.
+ */
+static void *allocate(size_t size) {
+  amt_allocations++;
+  return std::malloc(size ? size : 1);
+}
+
+/**
+ * Allocates size bytes aligned to alignment, or returns nullptr on failure.
+ */
+static void *allocate(size_t size, std::align_val_t alignment) {
+  amt_allocations++;
+  size_t align = static_cast<size_t>(alignment);
+  return std::aligned_alloc(align, (size + align - 1) / align * align);
+}
+
+void *operator new(size_t size) {
+  if (void *ptr = allocate(size))
+    return ptr;
+  throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) {
+  if (void *ptr = allocate(size))
+    return ptr;
+  throw std::bad_alloc();
+}
+
+void *operator new(size_t size, std::align_val_t alignment) {
+  if (void *ptr = allocate(size, alignment))
+    return ptr;
+  throw std::bad_alloc();
+}
+
+void *operator new[](size_t size, std::align_val_t alignment) {
+  if (void *ptr = allocate(size, alignment))
+    return ptr;
+  throw std::bad_alloc();
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  return allocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+  return allocate(size);
+}
+
+void *operator new(size_t size, std::align_val_t alignment,
+                   const std::nothrow_t &) noexcept {
+  return allocate(size, alignment);
+}
+
+void *operator new[](size_t size, std::align_val_t alignment,
+                     const std::nothrow_t &) noexcept {
+  return allocate(size, alignment);
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+
+void operator delete[](void *ptr, size_t) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, std::align_val_t) noexcept { std::free(ptr); }
+
+void operator delete[](void *ptr, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr, size_t, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t,
+                     const std::nothrow_t &) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t,
+                       const std::nothrow_t &) noexcept {
+  std::free(ptr);
+}
 
 /**
  * Default constructor. Initializes test driver class.
@@ -34,6 +141,11 @@ HPCE_Test_Driver::HPCE_Test_Driver() {
  */
 HPCE_Test_Driver::~HPCE_Test_Driver() {}
 
+/**
+ * Returns the amount of heap allocations made by the test binary so far.
+ */
+size_t HPCE_Test_Driver::get_amt_allocations() { return amt_allocations; }
+
 /**
  * Factory method for creating games within the test driver.
  */
@@ -1,11 +1,31 @@
 #define CATCH_CONFIG_MAIN
 
+#include "../include/game_database.hpp"
+#include "../include/game_table.hpp"
 #include "../include/hpce.hpp"
 #include "../include/hpce_test_driver.hpp"
+#include "../include/pgn_read_ahead.hpp"
 #include "../include/pgn_reader.hpp"
+#include "../include/pgn_writer.hpp"
+#include "../include/pgn_scanner.hpp"
+#include "../include/pgn_sharder.hpp"
 #include "catch.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <regex>
 #include <string>
+#include <thread>
+
+#ifdef HPCE_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HPCE_HAVE_ZSTD
+#include <zstd.h>
+#endif
 
 #define ILLEGAL_GAME 0
 #define LEGAL_GAME 1
@@ -140,6 +160,74 @@ TEST_CASE("Read single-game, malformed tags PGN file", "[pgn][single][tags]") {
           std::string::npos); // Check for expected message
 }
 
+TEST_CASE("Collect parser diagnostics with locations", "[pgn][tags]") {
+  std::string pgn_path =
+      (std::filesystem::temp_directory_path() / "hpce_diagnostics.pgn")
+          .string();
+  std::ifstream if_reader("../data/pgn_multi.pgn", std::ios::binary);
+  std::string pgn((std::istreambuf_iterator<char>(if_reader)),
+                  std::istreambuf_iterator<char>());
+
+  std::vector<size_t> game_starts = {0};
+  while (game_starts.size() <= 2000)
+    game_starts.push_back(pgn.find("\n\n[Event ", game_starts.back()) + 2);
+
+  // Rename the Event tag of game 2000 and break the Event tag of game 5
+  pgn.replace(game_starts[2000], 6, "[Annotator");
+  pgn.erase(game_starts[5] + 7, 1);
+  std::ofstream(pgn_path, std::ios::binary) << pgn;
+
+  PGN_Reader pgn_reader = PGN_Reader();
+  pgn_reader.set_print_summary(0);
+  for (int num_threads : {1, 3}) {
+    std::stringstream error_output;
+    std::streambuf *old_cerr = std::cerr.rdbuf(error_output.rdbuf());
+    std::vector<PGN_Chess_Game> test_games =
+        pgn_reader.return_games(pgn_path, num_threads);
+    std::cerr.rdbuf(old_cerr);
+    CHECK(error_output.str().empty());
+
+    const PGN_Diagnostics &diagnostics = pgn_reader.get_diagnostics();
+    CHECK(diagnostics.get_count(DIAGNOSTIC_MALFORMED_TAG_PAIR) == 1);
+    CHECK(diagnostics.get_count(DIAGNOSTIC_MISSING_TAG_ROSTER) == 2);
+
+    std::vector<uint64_t> roster_games;
+    for (const Diagnostic &diagnostic : diagnostics.get_samples()) {
+      if (diagnostic.category == DIAGNOSTIC_MALFORMED_TAG_PAIR) {
+        CHECK(diagnostic.game_nr == 5);
+        CHECK(diagnostic.offset == game_starts[5]);
+      } else {
+        roster_games.push_back(diagnostic.game_nr);
+      }
+    }
+    std::sort(roster_games.begin(), roster_games.end());
+    CHECK(roster_games == std::vector<uint64_t>{5, 2000});
+    CHECK(diagnostics.summary().find("(2x)") != std::string::npos);
+  }
+
+  // Concurrent reads on one reader collect their problems separately, the
+  // published diagnostics are those of one complete read
+  std::vector<size_t> amt_games(4);
+  std::vector<std::thread> readers;
+  for (size_t i = 0; i < amt_games.size(); i++) {
+    readers.emplace_back([&, i]() {
+      amt_games[i] =
+          pgn_reader
+              .return_games(i % 2 ? pgn_path : "../data/pgn_multi.pgn", 2)
+              .size();
+    });
+  }
+  for (std::thread &reader : readers)
+    reader.join();
+  CHECK(amt_games == std::vector<size_t>(4, 2671));
+  PGN_Diagnostics diagnostics = pgn_reader.get_diagnostics();
+  uint64_t amt_malformed = diagnostics.get_count(DIAGNOSTIC_MALFORMED_TAG_PAIR);
+  CHECK(diagnostics.get_count(DIAGNOSTIC_MISSING_TAG_ROSTER) ==
+        2 * amt_malformed);
+  CHECK(diagnostics.get_total_count() == 3 * amt_malformed);
+  std::remove(pgn_path.c_str());
+}
+
 TEST_CASE("Test Invalid Move: Knight Moves Diagonally", "[unit-test]") {
   Chess_Board board = Chess_Board();
   PGN_Reader pgn_reader = PGN_Reader();
@@ -159,7 +247,7 @@ TEST_CASE("Test Invalid Move: Knight Moves Diagonally", "[unit-test]") {
   std::vector<Move> move_sequence = {
       {1, 0, "e4"},  {1, 1, "e5"},  {2, 0, "Nf3"},   {2, 1, "d6"},
       {3, 0, "Nc3"}, {3, 1, "Nc6"}, {4, 0, "Ng5"},   {4, 1, "Be7"},
-      {5, 0, "Nd5"}, {5, 1, "Bf6"}, // Illegal move: Knight moves diagonally
+      {5, 0, "Nd4"}, {5, 1, "Bf6"}, // Illegal move: Knight moves diagonally
       {6, 0, "Bb5"}, {6, 1, "Ne7"}, {7, 0, "Nxe7+"}, {7, 1, "Kxe7"},
       {8, 0, "O-O"}, {8, 1, "a6"},  {9, 0, "Ba4"},   {9, 1, "*"}};
 
@@ -172,3 +260,1530 @@ TEST_CASE("Test Invalid Move: Knight Moves Diagonally", "[unit-test]") {
         invalid_chess_game.get_move_sequence());
   CHECK(board.is_legal_game(test_games[0]) == ILLEGAL_GAME);
 }
+
+TEST_CASE("Resolve knight and king moves next to the board edge",
+          "[unit-test]") {
+  Chess_Board board = Chess_Board();
+
+  // Candidate origin squares of these moves lie partly off the board
+  REQUIRE(board.load_fen("7n/8/8/8/8/8/8/KN5k w - - 0 1"));
+  CHECK(board.play_move("Na3") == 1);
+  CHECK(board.play_move("Ng6") == 1);
+  CHECK(board.play_move("Ka2") == 1);
+  CHECK(board.play_move("Na8") == 0);
+  CHECK(board.play_move("Kh2") == 1);
+  CHECK(board.play_move("Nh1") == 0);
+  CHECK(board.play_move("Nb1") == 1);
+}
+
+TEST_CASE("Replay games from packed moves", "[unit-test][packed]") {
+  std::map<std::string, std::string> tag_pairs = {{"Result", "*"}};
+  std::vector<Move> move_sequence = {
+      {1, 0, "e4"},   {1, 1, "Nf6"}, {2, 0, "e5"}, {2, 1, "d5"},
+      {3, 0, "exd6"}, {3, 1, "Nc6"}, {4, 0, "Nf3"}, {4, 1, "e5"},
+      {5, 0, "Bc4"},  {5, 1, "Be7"}, {6, 0, "O-O"}, {6, 1, "*"},
+      {6, 1, ""}};
+  PGN_Chess_Game game =
+      Game_Factory::create_pgn_chess_game(tag_pairs, move_sequence);
+
+  Chess_Board board = Chess_Board();
+  CHECK(!game.has_packed_moves());
+  REQUIRE(board.pack_moves(game) == LEGAL_GAME);
+
+  // One packed move per ply, squares counted from a1 = 0
+  const std::pmr::vector<Packed_Move> &packed_moves =
+      game.get_packed_moves_view();
+  REQUIRE(packed_moves.size() == game.get_amt_plies());
+  CHECK(packed_moves[0] == Chess_Board::pack_move(12, 28, 0, PACKED_NORMAL));
+  CHECK(packed_moves[4] ==
+        Chess_Board::pack_move(36, 43, 0, PACKED_EN_PASSANT));
+  CHECK(packed_moves[10] == Chess_Board::pack_move(4, 6, 0, PACKED_CASTLING));
+
+  // Packed moves reach the same position without resolving the notation
+  Chess_Board packed_board = Chess_Board();
+  for (Packed_Move move : packed_moves)
+    CHECK(packed_board.play_packed_move(move));
+  for (int rank = 0; rank < BOARD_SIZE; rank++)
+    for (int file = 0; file < BOARD_SIZE; file++)
+      CHECK(packed_board.get_figure(rank, file) == board.get_figure(rank, file));
+  CHECK(packed_board.get_bitboard(PAWN_TYPE, BLACK) ==
+        board.get_bitboard(PAWN_TYPE, BLACK));
+  CHECK(packed_board.turn == board.turn);
+
+  int square_from, square_to, promotion, flag;
+  Chess_Board::unpack_move(
+      Chess_Board::pack_move(52, 61, PACKED_KNIGHT, PACKED_PROMOTION),
+      square_from, square_to, promotion, flag);
+  CHECK(square_from == 52);
+  CHECK(square_to == 61);
+  CHECK(promotion == PACKED_KNIGHT);
+  CHECK(flag == PACKED_PROMOTION);
+
+  // Changing the moves drops the packed moves
+  game.add_move({7, 0, "a3"});
+  CHECK(!game.has_packed_moves());
+
+  // Illegal games are not packed
+  PGN_Reader pgn_reader = PGN_Reader();
+  std::vector<PGN_Chess_Game> test_games =
+      pgn_reader.return_games("../data/knight_moves_diagonally.pgn");
+  REQUIRE(test_games.size() == 1);
+  CHECK(board.pack_moves(test_games[0]) == ILLEGAL_GAME);
+  CHECK(!test_games[0].has_packed_moves());
+}
+
+/**
+ * Counts the leaf positions of the legal move tree of board up to depth.
+ */
+static uint64_t perft(const Chess_Board &board, int depth) {
+  Move_List move_list;
+  Chess_Board position = board;
+  int amt_moves = position.generate_legal_moves(move_list);
+  if (depth <= 1)
+    return amt_moves;
+
+  uint64_t nodes = 0;
+  for (int i = 0; i < amt_moves; i++) {
+    Chess_Board child = board;
+    child.play_packed_move(move_list.moves[i]);
+    nodes += perft(child, depth - 1);
+  }
+  return nodes;
+}
+
+TEST_CASE("Generate legal moves", "[unit-test][movegen]") {
+  // Initial position
+  Chess_Board board = Chess_Board();
+  CHECK(perft(board, 1) == 20);
+  CHECK(perft(board, 2) == 400);
+  CHECK(perft(board, 3) == 8902);
+  CHECK(perft(board, 4) == 197281);
+
+  // Reference positions covering castling, pins, en passant and promotions
+  REQUIRE(board.load_fen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/"
+                         "R3K2R w KQkq - 0 1"));
+  CHECK(perft(board, 1) == 48);
+  CHECK(perft(board, 2) == 2039);
+  CHECK(perft(board, 3) == 97862);
+
+  REQUIRE(board.load_fen("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1"));
+  CHECK(perft(board, 1) == 14);
+  CHECK(perft(board, 2) == 191);
+  CHECK(perft(board, 3) == 2812);
+  CHECK(perft(board, 4) == 43238);
+
+  REQUIRE(board.load_fen(
+      "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1"));
+  CHECK(perft(board, 1) == 6);
+  CHECK(perft(board, 2) == 264);
+  CHECK(perft(board, 3) == 9467);
+
+  REQUIRE(board.load_fen(
+      "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8"));
+  CHECK(perft(board, 1) == 44);
+  CHECK(perft(board, 2) == 1486);
+  CHECK(perft(board, 3) == 62379);
+
+  // Every move of a replayed game is among the generated moves
+  PGN_Reader pgn_reader = PGN_Reader();
+  std::vector<PGN_Chess_Game> games =
+      pgn_reader.return_games("../data/pgn_single.pgn");
+  REQUIRE(games.size() == 1);
+  Chess_Board replay_board = Chess_Board();
+  REQUIRE(replay_board.pack_moves(games[0]) == LEGAL_GAME);
+  Chess_Board game_board = Chess_Board();
+  Move_List move_list;
+  for (Packed_Move move : games[0].get_packed_moves_view()) {
+    game_board.generate_legal_moves(move_list);
+    CHECK(std::find(move_list.moves.begin(),
+                    move_list.moves.begin() + move_list.size,
+                    move) != move_list.moves.begin() + move_list.size);
+    game_board.play_packed_move(move);
+  }
+
+  // Malformed FEN strings leave the board unchanged
+  CHECK(!board.load_fen("rnbqkbnr/pppppppp/8/8 w KQkq - 0 1"));
+  CHECK(!board.load_fen("rnbqkbnr/pppppppp/9/8/8/8/PPPPPPPP/RNBQKBNR w"));
+  CHECK(!board.load_fen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR x"));
+  CHECK(perft(board, 1) == 44);
+}
+
+TEST_CASE("Scan game spans and tag pairs from a PGN buffer", "[pgn][lexer]") {
+  std::string_view buffer = "\n\n[Event \"A\"]\n[Site \"B\"]\n\n1.e4 e5 "
+                            "2.Nf3  1-0\n\n\n[Event \"C\"]\n\n1.d4 *\n\n\n";
+  PGN_Game_Span span;
+  size_t pos = 0;
+  int amt_games = 0;
+
+  while (PGN_Lexer::next_game_span(buffer, pos, span))
+    amt_games++;
+  CHECK(amt_games == 2); // trailing blank lines do not yield a game
+
+  pos = 0;
+  REQUIRE(PGN_Lexer::next_game_span(buffer, pos, span));
+  CHECK(span.tag_section == "[Event \"A\"]\n[Site \"B\"]");
+  CHECK(span.movetext == "1.e4 e5 2.Nf3  1-0");
+
+  std::string_view key, value;
+  CHECK(PGN_Lexer::parse_tag_pair("[WhiteElo \"2024\"]\r", key, value));
+  CHECK(key == "WhiteElo");
+  CHECK(value == "2024");
+  CHECK(PGN_Lexer::parse_tag_pair("[Event \"\"]", key, value));
+  CHECK(value.empty());
+  CHECK_FALSE(PGN_Lexer::parse_tag_pair("[Event\"A\"]", key, value));
+  CHECK_FALSE(PGN_Lexer::parse_tag_pair("[Event \"A\" x]", key, value));
+}
+
+TEST_CASE("Stream multi-game PGN file with game cursor", "[pgn][cursor]") {
+  PGN_Reader pgn_reader = PGN_Reader();
+
+  std::vector<PGN_Chess_Game> test_games =
+      pgn_reader.return_games("../data/pgn_multi.pgn");
+
+  REQUIRE(pgn_reader.open("../data/pgn_multi.pgn"));
+
+  PGN_Chess_Game game;
+  size_t amt_games = 0;
+  int amt_equal_games = 0;
+  while (pgn_reader.next_game(game)) {
+    if (amt_games < test_games.size() &&
+        game.get_tag_pairs() == test_games[amt_games].get_tag_pairs() &&
+        game.get_move_sequence() == test_games[amt_games].get_move_sequence())
+      amt_equal_games++;
+    amt_games++;
+  }
+  pgn_reader.close();
+
+  CHECK(amt_games == test_games.size());
+  CHECK(amt_equal_games == 2671);
+  CHECK(pgn_reader.next_game(game) == 0);
+}
+
+TEST_CASE("Read multi-game PGN file in parallel chunks", "[pgn][parallel]") {
+  PGN_Reader pgn_reader = PGN_Reader();
+
+  std::vector<PGN_Chess_Game> test_games =
+      pgn_reader.return_games("../data/pgn_multi.pgn");
+
+  for (int num_threads : {2, 7, 32}) {
+    std::vector<PGN_Chess_Game> parallel_games =
+        pgn_reader.return_games("../data/pgn_multi.pgn", num_threads);
+
+    REQUIRE(parallel_games.size() == test_games.size());
+    int amt_equal_games = 0;
+    for (size_t i = 0; i < test_games.size(); i++) {
+      if (parallel_games[i].get_tag_pairs() == test_games[i].get_tag_pairs() &&
+          parallel_games[i].get_move_sequence() ==
+              test_games[i].get_move_sequence())
+        amt_equal_games++;
+    }
+    CHECK(amt_equal_games == 2671);
+  }
+}
+
+TEST_CASE("Filter multi-game PGN file by tag pairs", "[pgn][filter]") {
+  PGN_Reader pgn_reader = PGN_Reader();
+
+  std::vector<PGN_Chess_Game> test_games =
+      pgn_reader.return_games("../data/pgn_multi.pgn");
+
+  // Reference selection evaluated on the complete tag pair maps
+  auto expected = [](std::map<std::string, std::string> tp) {
+    return PGN_Filter::parse_elo(tp["WhiteElo"]) >= 2200 &&
+           PGN_Filter::parse_elo(tp["BlackElo"]) >= 2200 &&
+           tp["ECO"].rfind("B", 0) == 0 && tp["Date"] >= "2014.03.01" &&
+           tp["Date"] <= "2018.12.31";
+  };
+  size_t amt_expected = 0;
+  for (auto &game : test_games)
+    amt_expected += expected(game.get_tag_pairs());
+  REQUIRE(amt_expected > 0);
+  REQUIRE(amt_expected < test_games.size());
+
+  PGN_Filter filter;
+  filter.set_elo_range(2200, 4000);
+  filter.add_eco_prefix("B");
+  filter.set_date_range("2014.03.01", "2018.12.31");
+  pgn_reader.set_filter(filter);
+
+  std::vector<PGN_Chess_Game> filtered_games =
+      pgn_reader.return_games("../data/pgn_multi.pgn");
+  CHECK(filtered_games.size() == amt_expected);
+  for (auto &game : filtered_games)
+    CHECK(expected(game.get_tag_pairs()));
+
+  std::vector<PGN_Chess_Game> parallel_games =
+      pgn_reader.return_games("../data/pgn_multi.pgn", 4);
+  CHECK(parallel_games.size() == amt_expected);
+
+  PGN_Chess_Game game;
+  size_t amt_streamed = 0;
+  REQUIRE(pgn_reader.open("../data/pgn_multi.pgn"));
+  while (pgn_reader.next_game(game))
+    amt_streamed++;
+  pgn_reader.close();
+  CHECK(amt_streamed == amt_expected);
+
+  // Tag equality against a single game
+  PGN_Filter white_filter;
+  white_filter.add_tag_equals("White", test_games[0].get_tag_pairs()["White"]);
+  white_filter.add_tag_equals("Round", test_games[0].get_tag_pairs()["Round"]);
+  pgn_reader.set_filter(white_filter);
+  std::vector<PGN_Chess_Game> white_games =
+      pgn_reader.return_games("../data/pgn_multi.pgn");
+  REQUIRE(white_games.size() >= 1);
+  CHECK(white_games[0].get_move_sequence() ==
+        test_games[0].get_move_sequence());
+
+  pgn_reader.clear_filter();
+  CHECK(pgn_reader.return_games("../data/pgn_multi.pgn").size() ==
+        test_games.size());
+
+  SECTION("Every condition needs its own tag pair, duplicate keys keep the "
+          "first value") {
+    std::string tags = "[White \"Carlsen\"]\n[White \"Caruana\"]\n"
+                       "[WhiteElo \"2850\"]\n[WhiteElo \"1500\"]\n";
+
+    PGN_Filter pair_filter;
+    pair_filter.add_tag_equals("White", "Carlsen");
+    pair_filter.add_tag_equals("Black", "Caruana");
+    CHECK(!pair_filter.matches(tags));
+
+    PGN_Filter second_filter;
+    second_filter.add_tag_equals("White", "Caruana");
+    CHECK(!second_filter.matches(tags));
+
+    PGN_Filter same_filter;
+    same_filter.add_tag_equals("White", "Carlsen");
+    same_filter.add_tag_equals("White", "Carlsen");
+    CHECK(same_filter.matches(tags));
+
+    PGN_Filter elo_filter;
+    elo_filter.set_white_elo_range(2800, 4000);
+    CHECK(elo_filter.matches(tags));
+
+    PGN_Filter many_filter;
+    std::string many_tags;
+    for (int i = 0; i < 100; i++) {
+      std::string key = "Key" + std::to_string(i);
+      many_filter.add_tag_equals(key, std::to_string(i));
+      many_tags += "[" + key + " \"" + std::to_string(i) + "\"]\n";
+    }
+    CHECK(many_filter.matches(many_tags));
+    many_filter.add_tag_equals("Key99", "98");
+    CHECK(!many_filter.matches(many_tags));
+  }
+
+  SECTION("Unknown parts of the upper date bound include the whole period, "
+          "malformed ranges are rejected") {
+    PGN_Filter date_filter;
+    REQUIRE(date_filter.set_date_range("2020.??.??", "2020.??.??"));
+    CHECK(date_filter.matches("[Date \"2020.??.??\"]\n"));
+    CHECK(date_filter.matches("[Date \"2020.06.15\"]\n"));
+    CHECK(date_filter.matches("[Date \"2020.12.31\"]\n"));
+    CHECK(!date_filter.matches("[Date \"2021.01.01\"]\n"));
+    CHECK(!date_filter.matches("[Date \"2019.12.31\"]\n"));
+
+    REQUIRE(date_filter.set_date_range("2020.03.??", "2020.05.??"));
+    CHECK(date_filter.matches("[Date \"2020.05.31\"]\n"));
+    CHECK(!date_filter.matches("[Date \"2020.06.01\"]\n"));
+
+    CHECK(date_filter.set_date_range("2020-01-01", "2020.12.31") == 0);
+    CHECK(date_filter.set_date_range("2020.01.01", "????.12.31") == 0);
+    CHECK(date_filter.matches("[Date \"2020.05.31\"]\n"));
+
+    PGN_Filter empty_filter;
+    CHECK(empty_filter.set_date_range("", "") == 0);
+    CHECK(empty_filter.is_empty());
+  }
+}
+
+TEST_CASE("Intern tag pairs in a shared string pool", "[pgn][tags]") {
+  String_Pool pool;
+  uint32_t event_id = pool.intern("Event");
+  uint32_t id;
+  CHECK(pool.intern(std::string("Event")) == event_id);
+  CHECK(pool.intern("Site") != event_id);
+  CHECK(pool.lookup(event_id) == "Event");
+  CHECK(pool.find("Site", id) == 1);
+  CHECK(pool.find("Round", id) == 0);
+  CHECK(pool.size() == 2);
+
+  PGN_Reader pgn_reader = PGN_Reader();
+  std::vector<PGN_Chess_Game> test_games =
+      pgn_reader.return_games("../data/pgn_multi.pgn", 4);
+  REQUIRE(test_games.size() == 2671);
+
+  // All games share a single pool holding every distinct string once
+  std::shared_ptr<String_Pool> tag_pool = test_games[0].get_tag_pool();
+  size_t amt_tag_strings = 0;
+  int amt_shared_pools = 0;
+  for (auto &game : test_games) {
+    amt_shared_pools += game.get_tag_pool() == tag_pool;
+    amt_tag_strings += 2 * game.get_tag_pairs().size();
+  }
+  CHECK(amt_shared_pools == 2671);
+  CHECK(tag_pool->size() * 5 < amt_tag_strings);
+
+  std::string_view value;
+  CHECK(test_games[0].get_tag("ECO", value) == 1);
+  CHECK(value == "B28");
+  CHECK(test_games[0].get_tag("Annotator", value) == 0);
+
+  // Duplicate keys keep their first value
+  PGN_Chess_Game game(tag_pool);
+  CHECK(game.add_tag_pair("Event", "First") == 1);
+  CHECK(game.add_tag_pair("Event", "Second") == 0);
+  CHECK(game.get_tag_pairs() ==
+        std::map<std::string, std::string>{{"Event", "First"}});
+
+  // Every read starts a new pool, streaming a file again does not grow it
+  std::vector<size_t> pool_sizes;
+  std::shared_ptr<String_Pool> first_pool;
+  for (int pass = 0; pass < 2; pass++) {
+    REQUIRE(pgn_reader.open("../data/pgn_multi.pgn"));
+    PGN_Chess_Game streamed_game;
+    while (pgn_reader.next_game(streamed_game))
+      ;
+    pool_sizes.push_back(streamed_game.get_tag_pool()->size());
+    if (pass == 0)
+      first_pool = streamed_game.get_tag_pool();
+    else
+      CHECK(streamed_game.get_tag_pool() != first_pool);
+  }
+  CHECK(pool_sizes[0] == pool_sizes[1]);
+  CHECK(test_games[0].get_tag("ECO", value) == 1);
+  CHECK(value == "B28");
+}
+
+TEST_CASE("Parse Elo, Date, Result and ECO tags into typed fields",
+          "[pgn][tags]") {
+  PGN_Chess_Game game({{"WhiteElo", "2512"},
+                       {"BlackElo", ""},
+                       {"Date", "2014.03.??"},
+                       {"Result", "1/2-1/2"},
+                       {"ECO", "C20"}});
+  CHECK(game.get_white_elo() == 2512);
+  CHECK(game.get_black_elo() == -1);
+  CHECK(game.get_date() == 20140300);
+  CHECK(game.get_result() == RESULT_DRAW);
+  CHECK(game.get_eco() == 220);
+
+  PGN_Chess_Game copy = game;
+  CHECK(copy.get_typed_tags().white_elo == 2512);
+  game.clear();
+  CHECK(game.get_white_elo() == -1);
+  CHECK(game.get_result() == RESULT_UNKNOWN);
+  CHECK(game.get_eco() == -1);
+
+  // The typed fields agree with the tag strings of every parsed game
+  PGN_Reader pgn_reader = PGN_Reader();
+  std::vector<PGN_Chess_Game> test_games =
+      pgn_reader.return_games("../data/pgn_multi.pgn");
+  int amt_matching_games = 0;
+  for (const PGN_Chess_Game &test_game : test_games) {
+    std::string_view white_elo, date, result, eco;
+    test_game.get_tag("WhiteElo", white_elo);
+    test_game.get_tag("Date", date);
+    test_game.get_tag("Result", result);
+    test_game.get_tag("ECO", eco);
+    if (test_game.get_white_elo() == PGN_Filter::parse_elo(white_elo) &&
+        test_game.get_date() == PGN_Filter::parse_date(date) &&
+        test_game.get_result() == PGN_Filter::parse_result(result) &&
+        test_game.get_eco() == PGN_Filter::parse_eco(eco) &&
+        test_game.get_result() != RESULT_UNKNOWN)
+      amt_matching_games++;
+  }
+  CHECK(amt_matching_games == 2671);
+}
+
+TEST_CASE("Parse games into a per-read arena", "[pgn][arena]") {
+  // Each mode gets a fresh reader, so neither measurement profits from
+  // buffers the other one already grew
+  PGN_Reader heap_reader = PGN_Reader();
+  size_t amt_allocations = HPCE_Test_Driver::get_amt_allocations();
+  std::vector<PGN_Chess_Game> test_games =
+      heap_reader.return_games("../data/pgn_multi.pgn");
+  size_t heap_allocations =
+      HPCE_Test_Driver::get_amt_allocations() - amt_allocations;
+
+  PGN_Reader pgn_reader = PGN_Reader();
+  pgn_reader.set_arena_mode(1);
+  amt_allocations = HPCE_Test_Driver::get_amt_allocations();
+  std::vector<PGN_Chess_Game> arena_games =
+      pgn_reader.return_games("../data/pgn_multi.pgn");
+  size_t arena_allocations =
+      HPCE_Test_Driver::get_amt_allocations() - amt_allocations;
+
+  CHECK(arena_allocations * 2 < heap_allocations);
+  REQUIRE(arena_games.size() == test_games.size());
+  int amt_equal_games = 0;
+  for (size_t i = 0; i < test_games.size(); i++) {
+    if (arena_games[i].get_tag_pairs() == test_games[i].get_tag_pairs() &&
+        arena_games[i].get_move_sequence() ==
+            test_games[i].get_move_sequence())
+      amt_equal_games++;
+  }
+  CHECK(amt_equal_games == 2671);
+
+  // Games keep their arena alive after the batch is dropped
+  PGN_Chess_Game last_game = std::move(arena_games.back());
+  PGN_Chess_Game copied_game = arena_games[0];
+  arena_games = pgn_reader.return_games("../data/pgn_multi.pgn", 3);
+  CHECK(arena_games.size() == test_games.size());
+  arena_games.clear();
+  CHECK(last_game.get_move_sequence() == test_games.back().get_move_sequence());
+  CHECK(copied_game.get_move_sequence() == test_games[0].get_move_sequence());
+  copied_game = last_game;
+  CHECK(copied_game.get_tag_pairs() == test_games.back().get_tag_pairs());
+
+  // Notations and annotation texts share the arena of their game
+  auto arena = std::make_shared<std::pmr::monotonic_buffer_resource>();
+  PGN_Chess_Game annotated_game(arena);
+  annotated_game.add_move({1, 0, "e4"});
+  annotated_game.add_annotation(
+      {1, ANNOTATION_COMMENT, "a comment longer than the inline buffer"});
+  const Move &move = annotated_game.get_move_sequence_view()[0];
+  const Annotation &annotation = annotated_game.get_annotations_view()[0];
+  CHECK(move.move_notation.get_allocator().resource() == arena.get());
+  CHECK(annotated_game.get_annotations_view().get_allocator().resource() ==
+        arena.get());
+  CHECK(annotation.text.get_allocator().resource() == arena.get());
+  CHECK(annotated_game.get_annotations()[0] == annotation);
+}
+
+TEST_CASE("Access moves and tag pairs without copies", "[pgn][views]") {
+  PGN_Reader pgn_reader = PGN_Reader();
+  std::vector<PGN_Chess_Game> test_games =
+      pgn_reader.return_games("../data/pgn_multi.pgn");
+  REQUIRE(test_games.size() == 2671);
+
+  size_t amt_allocations = HPCE_Test_Driver::get_amt_allocations();
+  size_t amt_copied_bytes = 0;
+  for (PGN_Chess_Game &game : test_games) {
+    for (Move move : game.get_move_sequence())
+      amt_copied_bytes += move.move_notation.size();
+    amt_copied_bytes += game.get_tag_pairs().size();
+  }
+  size_t copy_allocations =
+      HPCE_Test_Driver::get_amt_allocations() - amt_allocations;
+
+  // Only the vector of tag pair views is allocated, once per game
+  amt_allocations = HPCE_Test_Driver::get_amt_allocations();
+  size_t amt_viewed_bytes = 0;
+  for (PGN_Chess_Game &game : test_games) {
+    for (const Move &move : game.get_move_sequence_view())
+      amt_viewed_bytes += move.move_notation.size();
+    amt_viewed_bytes += game.get_tag_pairs_view().size();
+  }
+  size_t view_allocations =
+      HPCE_Test_Driver::get_amt_allocations() - amt_allocations;
+
+  CHECK(amt_viewed_bytes == amt_copied_bytes);
+  CHECK(view_allocations == test_games.size());
+  CHECK(view_allocations * 10 < copy_allocations);
+
+  std::string_view value;
+  std::vector<std::pair<std::string_view, std::string_view>> tag_pairs =
+      test_games[0].get_tag_pairs_view();
+  REQUIRE(test_games[0].get_tag(tag_pairs[0].first, value));
+  CHECK(value == tag_pairs[0].second);
+
+  // Moves passed as rvalues keep their notation buffer
+  PGN_Chess_Game game;
+  Move move{1, 0, "Nf3-with-a-long-notation"};
+  const char *notation = move.move_notation.data();
+  game.add_move(std::move(move));
+  CHECK(game.get_move_sequence_view().back().move_notation.data() == notation);
+  CHECK(std::is_nothrow_move_constructible<PGN_Chess_Game>::value);
+}
+
+TEST_CASE("Compare heap and arena parse time", "[.][benchmark]") {
+  PGN_Reader pgn_reader = PGN_Reader();
+
+  for (int arena_mode : {0, 1}) {
+    pgn_reader.set_arena_mode(arena_mode);
+    size_t amt_allocations = HPCE_Test_Driver::get_amt_allocations();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 10; i++)
+      pgn_reader.return_games("../data/pgn_multi.pgn");
+    std::chrono::duration<double> time =
+        std::chrono::steady_clock::now() - start;
+
+    std::cout << (arena_mode ? "arena: " : "heap: ")
+              << (HPCE_Test_Driver::get_amt_allocations() - amt_allocations) / 10
+              << " allocations, " << time.count() * 100 << " ms per read\n";
+  }
+}
+
+TEST_CASE("Tokenize movetext lazily on first access", "[pgn][lazy]") {
+  PGN_Reader pgn_reader = PGN_Reader();
+  std::vector<PGN_Chess_Game> test_games =
+      pgn_reader.return_games("../data/pgn_multi.pgn");
+
+  pgn_reader.set_lazy_movetext(1);
+  std::vector<PGN_Chess_Game> lazy_games =
+      pgn_reader.return_games("../data/pgn_multi.pgn", 3);
+  REQUIRE(lazy_games.size() == test_games.size());
+  CHECK(lazy_games[0].is_tokenized() == 0);
+  CHECK(lazy_games[0].get_tag_pairs() == test_games[0].get_tag_pairs());
+  CHECK(lazy_games[0].get_raw_movetext().substr(0, 3) == "1.e");
+
+  int amt_equal_games = 0;
+  for (size_t i = 0; i < test_games.size(); i++) {
+    if (lazy_games[i].get_move_sequence() == test_games[i].get_move_sequence())
+      amt_equal_games++;
+  }
+  CHECK(amt_equal_games == 2671);
+  CHECK(lazy_games[0].is_tokenized() == 1);
+
+  // The file mapping outlives the cursor that read the game
+  PGN_Chess_Game game;
+  REQUIRE(pgn_reader.open("../data/pgn_multi.pgn"));
+  REQUIRE(pgn_reader.next_game(game));
+  pgn_reader.close();
+  PGN_Chess_Game copied_game = game;
+  CHECK(copied_game.get_move_sequence() == test_games[0].get_move_sequence());
+  CHECK(game.is_tokenized() == 0);
+
+  // Adding moves to a lazy game appends to its tokenized movetext
+  game.add_move({100, 0, "e4"});
+  CHECK(game.get_amt_moves() == test_games[0].get_move_sequence().size() + 1);
+}
+
+TEST_CASE("Tokenize movetext with the single-pass lexer", "[pgn][lexer]") {
+  PGN_Chess_Game game;
+
+  // Pairs may wrap across lines, "N..." continues with black's move
+  PGN_Lexer::tokenize_movetext("1.e4 c5 2. Nf3\n d6 3.d4 3... cxd4 4.Nxd4 1-0",
+                               game);
+
+  std::vector<Move> move_sequence = {
+      {1, 0, "e4"}, {1, 1, "c5"},   {2, 0, "Nf3"},  {2, 1, "d6"},
+      {3, 0, "d4"}, {3, 1, "cxd4"}, {4, 0, "Nxd4"}, {4, 1, "1-0"}};
+  CHECK(game.get_move_sequence() == move_sequence);
+
+  game.clear();
+  PGN_Lexer::tokenize_movetext("1.d4 Nf6 2.c4", game);
+  std::vector<Move> open_sequence = {
+      {1, 0, "d4"}, {1, 1, "Nf6"}, {2, 0, "c4"}, {2, 1, ""}};
+  CHECK(game.get_move_sequence() == open_sequence);
+}
+
+TEST_CASE("Classify movetext blocks with the dispatched scanner",
+          "[pgn][lexer]") {
+  INFO("Classifier: " << PGN_Scanner::get_isa());
+
+  // Every byte value at every lane position
+  char block[SCAN_BLOCK_SIZE];
+  Scan_Masks masks, scalar_masks;
+  for (int value = 0; value < 256; value += SCAN_BLOCK_SIZE) {
+    for (int i = 0; i < SCAN_BLOCK_SIZE; i++)
+      block[i] = static_cast<char>(value + i);
+    for (int shift = 0; shift < 4; shift++) {
+      std::rotate(block, block + 1, block + SCAN_BLOCK_SIZE);
+      PGN_Scanner::classify(block, masks);
+      PGN_Scanner::classify_scalar(block, scalar_masks);
+      CHECK(masks.whitespace == scalar_masks.whitespace);
+      CHECK(masks.annotation == scalar_masks.annotation);
+    }
+  }
+
+  // Tokens and whitespace runs crossing block boundaries, a token ending at
+  // the end of the movetext
+  std::string movetext = "1." + std::string(64, ' ') + "Nf3{c}" +
+                         std::string(60, '\t') + "d5 2.c4";
+  PGN_Chess_Game game;
+  PGN_Lexer::tokenize_movetext(movetext, game);
+  std::vector<Move> move_sequence = {
+      {1, 0, "Nf3"}, {1, 1, "d5"}, {2, 0, "c4"}, {2, 1, ""}};
+  CHECK(game.get_move_sequence() == move_sequence);
+
+  game.clear();
+  PGN_Lexer::tokenize_movetext(std::string_view(movetext).substr(0, 68), game);
+  move_sequence = {{1, 0, "Nf"}, {1, 1, ""}};
+  CHECK(game.get_move_sequence() == move_sequence);
+}
+
+TEST_CASE("Skip comments, variations and NAGs in movetext", "[pgn][lexer]") {
+  std::string movetext =
+      "1. e4 {Best by test} 1... c5 $1 2. Nf3 (2. c3 {Alapin} d5 (2... Nf6)\n"
+      "3. exd5) 2... d6; main line\n"
+      "%escaped line\n"
+      "3. d4{ [%eval 0.3] }cxd4 $14 4. Nxd4 1-0";
+  std::vector<Move> main_line = {
+      {1, 0, "e4"}, {1, 1, "c5"},   {2, 0, "Nf3"},  {2, 1, "d6"},
+      {3, 0, "d4"}, {3, 1, "cxd4"}, {4, 0, "Nxd4"}, {4, 1, "1-0"}};
+
+  PGN_Chess_Game game;
+  PGN_Lexer::tokenize_movetext(movetext, game);
+  CHECK(game.get_move_sequence() == main_line);
+  CHECK(game.get_annotations().empty());
+
+  game.clear();
+  PGN_Lexer::tokenize_movetext(movetext, game, 1);
+  CHECK(game.get_move_sequence() == main_line);
+  std::vector<Annotation> annotations = {
+      {1, ANNOTATION_COMMENT, "Best by test"},
+      {2, ANNOTATION_NAG, "1"},
+      {3, ANNOTATION_VARIATION, "2. c3 {Alapin} d5 (2... Nf6)\n3. exd5"},
+      {4, ANNOTATION_COMMENT, "main line"},
+      {5, ANNOTATION_COMMENT, "[%eval 0.3]"},
+      {6, ANNOTATION_NAG, "14"}};
+  CHECK(game.get_annotations() == annotations);
+
+  // Unterminated comments and variations end the movetext
+  game.clear();
+  PGN_Lexer::tokenize_movetext("1. d4 ) d5 2. c4 (2. Nf3 {open", game);
+  std::vector<Move> open_sequence = {
+      {1, 0, "d4"}, {1, 1, "d5"}, {2, 0, "c4"}, {2, 1, ""}};
+  CHECK(game.get_move_sequence() == open_sequence);
+}
+
+TEST_CASE("Compare movetext lexer and regex throughput", "[.][benchmark]") {
+  PGN_Source source;
+  PGN_Diagnostics diagnostics;
+  PGN_Game_Span span;
+  std::vector<std::string> movetexts;
+  size_t amt_bytes = 0;
+
+  REQUIRE(source.open("../data/pgn_multi.pgn", diagnostics));
+  while (source.next_span(span)) {
+    movetexts.emplace_back(span.movetext);
+    amt_bytes += span.movetext.size();
+  }
+
+  // Reference: the per-line regex tokenizer the lexer replaced
+  const std::regex move_regex(R"((\d+)\.\s*([^\s]+)(?:\s+([^\s]+))?)");
+  size_t regex_moves = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (const std::string &movetext : movetexts) {
+    PGN_Chess_Game game;
+    std::istringstream lines(movetext);
+    std::string line;
+    while (std::getline(lines, line)) {
+      std::sregex_iterator it(line.begin(), line.end(), move_regex), end;
+      for (; it != end; ++it) {
+        game.add_move({std::stoi((*it)[1]), 0, (*it)[2].str()});
+        game.add_move({std::stoi((*it)[1]), 1, (*it)[3].str()});
+      }
+    }
+    regex_moves += game.get_move_sequence().size();
+  }
+  std::chrono::duration<double> regex_time =
+      std::chrono::steady_clock::now() - start;
+
+  size_t lexer_moves = 0;
+  start = std::chrono::steady_clock::now();
+  for (const std::string &movetext : movetexts) {
+    PGN_Chess_Game game;
+    PGN_Lexer::tokenize_movetext(movetext, game);
+    lexer_moves += game.get_move_sequence().size();
+  }
+  std::chrono::duration<double> lexer_time =
+      std::chrono::steady_clock::now() - start;
+
+  std::cout << "regex: " << amt_bytes / regex_time.count() / 1e6 << " MB/s, "
+            << "lexer: " << amt_bytes / lexer_time.count() / 1e6 << " MB/s\n";
+  CHECK(lexer_moves == regex_moves);
+}
+
+TEST_CASE("Read compressed PGN files", "[pgn][compressed]") {
+  PGN_Reader pgn_reader = PGN_Reader();
+
+  std::vector<PGN_Chess_Game> test_games =
+      pgn_reader.return_games("../data/pgn_multi.pgn");
+
+  std::ifstream if_reader("../data/pgn_multi.pgn", std::ios::binary);
+  std::string pgn((std::istreambuf_iterator<char>(if_reader)),
+                  std::istreambuf_iterator<char>());
+  std::vector<std::string> compressed_files;
+
+#ifdef HPCE_HAVE_ZLIB
+  // Written as two gzip members, as produced by parallel compressors
+  std::string gz_path =
+      (std::filesystem::temp_directory_path() / "hpce_pgn_multi.pgn.gz")
+          .string();
+  for (int member = 0; member < 2; member++) {
+    gzFile gz_writer = gzopen(gz_path.c_str(), member == 0 ? "wb" : "ab");
+    size_t half = pgn.size() / 2;
+    size_t offset = member == 0 ? 0 : half;
+    size_t length = member == 0 ? half : pgn.size() - half;
+    gzwrite(gz_writer, pgn.data() + offset, static_cast<unsigned>(length));
+    gzclose(gz_writer);
+  }
+  compressed_files.push_back(gz_path);
+#endif
+
+#ifdef HPCE_HAVE_ZSTD
+  std::string zst_path =
+      (std::filesystem::temp_directory_path() / "hpce_pgn_multi.pgn.zst")
+          .string();
+  std::string zst(ZSTD_compressBound(pgn.size()), '\0');
+  zst.resize(ZSTD_compress(zst.data(), zst.size(), pgn.data(), pgn.size(), 3));
+  std::ofstream(zst_path, std::ios::binary) << zst;
+  compressed_files.push_back(zst_path);
+#endif
+
+  for (const std::string &path : compressed_files) {
+    std::vector<PGN_Chess_Game> compressed_games =
+        pgn_reader.return_games(path, 4);
+
+    REQUIRE(compressed_games.size() == test_games.size());
+    int amt_equal_games = 0;
+    for (size_t i = 0; i < test_games.size(); i++) {
+      if (compressed_games[i].get_tag_pairs() ==
+              test_games[i].get_tag_pairs() &&
+          compressed_games[i].get_move_sequence() ==
+              test_games[i].get_move_sequence())
+        amt_equal_games++;
+    }
+    CHECK(amt_equal_games == 2671);
+    CHECK(pgn_reader.get_diagnostics().get_count(DIAGNOSTIC_TRUNCATED_INPUT) ==
+          0);
+
+    // A truncated file keeps the games before the cut and is reported,
+    // instead of ending like an intact file
+    std::ifstream compressed_reader(path, std::ios::binary);
+    std::string compressed((std::istreambuf_iterator<char>(compressed_reader)),
+                           std::istreambuf_iterator<char>());
+    std::string truncated_path = path + ".truncated";
+    std::ofstream(truncated_path, std::ios::binary)
+        << compressed.substr(0, compressed.size() / 2);
+
+    std::vector<PGN_Chess_Game> truncated_games =
+        pgn_reader.return_games(truncated_path);
+    CHECK(truncated_games.size() > 0);
+    CHECK(truncated_games.size() < test_games.size());
+    const PGN_Diagnostics &diagnostics = pgn_reader.get_diagnostics();
+    REQUIRE(diagnostics.get_count(DIAGNOSTIC_TRUNCATED_INPUT) == 1);
+    for (const Diagnostic &diagnostic : diagnostics.get_samples()) {
+      if (diagnostic.category == DIAGNOSTIC_TRUNCATED_INPUT) {
+        CHECK(diagnostic.offset < pgn.size());
+        CHECK(diagnostic.game_nr >= truncated_games.size());
+      }
+    }
+
+    PGN_Chess_Game game;
+    size_t amt_streamed = 0;
+    REQUIRE(pgn_reader.open(truncated_path));
+    while (pgn_reader.next_game(game))
+      amt_streamed++;
+    CHECK(amt_streamed == truncated_games.size());
+    CHECK(pgn_reader.get_diagnostics().get_count(DIAGNOSTIC_TRUNCATED_INPUT) ==
+          1);
+
+    std::remove(truncated_path.c_str());
+    std::remove(path.c_str());
+  }
+
+#ifndef HPCE_HAVE_ZSTD
+  // A compression that is not built in is reported as a diagnostic, which
+  // only reaches std::cerr as part of the summary of each read
+  std::string zst_path =
+      (std::filesystem::temp_directory_path() / "hpce_unsupported.pgn.zst")
+          .string();
+  std::ofstream(zst_path, std::ios::binary) << "\x28\xb5\x2f\xfd" << pgn;
+  std::stringstream error_output;
+  std::streambuf *old_cerr = std::cerr.rdbuf(error_output.rdbuf());
+  CHECK(pgn_reader.return_games(zst_path).empty());
+  CHECK(pgn_reader.open(zst_path) == 0);
+  std::cerr.rdbuf(old_cerr);
+  PGN_Diagnostics diagnostics = pgn_reader.get_diagnostics();
+  CHECK(diagnostics.get_count(DIAGNOSTIC_UNSUPPORTED_INPUT) == 1);
+  CHECK(error_output.str() == diagnostics.summary() + diagnostics.summary());
+  std::remove(zst_path.c_str());
+#endif
+}
+
+TEST_CASE("Shard PGN files balanced by plies", "[pgn][sharder]") {
+  PGN_Reader pgn_reader = PGN_Reader();
+  std::vector<PGN_Chess_Game> test_games =
+      pgn_reader.return_games("../data/pgn_multi.pgn");
+  std::vector<PGN_Chess_Game> single_games =
+      pgn_reader.return_games("../data/pgn_single.pgn");
+  test_games.insert(test_games.end(), single_games.begin(), single_games.end());
+  uint64_t amt_plies = 0;
+  uint64_t max_game_plies = 0;
+  for (PGN_Chess_Game &game : test_games) {
+    amt_plies += game.get_amt_plies();
+    max_game_plies = std::max<uint64_t>(max_game_plies, game.get_amt_plies());
+  }
+
+  std::string prefix =
+      (std::filesystem::temp_directory_path() / "hpce_shard").string();
+  PGN_Sharder pgn_sharder;
+  pgn_sharder.add_input("../data/pgn_multi.pgn");
+  pgn_sharder.add_input("../data/pgn_single.pgn");
+  REQUIRE(pgn_sharder.shard(prefix, 3));
+
+  const std::vector<PGN_Shard> &shards = pgn_sharder.get_shards();
+  REQUIRE(shards.size() == 3);
+  uint64_t amt_shard_games = 0;
+  uint64_t amt_shard_plies = 0;
+  uint64_t min_plies = UINT64_MAX;
+  uint64_t max_plies = 0;
+  for (const PGN_Shard &shard : shards) {
+    std::vector<PGN_Chess_Game> shard_games =
+        pgn_reader.return_games(shard.file_path);
+    CHECK(shard_games.size() == shard.amt_games);
+    uint64_t amt_read_plies = 0;
+    for (PGN_Chess_Game &game : shard_games)
+      amt_read_plies += game.get_amt_plies();
+    CHECK(amt_read_plies == shard.amt_plies);
+
+    uint64_t checksum;
+    REQUIRE(PGN_Sharder::checksum_file(shard.file_path, checksum));
+    CHECK(checksum == shard.checksum);
+
+    amt_shard_games += shard.amt_games;
+    amt_shard_plies += shard.amt_plies;
+    min_plies = std::min(min_plies, shard.amt_plies);
+    max_plies = std::max(max_plies, shard.amt_plies);
+    std::remove(shard.file_path.c_str());
+  }
+  CHECK(amt_shard_games == test_games.size());
+  CHECK(amt_shard_plies == amt_plies);
+  CHECK(max_plies - min_plies <= max_game_plies);
+
+  std::ifstream manifest(prefix + ".manifest");
+  std::string line;
+  int amt_lines = 0;
+  while (std::getline(manifest, line))
+    amt_lines++;
+  CHECK(amt_lines == 4);
+  manifest.close();
+  std::remove((prefix + ".manifest").c_str());
+
+  // Failures are only signalled by the return values
+  std::stringstream error_output;
+  std::streambuf *old_cerr = std::cerr.rdbuf(error_output.rdbuf());
+  uint64_t checksum;
+  CHECK(pgn_sharder.shard(prefix, 0) == 0);
+  CHECK(PGN_Sharder::checksum_file(prefix + ".missing", checksum) == 0);
+  CHECK(pgn_sharder.shard("/nonexistent_hpce_dir/shard", 2) == 0);
+  std::cerr.rdbuf(old_cerr);
+  CHECK(error_output.str().empty());
+}
+
+TEST_CASE("Drop duplicate games while reading", "[pgn][dedup]") {
+  PGN_Reader pgn_reader = PGN_Reader();
+  pgn_reader.set_print_summary(0);
+  pgn_reader.set_dedup(1);
+  size_t amt_distinct = pgn_reader.return_games("../data/pgn_multi.pgn").size();
+  uint64_t amt_repeated = pgn_reader.get_amt_duplicates();
+  REQUIRE(amt_distinct > 0);
+
+  // A merged database containing every game twice
+  std::ifstream multi_file("../data/pgn_multi.pgn", std::ios::binary);
+  std::string multi((std::istreambuf_iterator<char>(multi_file)),
+                    std::istreambuf_iterator<char>());
+  std::string merged_path =
+      (std::filesystem::temp_directory_path() / "hpce_merged.pgn").string();
+  std::ofstream merged_file(merged_path, std::ios::binary);
+  merged_file << multi << "\n" << multi;
+  merged_file.close();
+
+  SECTION("Sequential, parallel and streaming reads keep one copy") {
+    size_t amt_games = amt_distinct + amt_repeated;
+
+    pgn_reader.set_dedup(1);
+    CHECK(pgn_reader.return_games(merged_path).size() == amt_distinct);
+    CHECK(pgn_reader.get_amt_duplicates() == amt_games + amt_repeated);
+
+    pgn_reader.set_dedup(1);
+    CHECK(pgn_reader.return_games(merged_path, 4).size() == amt_distinct);
+    CHECK(pgn_reader.get_amt_duplicates() == amt_games + amt_repeated);
+
+    pgn_reader.set_dedup(1);
+    PGN_Chess_Game game;
+    size_t amt_streamed = 0;
+    REQUIRE(pgn_reader.open(merged_path));
+    while (pgn_reader.next_game(game))
+      amt_streamed++;
+    CHECK(amt_streamed == amt_distinct);
+  }
+
+  SECTION("Parallel reads keep the same copy as sequential reads") {
+    // The second copy of every game has another Event, the first one is kept
+    std::string copy = multi;
+    for (size_t pos = copy.find("[Event \""); pos != std::string::npos;
+         pos = copy.find("[Event \"", pos + 1))
+      copy.insert(pos + 8, "Copy ");
+    std::string split_path =
+        (std::filesystem::temp_directory_path() / "hpce_split.pgn").string();
+    std::ofstream split_file(split_path, std::ios::binary);
+    split_file << multi << "\n" << copy;
+    split_file.close();
+
+    pgn_reader.set_dedup(1);
+    std::vector<PGN_Chess_Game> sequential_games =
+        pgn_reader.return_games(split_path);
+    std::vector<Diagnostic> sequential_samples =
+        pgn_reader.get_diagnostics().get_samples();
+    pgn_reader.set_dedup(1);
+    std::vector<PGN_Chess_Game> parallel_games =
+        pgn_reader.return_games(split_path, 4);
+    std::vector<Diagnostic> parallel_samples =
+        pgn_reader.get_diagnostics().get_samples();
+    std::remove(split_path.c_str());
+
+    REQUIRE(parallel_games.size() == sequential_games.size());
+    CHECK(parallel_games.size() == amt_distinct);
+    int amt_equal_games = 0, amt_copies = 0;
+    for (size_t i = 0; i < parallel_games.size(); i++) {
+      std::string_view event;
+      parallel_games[i].get_tag("Event", event);
+      amt_copies += event.substr(0, 5) == "Copy ";
+      amt_equal_games += parallel_games[i].get_tag_pairs() ==
+                             sequential_games[i].get_tag_pairs() &&
+                         parallel_games[i].get_move_sequence() ==
+                             sequential_games[i].get_move_sequence();
+    }
+    CHECK(amt_equal_games == static_cast<int>(amt_distinct));
+    CHECK(amt_copies == 0);
+
+    auto duplicate_game_nrs = [](const std::vector<Diagnostic> &samples) {
+      std::vector<uint64_t> game_nrs;
+      for (const Diagnostic &diagnostic : samples)
+        if (diagnostic.category == DIAGNOSTIC_DUPLICATE_GAME)
+          game_nrs.push_back(diagnostic.game_nr);
+      return game_nrs;
+    };
+    CHECK(duplicate_game_nrs(parallel_samples) ==
+          duplicate_game_nrs(sequential_samples));
+  }
+
+  SECTION("Readers on several threads share one set") {
+    auto dedup_set = std::make_shared<Game_Dedup_Set>();
+    std::vector<size_t> amt_read(4);
+    std::vector<std::thread> readers;
+    for (size_t i = 0; i < amt_read.size(); i++) {
+      readers.emplace_back([&, i]() {
+        PGN_Reader thread_reader;
+        thread_reader.set_print_summary(0);
+        thread_reader.set_dedup_set(dedup_set);
+        amt_read[i] = thread_reader.return_games(merged_path).size();
+      });
+    }
+    for (std::thread &reader : readers)
+      reader.join();
+
+    size_t amt_kept = 0;
+    for (size_t amt : amt_read)
+      amt_kept += amt;
+    CHECK(amt_kept == amt_distinct);
+    CHECK(dedup_set->size() == amt_distinct);
+  }
+
+  SECTION("Key tags tell games with equal moves apart") {
+    pgn_reader.set_dedup(1, 1);
+    size_t amt_tag_distinct = pgn_reader.return_games(merged_path).size();
+    CHECK(amt_tag_distinct >= amt_distinct);
+    CHECK(amt_tag_distinct <= amt_distinct + amt_repeated);
+  }
+
+  pgn_reader.set_dedup(0);
+  CHECK(pgn_reader.return_games(merged_path).size() ==
+        2 * (amt_distinct + amt_repeated));
+  std::remove(merged_path.c_str());
+}
+
+TEST_CASE("Read PGN files ahead of the parser", "[pgn][read_ahead]") {
+  PGN_Reader pgn_reader = PGN_Reader();
+  std::vector<PGN_Chess_Game> test_games =
+      pgn_reader.return_games("../data/pgn_multi.pgn");
+
+  // Chunks of small buffers concatenate to the file contents
+  std::ifstream if_reader("../data/pgn_multi.pgn", std::ios::binary);
+  std::string pgn((std::istreambuf_iterator<char>(if_reader)),
+                  std::istreambuf_iterator<char>());
+  PGN_Read_Ahead read_ahead(3, 4096);
+  REQUIRE(read_ahead.start("../data/pgn_multi.pgn"));
+  std::string contents;
+  std::string_view chunk;
+  while (read_ahead.next_chunk(chunk))
+    contents.append(chunk);
+  CHECK(contents == pgn);
+  CHECK(read_ahead.has_error() == 0);
+  CHECK(read_ahead.start("../data/missing.pgn") == 0);
+
+  // A file truncated while it is read ends with an error instead of a clean
+  // end of file, without writing to std::cerr
+  std::string truncated_path =
+      (std::filesystem::temp_directory_path() / "hpce_read_ahead.pgn")
+          .string();
+  std::ofstream(truncated_path, std::ios::binary) << pgn;
+  std::stringstream error_output;
+  std::streambuf *old_cerr = std::cerr.rdbuf(error_output.rdbuf());
+  REQUIRE(read_ahead.start(truncated_path));
+  std::filesystem::resize_file(truncated_path, pgn.size() / 2);
+  contents.clear();
+  while (read_ahead.next_chunk(chunk))
+    contents.append(chunk);
+  std::cerr.rdbuf(old_cerr);
+  CHECK(contents.size() < pgn.size());
+  CHECK(read_ahead.has_error() == 1);
+  CHECK(error_output.str().empty());
+  read_ahead.stop();
+  std::remove(truncated_path.c_str());
+
+  pgn_reader.set_read_ahead(3);
+  pgn_reader.set_lazy_movetext(1);
+  std::vector<PGN_Chess_Game> read_ahead_games =
+      pgn_reader.return_games("../data/pgn_multi.pgn");
+  REQUIRE(read_ahead_games.size() == test_games.size());
+  int amt_equal_games = 0;
+  for (size_t i = 0; i < test_games.size(); i++) {
+    if (read_ahead_games[i].get_tag_pairs() == test_games[i].get_tag_pairs() &&
+        read_ahead_games[i].get_move_sequence() ==
+            test_games[i].get_move_sequence())
+      amt_equal_games++;
+  }
+  CHECK(amt_equal_games == 2671);
+
+  PGN_Chess_Game game;
+  REQUIRE(pgn_reader.open("../data/pgn_multi.pgn"));
+  size_t amt_games = 0;
+  while (pgn_reader.next_game(game))
+    amt_games++;
+  CHECK(amt_games == test_games.size());
+  CHECK(game.get_move_sequence() == test_games.back().get_move_sequence());
+}
+
+TEST_CASE("Write games back to PGN", "[pgn][writer]") {
+  PGN_Reader pgn_reader = PGN_Reader();
+  std::vector<PGN_Chess_Game> test_games =
+      pgn_reader.return_games("../data/pgn_multi.pgn");
+
+  // Export format with escaped tag values and a termination marker
+  PGN_Chess_Game game;
+  game.add_tag_pair("Event", "The \"Open\"");
+  game.add_tag_pair("ECO", "C20");
+  game.add_tag_pair("Result", "1-0");
+  std::string movetext = "1.e4 {King's pawn} e5 2.Nf3";
+  PGN_Lexer::tokenize_movetext(movetext, game, 1);
+  std::string pgn;
+  PGN_Writer formatter;
+  formatter.format_game(game, pgn);
+  CHECK(pgn == "[Event \"The \\\"Open\\\"\"]\n[Site \"?\"]\n"
+               "[Date \"????.??.??\"]\n[Round \"?\"]\n[White \"?\"]\n"
+               "[Black \"?\"]\n[Result \"1-0\"]\n[ECO \"C20\"]\n\n"
+               "1. e4 {King's pawn} 1... e5 2. Nf3 1-0\n\n");
+
+  // Games without any tag pairs still get the complete roster
+  PGN_Chess_Game untagged_game;
+  movetext = "1.d4 {Queen's\npawn} d5";
+  PGN_Lexer::tokenize_movetext(movetext, untagged_game, 1);
+  REQUIRE(untagged_game.get_tag_pool() == nullptr);
+  pgn.clear();
+  formatter.format_game(untagged_game, pgn);
+  CHECK(pgn == "[Event \"?\"]\n[Site \"?\"]\n[Date \"????.??.??\"]\n"
+               "[Round \"?\"]\n[White \"?\"]\n[Black \"?\"]\n"
+               "[Result \"*\"]\n\n1. d4 {Queen's\npawn} 1... d5 *\n\n");
+
+  std::vector<std::string> output_files;
+  std::vector<int> compressions = {COMPRESSION_NONE};
+#ifdef HPCE_HAVE_ZLIB
+  compressions.push_back(COMPRESSION_GZIP);
+#endif
+#ifdef HPCE_HAVE_ZSTD
+  compressions.push_back(COMPRESSION_ZSTD);
+#endif
+  for (int compression : compressions) {
+    std::string path = (std::filesystem::temp_directory_path() /
+                        ("hpce_writer_" + std::to_string(compression) + ".pgn"))
+                           .string();
+    PGN_Writer pgn_writer;
+    REQUIRE(pgn_writer.open(path, compression));
+    size_t amt_written = 0;
+    for (PGN_Chess_Game &test_game : test_games)
+      amt_written += pgn_writer.add_game(test_game);
+    CHECK(amt_written == test_games.size());
+    REQUIRE(pgn_writer.close());
+    output_files.push_back(path);
+  }
+
+  // Lazily read games are copied with their original movetext
+  std::string copy_path =
+      (std::filesystem::temp_directory_path() / "hpce_writer_copy.pgn")
+          .string();
+  PGN_Writer pgn_writer;
+  REQUIRE(pgn_writer.open(copy_path));
+  CHECK(pgn_writer.add_pgn("../data/pgn_multi.pgn") == test_games.size());
+  REQUIRE(pgn_writer.close());
+  output_files.push_back(copy_path);
+
+  for (const std::string &path : output_files) {
+    std::vector<PGN_Chess_Game> written_games = pgn_reader.return_games(path);
+    REQUIRE(written_games.size() == test_games.size());
+    int amt_equal_games = 0;
+    for (size_t i = 0; i < test_games.size(); i++) {
+      if (written_games[i].get_tag_pairs() == test_games[i].get_tag_pairs() &&
+          written_games[i].get_move_sequence() ==
+              test_games[i].get_move_sequence())
+        amt_equal_games++;
+    }
+    CHECK(amt_equal_games == 2671);
+    std::remove(path.c_str());
+  }
+
+  // Failures are only signalled by the return values
+  std::stringstream error_output;
+  std::streambuf *old_cerr = std::cerr.rdbuf(error_output.rdbuf());
+  CHECK(pgn_writer.open(copy_path, 99) == 0);
+  CHECK(pgn_writer.open("/nonexistent_hpce_dir/games.pgn") == 0);
+  if (std::filesystem::exists("/dev/full")) {
+    REQUIRE(pgn_writer.open("/dev/full"));
+    pgn_writer.add_game(test_games[0]);
+    CHECK(pgn_writer.close() == 0);
+  }
+  std::cerr.rdbuf(old_cerr);
+  CHECK(error_output.str().empty());
+}
+
+TEST_CASE("Scan games stored in a columnar game table", "[pgn][table]") {
+  PGN_Reader pgn_reader = PGN_Reader();
+  std::vector<PGN_Chess_Game> test_games =
+      pgn_reader.return_games("../data/pgn_multi.pgn");
+
+  Game_Table table;
+  REQUIRE(table.add_pgn("../data/pgn_multi.pgn") == test_games.size());
+  REQUIRE(table.size() == test_games.size());
+
+  uint64_t amt_plies = 0;
+  int amt_equal_games = 0;
+  for (size_t i = 0; i < table.size(); i++) {
+    Game_Table_View view = table.get_view(i);
+    PGN_Chess_Game &game = test_games[i];
+    amt_plies += game.get_amt_plies();
+
+    std::vector<Move> played_moves;
+    for (const Move &move : game.get_move_sequence_view()) {
+      if (!move.move_notation.empty() && move.move_notation != "1-0" &&
+          move.move_notation != "0-1" && move.move_notation != "1/2-1/2" &&
+          move.move_notation != "*")
+        played_moves.push_back(move);
+    }
+    std::vector<Move> view_moves;
+    for (size_t j = 0; j < view.get_amt_plies(); j++)
+      view_moves.push_back(view.get_move(j));
+
+    std::map<std::string, std::string> view_tags;
+    for (size_t j = 0; j < view.get_amt_tags(); j++)
+      view_tags.emplace(view.get_tag_key(j), view.get_tag_value(j));
+
+    if (view_moves == played_moves && view_tags == game.get_tag_pairs() &&
+        view.get_white_elo() == game.get_white_elo() &&
+        view.get_date() == game.get_date() &&
+        view.get_result() == game.get_result() &&
+        view.get_eco() == game.get_eco())
+      amt_equal_games++;
+  }
+  CHECK(amt_equal_games == 2671);
+  CHECK(table.sum_plies() == amt_plies);
+
+  // Column scans select the same games as the reader's filter
+  PGN_Filter filter;
+  filter.set_elo_range(2200, 4000);
+  filter.add_eco_prefix("B");
+  filter.set_date_range("2014.03.01", "2018.12.31");
+  pgn_reader.set_filter(filter);
+  std::vector<PGN_Chess_Game> filtered_games =
+      pgn_reader.return_games("../data/pgn_multi.pgn");
+  std::vector<size_t> game_nrs = table.select(filter);
+  REQUIRE(game_nrs.size() == filtered_games.size());
+  uint64_t amt_filtered_plies = 0;
+  for (PGN_Chess_Game &game : filtered_games)
+    amt_filtered_plies += game.get_amt_plies();
+  CHECK(table.sum_plies(game_nrs) == amt_filtered_plies);
+
+  PGN_Filter white_filter;
+  std::string_view white;
+  REQUIRE(table.get_view(0).get_tag("White", white));
+  white_filter.add_tag_equals("White", std::string(white));
+  white_filter.add_eco_prefix("B2");
+  pgn_reader.set_filter(white_filter);
+  CHECK(table.select(white_filter).size() ==
+        pgn_reader.return_games("../data/pgn_multi.pgn").size());
+  CHECK(table.select(white_filter)[0] == 0);
+
+  white_filter.add_tag_equals("Site", "Nowhere");
+  CHECK(table.select(white_filter).empty());
+}
+
+TEST_CASE("Convert PGN file to binary game database", "[pgn][database]") {
+  PGN_Reader pgn_reader = PGN_Reader();
+
+  std::vector<PGN_Chess_Game> test_games =
+      pgn_reader.return_games("../data/pgn_multi.pgn");
+
+  std::string db_path =
+      (std::filesystem::temp_directory_path() / "hpce_pgn_multi.hdb").string();
+  REQUIRE(convert_pgn_to_database("../data/pgn_multi.pgn", db_path));
+  CHECK(std::filesystem::file_size(db_path) <
+        std::filesystem::file_size("../data/pgn_multi.pgn"));
+
+  Game_Database database;
+  REQUIRE(database.open(db_path));
+  REQUIRE(database.size() == test_games.size());
+
+  std::vector<PGN_Chess_Game> db_games = database.return_games();
+  int amt_equal_games = 0;
+  for (size_t i = 0; i < test_games.size(); i++) {
+    if (db_games[i].get_tag_pairs() == test_games[i].get_tag_pairs() &&
+        db_games[i].get_move_sequence() == test_games[i].get_move_sequence())
+      amt_equal_games++;
+  }
+  CHECK(amt_equal_games == 2671);
+
+  // Legal games are stored as packed moves and keep them when read
+  int amt_packed_games = 0;
+  for (size_t i = 0; i < database.size(); i++)
+    amt_packed_games += database.get_view(i).has_packed_moves();
+  CHECK(amt_packed_games == 2671);
+  CHECK(db_games[0].has_packed_moves());
+
+  // Views resolve tags without copying
+  Game_View view = database.get_view(0);
+  std::string_view value;
+  CHECK(view.get_tag("ECO", value) == 1);
+  CHECK(value == "B28");
+  CHECK(view.get_move_notation(0) == "e4");
+  CHECK(view.get_packed_move(0) ==
+        Chess_Board::pack_move(12, 28, 0, PACKED_NORMAL));
+  CHECK(view.get_amt_moves() == test_games[0].get_move_sequence().size());
+  CHECK(view.get_move_notation(view.get_amt_moves() - 1) ==
+        test_games[0].get_move_sequence().back().move_notation);
+  database.close();
+
+  // Games whose move numbers do not alternate are stored explicitly
+  PGN_Chess_Game irregular_game(
+      std::map<std::string, std::string>{{"Event", "Irregular"}});
+  for (Move move : std::vector<Move>{
+           {12, 1, "Nf6"}, {13, 0, "c4"}, {13, 1, ""}, {13, 1, "e6"}})
+    irregular_game.add_move(move);
+
+  Game_Database_Writer writer;
+  REQUIRE(writer.open(db_path));
+  REQUIRE(writer.add_game(irregular_game));
+  REQUIRE(writer.add_game(test_games[1]));
+  REQUIRE(writer.close());
+
+  PGN_Chess_Game game;
+  REQUIRE(database.open(db_path));
+  REQUIRE(database.get_game(0, game));
+  CHECK(!database.get_view(0).has_packed_moves());
+  CHECK(game.get_tag_pairs() == irregular_game.get_tag_pairs());
+  CHECK(game.get_move_sequence() == irregular_game.get_move_sequence());
+  REQUIRE(database.get_game(1, game));
+  CHECK(game.get_move_sequence() == test_games[1].get_move_sequence());
+  CHECK(database.get_game(2, game) == 0);
+  database.close();
+
+  // More distinct notations than 16-bit tokens can address
+  PGN_Chess_Game long_game;
+  for (int i = 0; i < 70000; i++)
+    long_game.add_move({i / 2 + 1, i % 2, "Z" + std::to_string(i)});
+  REQUIRE(writer.open(db_path));
+  REQUIRE(writer.add_game(irregular_game));
+  REQUIRE(writer.add_game(long_game));
+  REQUIRE(writer.close());
+
+  REQUIRE(database.open(db_path));
+  REQUIRE(database.get_game(1, game));
+  CHECK(game.get_move_sequence() == long_game.get_move_sequence());
+  uint32_t token = database.get_view(1).get_move_token(69999);
+  CHECK(token > UINT16_MAX);
+  CHECK(database.get_move_string(token) == "Z69999");
+  REQUIRE(database.get_game(0, game));
+  CHECK(game.get_move_sequence() == irregular_game.get_move_sequence());
+  database.close();
+
+  // Packed moves that would leave the board and unknown flags are rejected
+  REQUIRE(writer.open(db_path));
+  REQUIRE(writer.add_game(test_games[1]));
+  REQUIRE(writer.close());
+  REQUIRE(database.open(db_path));
+  Game_View packed_view = database.get_view(0);
+  REQUIRE(packed_view.has_packed_moves());
+  uint64_t packed_offset =
+      sizeof(Database_Header) + packed_view.get_amt_tags() * sizeof(Tag_Pair) +
+      packed_view.get_amt_moves() * sizeof(uint16_t);
+  CHECK(packed_view.get_packed_move(0) ==
+        test_games[1].get_packed_moves_view()[0]);
+  database.close();
+
+  std::fstream db_file(db_path,
+                       std::ios::binary | std::ios::in | std::ios::out);
+  Packed_Move castling = Chess_Board::pack_move(4, 0, 0, PACKED_CASTLING);
+  db_file.seekp(packed_offset);
+  db_file.write(reinterpret_cast<const char *>(&castling), sizeof(Packed_Move));
+  db_file.close();
+  CHECK(database.open(db_path) == 0);
+
+  REQUIRE(writer.open(db_path));
+  REQUIRE(writer.add_game(test_games[1]));
+  REQUIRE(writer.close());
+  Database_Header header;
+  Database_Game_Entry entry;
+  db_file.open(db_path, std::ios::binary | std::ios::in | std::ios::out);
+  db_file.read(reinterpret_cast<char *>(&header), sizeof(Database_Header));
+  db_file.seekg(header.games_offset);
+  db_file.read(reinterpret_cast<char *>(&entry), sizeof(Database_Game_Entry));
+  entry.flags |= GAME_FLAGS_MASK + 1;
+  db_file.seekp(header.games_offset);
+  db_file.write(reinterpret_cast<const char *>(&entry),
+                sizeof(Database_Game_Entry));
+  db_file.close();
+  CHECK(database.open(db_path) == 0);
+
+  // Truncated databases are rejected
+  REQUIRE(writer.open(db_path));
+  REQUIRE(writer.add_game(test_games[1]));
+  REQUIRE(writer.close());
+  REQUIRE(database.open(db_path));
+  database.close();
+  std::filesystem::resize_file(db_path, std::filesystem::file_size(db_path) / 2);
+  CHECK(database.open(db_path) == 0);
+  std::remove(db_path.c_str());
+}
+
+TEST_CASE("Random access to PGN games through the offset index",
+          "[pgn][index]") {
+  PGN_Reader pgn_reader = PGN_Reader();
+
+  std::vector<PGN_Chess_Game> test_games =
+      pgn_reader.return_games("../data/pgn_multi.pgn");
+
+  std::filesystem::path pgn_path =
+      std::filesystem::temp_directory_path() / "hpce_pgn_index.pgn";
+  std::filesystem::copy_file("../data/pgn_multi.pgn", pgn_path,
+                             std::filesystem::copy_options::overwrite_existing);
+  std::remove(PGN_Index::index_path(pgn_path.string()).c_str());
+
+  // The missing index is built on first use
+  REQUIRE(pgn_reader.open_index(pgn_path.string()));
+  CHECK(std::filesystem::exists(PGN_Index::index_path(pgn_path.string())));
+  REQUIRE(pgn_reader.get_amt_indexed_games() == test_games.size());
+
+  PGN_Chess_Game game;
+  int amt_equal_games = 0;
+  for (size_t i : {size_t(2670), size_t(0), size_t(1337), size_t(1)}) {
+    REQUIRE(pgn_reader.read_game(i, game));
+    if (game.get_tag_pairs() == test_games[i].get_tag_pairs() &&
+        game.get_move_sequence() == test_games[i].get_move_sequence())
+      amt_equal_games++;
+  }
+  CHECK(amt_equal_games == 4);
+  CHECK(pgn_reader.read_game(2671, game) == 0);
+
+  std::vector<PGN_Chess_Game> range = pgn_reader.read_games(2668, 10);
+  REQUIRE(range.size() == 3);
+  CHECK(range[2].get_move_sequence() == test_games[2670].get_move_sequence());
+  pgn_reader.close_index();
+
+  // Appending a game makes the index stale
+  std::ifstream if_reader("../data/pgn_single.pgn", std::ios::binary);
+  std::ofstream(pgn_path, std::ios::binary | std::ios::app)
+      << "\n\n" << if_reader.rdbuf();
+  PGN_Index index;
+  std::stringstream error_output;
+  std::streambuf *old_cerr = std::cerr.rdbuf(error_output.rdbuf());
+  CHECK(index.open(pgn_path.string()) == 0);
+
+  REQUIRE(pgn_reader.open_index(pgn_path.string()));
+  std::cerr.rdbuf(old_cerr);
+  CHECK(error_output.str().empty());
+  CHECK(pgn_reader.get_amt_indexed_games() == test_games.size() + 1);
+  REQUIRE(pgn_reader.read_game(test_games.size(), game));
+  CHECK(game.get_tag_pairs()["White"] ==
+        pgn_reader.return_games("../data/pgn_single.pgn")[0]
+            .get_tag_pairs()["White"]);
+  pgn_reader.close_index();
+
+  // An index that can not be written is kept in memory
+  std::string tmp_path = PGN_Index::index_path(pgn_path.string()) + ".tmp";
+  std::remove(PGN_Index::index_path(pgn_path.string()).c_str());
+  std::filesystem::create_directory(tmp_path);
+  REQUIRE(pgn_reader.open_index(pgn_path.string()));
+  CHECK_FALSE(
+      std::filesystem::exists(PGN_Index::index_path(pgn_path.string())));
+  CHECK(pgn_reader.get_amt_indexed_games() == test_games.size() + 1);
+  REQUIRE(pgn_reader.read_game(1337, game));
+  CHECK(game.get_move_sequence() == test_games[1337].get_move_sequence());
+  pgn_reader.close_index();
+  std::filesystem::remove(tmp_path);
+
+  std::remove(PGN_Index::index_path(pgn_path.string()).c_str());
+  std::remove(pgn_path.string().c_str());
+}
+
+TEST_CASE("Follow a PGN file that is being appended to", "[pgn][follow]") {
+  std::string tags = "[Event \"Live\"]\n[Site \"Relay\"]\n[Date \"2025.01.01\"]\n"
+                     "[Round \"1\"]\n[White \"A\"]\n[Black \"B\"]\n"
+                     "[Result \"1-0\"]\n\n";
+  std::string pgn_path =
+      (std::filesystem::temp_directory_path() / "hpce_follow.pgn").string();
+  auto append = [&](const std::string &text) {
+    std::ofstream(pgn_path, std::ios::binary | std::ios::app) << text;
+  };
+  std::ofstream(pgn_path, std::ios::binary | std::ios::trunc)
+      << tags << "1. e4 e5 2. Qh5 Nc6 3. Bc4 Nf6 4. Qxf7# 1-0\n\n";
+
+  PGN_Reader pgn_reader = PGN_Reader();
+  std::vector<PGN_Chess_Game> games;
+  REQUIRE(pgn_reader.follow(pgn_path));
+  CHECK(pgn_reader.poll_games(games) == 1);
+  CHECK(pgn_reader.poll_games(games) == 0);
+
+  // A half-written game is held back until its result line is complete
+  append(tags + "1. d4 d5 2. c4");
+  CHECK(pgn_reader.poll_games(games) == 0);
+  append(" e6 3. Nc3 1-0");
+  CHECK(pgn_reader.poll_games(games) == 0);
+  append("\n");
+  CHECK(pgn_reader.poll_games(games) == 1);
+  REQUIRE(games.size() == 2);
+  std::vector<Move> move_sequence = {{1, 0, "d4"}, {1, 1, "d5"}, {2, 0, "c4"},
+                                     {2, 1, "e6"}, {3, 0, "Nc3"}, {3, 1, "1-0"}};
+  CHECK(games[1].get_move_sequence() == move_sequence);
+
+  // Games appended by another process are picked up while waiting
+  std::thread writer([&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    append("\n" + tags + "1. c4 1-0\n\n" + tags + "1. Nf3 *\n\n");
+  });
+  int amt_games = 0;
+  for (int i = 0; i < 20 && amt_games < 2; i++)
+    amt_games += pgn_reader.wait_for_games(games, 500);
+  writer.join();
+  CHECK(amt_games == 2);
+  CHECK(games.back().get_move_sequence()[0].move_notation == "Nf3");
+
+  // Following can be resumed at the last game boundary
+  uint64_t offset = pgn_reader.get_follow_offset();
+  pgn_reader.stop_following();
+  append(tags + "1. b3 0-1\n\n");
+  games.clear();
+  REQUIRE(pgn_reader.follow(pgn_path, offset));
+  CHECK(pgn_reader.poll_games(games) == 1);
+  CHECK(games[0].get_move_sequence()[0].move_notation == "b3");
+
+  // A replaced file is read again from the start and reported, without
+  // writing to std::cerr
+  uint64_t old_offset = pgn_reader.get_follow_offset();
+  std::ofstream(pgn_path, std::ios::binary | std::ios::trunc)
+      << tags << "1. g3 *\n\n";
+  std::stringstream error_output;
+  std::streambuf *old_cerr = std::cerr.rdbuf(error_output.rdbuf());
+  CHECK(pgn_reader.poll_games(games) == 1);
+  std::cerr.rdbuf(old_cerr);
+  CHECK(error_output.str().empty());
+  CHECK(games.back().get_move_sequence()[0].move_notation == "g3");
+  PGN_Diagnostics diagnostics = pgn_reader.get_diagnostics();
+  REQUIRE(diagnostics.get_count(DIAGNOSTIC_RESTARTED_INPUT) == 1);
+  CHECK(diagnostics.get_samples().back().offset == old_offset);
+  pgn_reader.stop_following();
+  std::remove(pgn_path.c_str());
+}